@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * C interface for FFI consumers.
+ * Results are views borrowed from the object they came from (an ifd_catalog or an ifd_font) and stay valid until that
+ * object is released, nothing is copied across the boundary. Strings are UTF-8 and not NUL terminated.
+ */
+
+#if ! defined(INCFONTDISC_API)
+#if defined(INCFONTDISC_SHARED)
+#if defined(_WIN32) || defined(__CYGWIN__)
+#if defined(INCFONTDISC_EXPORTS)
+#define INCFONTDISC_API __declspec(dllexport)
+#else
+#define INCFONTDISC_API __declspec(dllimport)
+#endif
+#else
+#define INCFONTDISC_API __attribute__((visibility("default")))
+#endif
+
+#else
+/* Static library */
+#define INCFONTDISC_API
+#endif
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* IFD_OK or the C++ ErrorCode + 1 */
+typedef enum ifd_status {
+    IFD_OK                  = 0,
+    IFD_BACKEND_UNAVAILABLE = 1,
+    IFD_NOT_IMPLEMENTED     = 2,
+    IFD_INVALID_ARGUMENT    = 3,
+    IFD_NO_FONTS_FOUND      = 4,
+    IFD_SYSTEM_ERROR        = 5,
+    IFD_TIMEOUT             = 6,
+    IFD_CANCELLED           = 7
+} ifd_status;
+
+typedef struct ifd_str {
+    const char *data;
+    size_t      size;
+} ifd_str;
+
+typedef struct ifd_bytes {
+    const uint8_t *data;
+    size_t         size;
+} ifd_bytes;
+
+/* Immutable snapshot of the catalog, refreshes do not change a snapshot that is already open */
+typedef struct ifd_catalog ifd_catalog;
+/* Read-only mapping of a font file */
+typedef struct ifd_font ifd_font;
+
+typedef struct ifd_face {
+    uint32_t index;  /* position in the catalog snapshot */
+    uint64_t handle; /* FontHandle of the face */
+    ifd_str  id;
+    ifd_str  family;
+    ifd_str  style;
+    int32_t  weight;
+    int32_t  stretch;
+    int32_t  italic;
+} ifd_face;
+
+/* Strings with a NULL data pointer and negative numbers leave the field unset, the family is required */
+typedef struct ifd_query {
+    ifd_str family;
+    ifd_str style;
+    int32_t weight;
+    int32_t stretch;
+    int32_t italic;
+} ifd_query;
+
+typedef struct ifd_match_result {
+    ifd_face face;
+    float    family_score;
+    float    face_score;
+} ifd_match_result;
+
+/* Message of the last call on this thread that did not return IFD_OK, valid until the next failing call */
+INCFONTDISC_API const char *
+ifd_last_error(void);
+
+/* Builds the catalog on first use */
+INCFONTDISC_API ifd_status
+ifd_catalog_open(ifd_catalog **out);
+INCFONTDISC_API void
+ifd_catalog_release(ifd_catalog *catalog);
+/* Rescans the installed fonts, snapshots opened afterwards see the result */
+INCFONTDISC_API ifd_status
+ifd_catalog_refresh(void);
+INCFONTDISC_API uint64_t
+ifd_catalog_generation(const ifd_catalog *catalog);
+INCFONTDISC_API size_t
+ifd_catalog_size(const ifd_catalog *catalog);
+INCFONTDISC_API ifd_status
+ifd_catalog_face(const ifd_catalog *catalog, size_t index, ifd_face *out);
+/* Ids of faces left out as duplicates resolve to the face that was kept */
+INCFONTDISC_API ifd_status
+ifd_catalog_find(const ifd_catalog *catalog, ifd_str id, ifd_face *out);
+
+INCFONTDISC_API ifd_status
+ifd_match(const ifd_catalog *catalog, const ifd_query *query, ifd_match_result *out);
+
+/* Maps the file of the face (collections are mapped whole), 'data' stays valid until ifd_font_release */
+INCFONTDISC_API ifd_status
+ifd_map_font(ifd_str id, ifd_font **out, ifd_bytes *data);
+INCFONTDISC_API void
+ifd_font_release(ifd_font *font);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -1,9 +1,16 @@
 #pragma once
 
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <expected>
+#include <functional>
+#include <memory>
 #include <optional>
+#include <span>
+#include <stop_token>
 #include <string>
+#include <string_view>
 #include <vector>
 
 
@@ -31,7 +38,9 @@ enum class ErrorCode {
     NotImplemented,
     InvalidArgument,
     NoFontsFound,
-    SystemError
+    SystemError,
+    Timeout,
+    Cancelled
 };
 
 struct INCFONTDISC_API Error {
@@ -39,10 +48,21 @@ struct INCFONTDISC_API Error {
     std::string message{};
 };
 
+// Point in time by which a call has to return, Deadline::max() waits as long as it takes
+using Deadline = std::chrono::steady_clock::time_point;
+
 struct INCFONTDISC_API FontId {
     std::string value{};
 };
 
+// Compact identity of a face derived from its FontId, stable across catalog generations
+struct INCFONTDISC_API FontHandle {
+    std::uint64_t value = 0;
+
+    bool
+    operator==(const FontHandle &) const = default;
+};
+
 struct INCFONTDISC_API FontDescriptor {
     FontId      id{};
     std::string family{};
@@ -64,17 +84,385 @@ struct INCFONTDISC_API FontQuery {
     std::optional<int>         weight{};
     std::optional<int>         stretch{};
     std::optional<bool>        italic{};
+    // OpenType tags ("smcp", "dev2", ...) the GSUB or GPOS table of the chosen face must list
+    std::vector<std::string>   features{};
+    std::vector<std::string>   scripts{};
 };
 
 using ByteBuffer = std::vector<std::byte>;
 
+enum class FontFormat : std::uint8_t {
+    Sfnt, // the face as stored on disk (TrueType/OpenType, collections are returned whole)
+    Woff2 // a standalone WOFF2 font of the face, for serving to web clients
+};
+
+// A match together with the font file of its face. 'data' views a read-only mapping of the file (a buffer when the
+// daemon served it) and stays valid as long as 'storage' is alive, copies of the result share it.
+struct INCFONTDISC_API LoadedMatch {
+    FontMatch                   match{};
+    std::span<const std::byte>  data{};
+    std::shared_ptr<const void> storage{};
+};
+
+struct INCFONTDISC_API CoverageReport {
+    std::size_t           covered = 0;
+    std::vector<char32_t> missing{};
+};
+
+// Horizontal advances in font units, one per codepoint of the measured text
+struct INCFONTDISC_API GlyphAdvances {
+    std::uint16_t              units_per_em = 0;
+    std::vector<std::uint16_t> advances{};
+    // Positions in the text the face does not map, they get the advance of .notdef
+    std::vector<std::size_t>   missing{};
+};
+
+enum class FontGenre : std::uint8_t {
+    Sans,
+    Serif,
+    Mono
+};
+
+// Coarse style class of the fallback table, faces are classed by PANOSE, post.isFixedPitch and their family name
+struct INCFONTDISC_API FallbackStyle {
+    FontGenre genre  = FontGenre::Sans;
+    bool      bold   = false;
+    bool      italic = false;
+};
+
+// Controls where the library runs its parallel work (catalog builds, fuzzy family matching, ...)
+struct INCFONTDISC_API ExecutorOptions {
+    // Number of workers of the internal pool, 0 means std::thread::hardware_concurrency()
+    std::size_t      thread_count = 0;
+    // CPUs the workers get pinned to (assigned round-robin), empty leaves scheduling to the OS
+    std::vector<int> cpu_affinity{};
+    // When set, every task is handed over to this callable and the internal pool is never started
+    std::function<void(std::function<void()>)> executor{};
+};
+
+// Client mode: list/match/describe/load/refresh are forwarded to a running incfontdiscd when one is reachable.
+// An unreachable daemon is probed again after a backoff (1s doubling up to 60s), one started later is picked up.
+struct INCFONTDISC_API DaemonClientOptions {
+    bool        enabled = true;
+    // Empty means $INCFONTDISC_SOCKET, then $XDG_RUNTIME_DIR/incfontdisc.sock, with neither set there is no daemon.
+    // Daemons run by another user are never talked to.
+    std::string socket_path{};
+};
+
+enum class TraceEventKind : std::uint8_t {
+    Match = 1,
+    Load  = 2
+};
+
+// One recorded call, 'query' is set for Match events and 'id' for Load events
+struct INCFONTDISC_API TraceEvent {
+    TraceEventKind           kind = TraceEventKind::Match;
+    std::chrono::nanoseconds timestamp{};
+    FontQuery                query{};
+    FontId                   id{};
+};
+
+enum class OperationKind : std::uint8_t {
+    List,
+    Match,
+    Load,
+    Refresh
+};
+
+// How match_fonts arrived at its answer
+enum class MatchPath : std::uint8_t {
+    Unknown,      // not matched locally (daemon client mode) or failed before a family was chosen
+    Exact,        // family found by name and a face matched every requested field
+    Fuzzy,        // family found by name, face chosen by scoring
+    Substitution, // family name not found, closest family chosen by similarity
+    Cached        // answered from the shared match cache
+};
+
+struct INCFONTDISC_API OperationPhase {
+    std::string_view         name{};
+    std::chrono::nanoseconds duration{};
+};
+
+// Context captured for a call that exceeded the slow log threshold
+struct INCFONTDISC_API SlowOperation {
+    OperationKind                         kind = OperationKind::Match;
+    std::chrono::system_clock::time_point started{};
+    std::chrono::nanoseconds              duration{};
+    FontQuery                             query{};
+    FontId                                id{};
+    MatchPath                             path             = MatchPath::Unknown;
+    std::size_t                           families_scanned = 0;
+    std::size_t                           faces_scored     = 0;
+    std::vector<OperationPhase>           phases{};
+    std::optional<ErrorCode>              error{};
+};
+
+struct INCFONTDISC_API SlowLogOptions {
+    bool                                      enabled   = false;
+    std::chrono::nanoseconds                  threshold = std::chrono::milliseconds(10);
+    // Oldest entries are dropped once the ring buffer is full
+    std::size_t                               capacity  = 256;
+    // Called synchronously on the slow thread, in addition to buffering the entry
+    std::function<void(const SlowOperation &)> callback{};
+};
+
+struct INCFONTDISC_API FaceChange {
+    FontHandle    handle{};
+    // Hash of the file size, modification time and descriptor, changes whenever the face may have changed
+    std::uint64_t fingerprint = 0;
+};
+
+struct INCFONTDISC_API CatalogDiff {
+    std::uint64_t           from = 0;
+    std::uint64_t           to   = 0;
+    std::vector<FaceChange> added{};
+    std::vector<FaceChange> removed{};
+    // Same handle, different fingerprint, reported with the fingerprint of 'to'
+    std::vector<FaceChange> modified{};
+};
+
+// Which file is kept when the same face (family, style, PostScript name and version) is installed more than once.
+// Ties are broken by the smaller file and then by FontId, so the choice does not depend on enumeration order.
+enum class DuplicatePolicy : std::uint8_t {
+    KeepAll,        // list every file
+    PreferVariable, // variable fonts over static faces
+    PreferSmallest,
+    PreferCff       // PostScript outlines over TrueType
+};
+
+struct INCFONTDISC_API CatalogOptions {
+    DuplicatePolicy duplicates   = DuplicatePolicy::PreferVariable;
+    // Both indices open every font file. Left off, the first query with layout requirements (respectively the first
+    // fallback lookup) builds the index and later refreshes keep it, turned on it is built with the catalog.
+    // Record the GSUB/GPOS script and feature tags of every face, queries with layout requirements need it
+    bool            layout_index   = false;
+    // Read every face's cmap and precompute which faces to fall back to per script and style class
+    bool            fallback_index = false;
+};
+
+struct INCFONTDISC_API MatchCacheOptions {
+    // Share match results with every process of the host through a table in the host cache directory. Off by default
+    // since it writes a file that outlives the process.
+    bool        persistent = false;
+    // Slots of the shared table, rounded up to a power of two. Each size gets a table file of its own.
+    std::size_t slots      = 16384;
+};
+
+enum class ValidationLevel : std::uint8_t {
+    None,
+    Structure, // table directory, offsets, lengths and the tables every face needs
+    Checksums  // Structure plus every table checksum
+};
+
+// Bytes held by the library in this process, catalog figures cover the current snapshot only
+struct INCFONTDISC_API MemoryUsage {
+    // Face and family records
+    std::size_t descriptors     = 0;
+    // Ids, names and styles including their lowercase lookup keys
+    std::size_t strings         = 0;
+    // Family name lookup and the per-family face lists
+    std::size_t family_index    = 0;
+    // Normalized family names used for fuzzy matching
+    std::size_t fuzzy_index     = 0;
+    std::size_t id_index        = 0;
+    // Fallback faces per script and style class, see CatalogOptions::fallback_index
+    std::size_t coverage_index  = 0;
+    // Per-face advance tables cached by glyph_advances
+    std::size_t advance_tables  = 0;
+    // Font bytes kept by caches (subsets, encoded output, ...)
+    std::size_t byte_caches     = 0;
+    // Files the library keeps mapped: pinned fonts, LoadedMatch data, ifd_font mappings and the shared match table
+    std::size_t mapped_resident = 0;
+
+    std::size_t
+    total() const {
+        return descriptors + strings + family_index + fuzzy_index + id_index + coverage_index + advance_tables +
+               byte_caches + mapped_resident;
+    }
+};
+
+// How much of the trimmable cache memory trim() gives back, cheapest to rebuild caches go first
+enum class TrimLevel : std::uint8_t {
+    Light,    // a quarter
+    Moderate, // half
+    Complete  // everything
+};
+
+struct INCFONTDISC_API MemoryOptions {
+    // Upper bound for the combined caches, exceeding it evicts in cost order, 0 means unlimited
+    std::size_t               budget          = 0;
+    // Linux only: trim whenever the cgroup (or the system) reports memory pressure through PSI
+    bool                      watch_pressure  = false;
+    // PSI trigger, pressure is signalled when tasks stalled on memory for 'stall' within 'window'
+    std::chrono::microseconds pressure_stall  = std::chrono::milliseconds(100);
+    std::chrono::microseconds pressure_window = std::chrono::seconds(1);
+    TrimLevel                 pressure_level  = TrimLevel::Moderate;
+};
+
+struct INCFONTDISC_API PinOptions {
+    // Upper bound for the bytes of all pinned font files together, 0 means unlimited
+    std::size_t budget = std::size_t{64} << 20;
+    // Also lock pinned files in RAM (mlock, VirtualLock), so memory pressure cannot evict them either.
+    // Locking is further bounded by the locked memory limit of the process (RLIMIT_MEMLOCK).
+    bool        lock   = false;
+};
+
+struct INCFONTDISC_API PinStats {
+    std::size_t faces        = 0;
+    // Faces of one collection share the pin of their file
+    std::size_t files        = 0;
+    std::size_t pinned_bytes = 0;
+    std::size_t locked_bytes = 0;
+};
+
+enum class RefreshPhase : std::uint8_t {
+    Enumerate, // asking the backend for the installed faces, reported once without counts
+    Scan,      // reading the font files, counted in faces
+    Index      // building the lookup indices, counted in shards
+};
+
+struct INCFONTDISC_API RefreshProgress {
+    RefreshPhase phase = RefreshPhase::Enumerate;
+    std::size_t  done  = 0;
+    std::size_t  total = 0;
+};
+
+struct INCFONTDISC_API RefreshOptions {
+    Deadline        deadline = Deadline::max();
+    std::stop_token stop_token{};
+    // Called from library threads, one call at a time, when a phase starts and as it advances
+    std::function<void(const RefreshProgress &)> progress{};
+};
+
+struct INCFONTDISC_API DaemonOptions {
+    std::string     socket_path{};
+    std::stop_token stop_token{};
+};
+
 INCFONTDISC_API std::expected<std::vector<FontDescriptor>, Error>
                 list_fonts();
 INCFONTDISC_API std::expected<void, Error>
                 refresh_fonts();
+// Timeout when the rescan misses the deadline, it still completes in the background and installs its catalog
+INCFONTDISC_API std::expected<void, Error>
+                refresh_fonts(Deadline deadline);
+// Cancelled when the stop token fires before the new catalog is installed, the previous catalog stays in place.
+// Refreshes forwarded to incfontdiscd report no progress and run to completion once sent.
+INCFONTDISC_API std::expected<void, Error>
+                refresh_fonts(RefreshOptions options);
 INCFONTDISC_API std::expected<FontMatch, Error>
                 match_fonts(const FontQuery &query);
+// A fuzzy family search cut short by the deadline answers with the best family scored so far.
+// Timeout when nothing was scored in time or the catalog could not be built before the deadline.
+INCFONTDISC_API std::expected<FontMatch, Error>
+                match_fonts(const FontQuery &query, Deadline deadline);
+// match_fonts followed by load_font_data(match.font.id), except that the file of the leading candidate is mapped and
+// read in on the executor while the query is still being scored. Substitutions only know their face at the end.
+INCFONTDISC_API std::expected<LoadedMatch, Error>
+                match_and_load(const FontQuery &query);
+// Timeout when scoring, the catalog build or reading the file in misses the deadline
+INCFONTDISC_API std::expected<LoadedMatch, Error>
+                match_and_load(const FontQuery &query, Deadline deadline);
+INCFONTDISC_API std::expected<FontDescriptor, Error>
+                describe_font(const FontId &id);
 INCFONTDISC_API std::expected<ByteBuffer, Error>
                 load_font_data(const FontId &id);
+// Timeout when reading the font file misses the deadline
+INCFONTDISC_API std::expected<ByteBuffer, Error>
+                load_font_data(const FontId &id, Deadline deadline);
+// Woff2 output is cached per face content in memory and on disk, the disk cache keeps the most recently used 256 MiB.
+// NotImplemented when built without WOFF2
+INCFONTDISC_API std::expected<ByteBuffer, Error>
+                load_font_data(const FontId &id, FontFormat format);
+INCFONTDISC_API FontHandle
+                font_handle(const FontId &id);
+// Every catalog build or refresh produces a new generation, the most recent ones are kept for diffing
+INCFONTDISC_API std::expected<std::uint64_t, Error>
+                catalog_generation();
+// InvalidArgument when either generation is no longer retained
+INCFONTDISC_API std::expected<CatalogDiff, Error>
+                diff_generations(std::uint64_t old_generation, std::uint64_t new_generation);
+// Checks the Unicode cmap of the face for every codepoint
+INCFONTDISC_API std::expected<CoverageReport, Error>
+                check_coverage(const FontId &id, std::u32string_view codepoints);
+// Served from a per-face advance table built from cmap and hmtx on first use, later calls never read the font file
+INCFONTDISC_API std::expected<GlyphAdvances, Error>
+                glyph_advances(FontHandle face, std::u32string_view text);
+// Faces covering the script of 'codepoint', closest to 'style' first, looked up in the catalog's fallback index.
+// InvalidArgument for codepoints of no indexed script (digits, punctuation, symbols), NoFontsFound when no face covers
+// the script.
+INCFONTDISC_API std::expected<std::vector<FontDescriptor>, Error>
+                fallback_fonts(char32_t codepoint, FallbackStyle style);
+// Font holding only the glyphs needed for 'codepoints' (plus composite components and .notdef), in the outline
+// format of the original (TrueType or CFF).
+// Layout and variation tables are dropped, CFF2 based faces return NotImplemented. Results are cached.
+INCFONTDISC_API std::expected<ByteBuffer, Error>
+                subset_font(const FontId &id, std::u32string_view codepoints);
+
+// Rebuilds the catalog of this process right away when one exists
+INCFONTDISC_API std::expected<void, Error>
+                configure_catalog(CatalogOptions options);
+// Serves 'fonts' instead of the fonts installed on the system, e.g. the index of a font hosting service. The catalog
+// is rebuilt right away and refreshes rebuild from this set, an empty list goes back to the system fonts.
+// Calls forwarded to incfontdiscd are answered from the daemon's catalog, disable client mode to serve this set.
+INCFONTDISC_API std::expected<void, Error>
+                register_fonts(std::vector<FontDescriptor> fonts);
+INCFONTDISC_API std::expected<void, Error>
+                configure_executor(ExecutorOptions options);
+// Validates the data returned by load_font_data, failures are InvalidArgument. Verdicts are remembered per file
+// size and mtime in the host cache directory, so each file version is validated at most once per host.
+INCFONTDISC_API std::expected<void, Error>
+                configure_validation(ValidationLevel level);
+// Results are keyed by a fingerprint of the catalog, so processes with different fonts or catalog options never
+// see each other's entries
+INCFONTDISC_API std::expected<void, Error>
+                configure_match_cache(MatchCacheOptions options);
+
+INCFONTDISC_API std::expected<void, Error>
+                configure_daemon_client(DaemonClientOptions options);
+// Records every match_fonts and load_font_data call of this process to a compact binary trace.
+// Setting $INCFONTDISC_TRACE to a path starts recording on the first call without any code change.
+INCFONTDISC_API std::expected<void, Error>
+                start_trace_recording(const std::string &path);
+INCFONTDISC_API std::expected<void, Error>
+                stop_trace_recording();
+INCFONTDISC_API std::expected<std::vector<TraceEvent>, Error>
+                read_trace(const std::string &path);
+
+INCFONTDISC_API std::expected<void, Error>
+                configure_slow_log(SlowLogOptions options);
+// Returns and clears the buffered slow operations, oldest first
+INCFONTDISC_API std::vector<SlowOperation>
+                drain_slow_log();
+
+// Does not build the catalog, catalog figures are zero until the first call that needs it
+INCFONTDISC_API MemoryUsage
+                memory_usage();
+
+INCFONTDISC_API std::expected<void, Error>
+                configure_memory(MemoryOptions options);
+// Returns the number of bytes released
+INCFONTDISC_API std::size_t
+                trim(TrimLevel level);
+
+// Applies to pins made afterwards, files pinned before keep their state
+INCFONTDISC_API std::expected<void, Error>
+                configure_pinning(PinOptions options);
+// Maps the file of 'face' and reads all of it in, match_and_load and ifd_map_font hand out that mapping until
+// unpin_font. Unless PinOptions::lock is set the pages are clean page cache that memory pressure can still reclaim,
+// a later access then reads them back from disk.
+// Pinning a pinned face does nothing. InvalidArgument when the face is not in the catalog or its file does not fit
+// the budget, SystemError when locking was asked for and the OS refused it.
+INCFONTDISC_API std::expected<void, Error>
+                pin_font(FontHandle face);
+// InvalidArgument when the face is not pinned
+INCFONTDISC_API std::expected<void, Error>
+                unpin_font(FontHandle face);
+INCFONTDISC_API PinStats
+                pin_stats();
+
+// Serves the catalog of this process over a Unix domain socket until 'stop_token' is triggered
+INCFONTDISC_API std::expected<void, Error>
+                run_daemon(const DaemonOptions &options);
 
 } // namespace incfontdisc
\ No newline at end of file
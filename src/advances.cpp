@@ -0,0 +1,145 @@
+#include <incfontdisc_private/advances.hpp>
+#include <incfontdisc_private/memory.hpp>
+
+#include <algorithm>
+
+namespace incfontdisc::detail {
+
+namespace {
+
+constexpr std::uint32_t tag_head = sfnt::make_tag('h', 'e', 'a', 'd');
+constexpr std::uint32_t tag_hhea = sfnt::make_tag('h', 'h', 'e', 'a');
+constexpr std::uint32_t tag_hmtx = sfnt::make_tag('h', 'm', 't', 'x');
+
+// Maximum size of the cache when no global memory budget is configured
+constexpr std::size_t default_capacity   = 16u << 20;
+constexpr int         advance_evict_cost = 3;
+
+} // namespace
+
+std::expected<AdvanceTable, Error>
+AdvanceTable::from_font(const sfnt::FontFile &font) {
+    const auto head = font.table(tag_head);
+    const auto hhea = font.table(tag_hhea);
+    const auto hmtx = font.table(tag_hmtx);
+    if (head.size() < 54 || hhea.size() < 36) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Font lacks the head or hhea table"});
+    }
+    const std::size_t metrics = sfnt::read_u16(hhea, 34);
+    if (metrics == 0 || hmtx.size() < metrics * 4) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Truncated hmtx table"});
+    }
+    auto cmap = sfnt::CharMap::from_font(font);
+    if (! cmap) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Font has no usable Unicode cmap"}); }
+
+    // Glyphs past the last long metric share its advance
+    auto advance_of = [&](std::uint32_t glyph) {
+        return sfnt::read_u16(hmtx, std::min<std::size_t>(glyph, metrics - 1) * 4);
+    };
+
+    AdvanceTable table{};
+    table.units_per_em_   = sfnt::read_u16(head, 18);
+    table.notdef_advance_ = advance_of(0);
+    cmap->for_each([&](char32_t codepoint, std::uint32_t glyph) {
+        auto &runs = table.runs_;
+        if (runs.empty() || runs.back().first + runs.back().count != codepoint) {
+            runs.push_back(Run{codepoint, 0, static_cast<std::uint32_t>(table.advances_.size())});
+        }
+        ++runs.back().count;
+        table.advances_.push_back(advance_of(glyph));
+    });
+    table.runs_.shrink_to_fit();
+    table.advances_.shrink_to_fit();
+    return table;
+}
+
+std::optional<std::uint16_t>
+AdvanceTable::advance(char32_t codepoint) const {
+    auto it = std::upper_bound(runs_.begin(), runs_.end(), codepoint,
+                               [](char32_t value, const Run &run) { return value < run.first; });
+    if (it == runs_.begin()) { return std::nullopt; }
+    --it;
+    if (codepoint - it->first >= it->count) { return std::nullopt; }
+    return advances_[it->offset + (codepoint - it->first)];
+}
+
+std::size_t
+AdvanceTable::bytes() const {
+    return sizeof(*this) + runs_.capacity() * sizeof(Run) + advances_.capacity() * sizeof(std::uint16_t);
+}
+
+AdvanceCache::AdvanceCache() {
+    budget_handle_ = memory_budget().add_cache(MemoryBudget::Cache{
+        .cost  = advance_evict_cost,
+        .usage = [this] { return usage(); },
+        .evict = [this](std::size_t bytes) { return evict(bytes); },
+    });
+}
+
+AdvanceCache::~AdvanceCache() {
+    memory_budget().remove_cache(budget_handle_);
+}
+
+std::shared_ptr<const AdvanceTable>
+AdvanceCache::find(FontHandle face, std::uint64_t fingerprint) {
+    std::lock_guard lock(mutex_);
+    auto            entry = entries_.find(face.value);
+    if (entry == entries_.end() || entry->second->fingerprint != fingerprint) { return nullptr; }
+    lru_.splice(lru_.begin(), lru_, entry->second);
+    return entry->second->table;
+}
+
+void
+AdvanceCache::insert(FontHandle face, std::uint64_t fingerprint, std::shared_ptr<const AdvanceTable> table) {
+    {
+        std::lock_guard lock(mutex_);
+        if (auto entry = entries_.find(face.value); entry != entries_.end()) { erase_locked(entry->second); }
+
+        const auto size  = table->bytes();
+        bytes_          += size;
+        memory_counters().add(MemoryCategory::AdvanceTables, size);
+        lru_.push_front(Entry{face.value, fingerprint, std::move(table)});
+        entries_.emplace(face.value, lru_.begin());
+        if (bytes_ > default_capacity) { evict_locked(bytes_ - default_capacity); }
+    }
+    memory_budget().charged();
+}
+
+std::size_t
+AdvanceCache::usage() const {
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
+
+std::size_t
+AdvanceCache::evict(std::size_t bytes) {
+    std::lock_guard lock(mutex_);
+    return evict_locked(bytes);
+}
+
+void
+AdvanceCache::erase_locked(std::list<Entry>::iterator entry) {
+    const auto size  = entry->table->bytes();
+    bytes_          -= size;
+    memory_counters().release(MemoryCategory::AdvanceTables, size);
+    entries_.erase(entry->face);
+    lru_.erase(entry);
+}
+
+std::size_t
+AdvanceCache::evict_locked(std::size_t bytes) {
+    std::size_t freed = 0;
+    while (freed < bytes && ! lru_.empty()) {
+        freed += lru_.back().table->bytes();
+        erase_locked(std::prev(lru_.end()));
+    }
+    return freed;
+}
+
+AdvanceCache &
+advance_cache() {
+    static AdvanceCache cache{};
+    return cache;
+}
+
+} // namespace incfontdisc::detail
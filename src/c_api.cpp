@@ -0,0 +1,201 @@
+#include <incfontdisc/incfontdisc.h>
+#include <incfontdisc/incfontdisc.hpp>
+#include <incfontdisc_private/catalog.hpp>
+#include <incfontdisc_private/daemon.hpp>
+#include <incfontdisc_private/mapped_file.hpp>
+#include <incfontdisc_private/match_cache.hpp>
+#include <incfontdisc_private/pinned_fonts.hpp>
+#include <incfontdisc_private/validate.hpp>
+
+#include <memory>
+#include <new>
+#include <string>
+
+struct ifd_catalog {
+    std::shared_ptr<const incfontdisc::detail::Catalog> catalog{};
+};
+
+struct ifd_font {
+    std::shared_ptr<const incfontdisc::detail::MappedFile> file{};
+};
+
+namespace {
+
+using namespace incfontdisc;
+
+thread_local std::string last_error{};
+
+ifd_status
+fail(ifd_status status, std::string message) {
+    last_error = std::move(message);
+    return status;
+}
+
+ifd_status
+fail(const Error &error) {
+    return fail(static_cast<ifd_status>(static_cast<int>(error.code) + 1), error.message);
+}
+
+// Nothing may unwind into C callers
+template <typename Fn>
+ifd_status
+guarded(Fn &&fn) {
+    try {
+        return fn();
+    }
+    catch (const std::bad_alloc &) {
+        return fail(IFD_SYSTEM_ERROR, "Out of memory");
+    }
+    catch (...) {
+        return fail(IFD_SYSTEM_ERROR, "Unexpected internal error");
+    }
+}
+
+ifd_str
+view(const std::string &value) {
+    return ifd_str{value.data(), value.size()};
+}
+
+std::optional<std::string>
+optional_string(ifd_str value) {
+    if (! value.data) { return std::nullopt; }
+    return std::string(value.data, value.size);
+}
+
+std::optional<int>
+optional_int(std::int32_t value) {
+    if (value < 0) { return std::nullopt; }
+    return value;
+}
+
+ifd_face
+face_view(const detail::Catalog &catalog, std::uint32_t index) {
+    const auto &face = catalog.faces[index];
+    const auto &font = face.descriptor;
+    return ifd_face{.index   = index,
+                    .handle  = face.handle.value,
+                    .id      = view(font.id.value),
+                    .family  = view(font.family),
+                    .style   = view(font.style),
+                    .weight  = font.weight,
+                    .stretch = font.stretch,
+                    .italic  = font.italic ? 1 : 0};
+}
+
+} // namespace
+
+extern "C" {
+
+const char *
+ifd_last_error(void) {
+    return last_error.c_str();
+}
+
+ifd_status
+ifd_catalog_open(ifd_catalog **out) {
+    if (! out) { return fail(IFD_INVALID_ARGUMENT, "Output pointer is null"); }
+    return guarded([&] {
+        auto snapshot = detail::catalog_store().snapshot();
+        if (! snapshot) { return fail(snapshot.error()); }
+        *out = new ifd_catalog{std::move(*snapshot)};
+        return IFD_OK;
+    });
+}
+
+void
+ifd_catalog_release(ifd_catalog *catalog) {
+    delete catalog;
+}
+
+ifd_status
+ifd_catalog_refresh(void) {
+    return guarded([] {
+        auto refreshed = detail::catalog_store().refresh();
+        if (! refreshed) { return fail(refreshed.error()); }
+        return IFD_OK;
+    });
+}
+
+uint64_t
+ifd_catalog_generation(const ifd_catalog *catalog) {
+    return catalog ? catalog->catalog->generation : 0;
+}
+
+size_t
+ifd_catalog_size(const ifd_catalog *catalog) {
+    return catalog ? catalog->catalog->faces.size() : 0;
+}
+
+ifd_status
+ifd_catalog_face(const ifd_catalog *catalog, size_t index, ifd_face *out) {
+    if (! catalog || ! out) { return fail(IFD_INVALID_ARGUMENT, "Catalog or output pointer is null"); }
+    if (index >= catalog->catalog->faces.size()) { return fail(IFD_INVALID_ARGUMENT, "Face index out of range"); }
+    *out = face_view(*catalog->catalog, static_cast<std::uint32_t>(index));
+    return IFD_OK;
+}
+
+ifd_status
+ifd_catalog_find(const ifd_catalog *catalog, ifd_str id, ifd_face *out) {
+    if (! catalog || ! out || ! id.data) { return fail(IFD_INVALID_ARGUMENT, "Catalog, id or output pointer is null"); }
+    return guarded([&] {
+        auto index = catalog->catalog->find_face(FontId{std::string(id.data, id.size)});
+        if (! index) { return fail(IFD_INVALID_ARGUMENT, "FontId is not part of the catalog"); }
+        *out = face_view(*catalog->catalog, *index);
+        return IFD_OK;
+    });
+}
+
+ifd_status
+ifd_match(const ifd_catalog *catalog, const ifd_query *query, ifd_match_result *out) {
+    if (! catalog || ! query || ! out) { return fail(IFD_INVALID_ARGUMENT, "Catalog, query or output pointer is null"); }
+    return guarded([&] {
+        const FontQuery request{.family  = optional_string(query->family),
+                                .style   = optional_string(query->style),
+                                .weight  = optional_int(query->weight),
+                                .stretch = optional_int(query->stretch),
+                                .italic  = query->italic < 0 ? std::nullopt : std::optional<bool>(query->italic != 0)};
+        auto matched = detail::cached_match(*catalog->catalog, request);
+        if (! matched) { return fail(matched.error()); }
+        *out = ifd_match_result{.face         = face_view(*catalog->catalog, matched->face),
+                                .family_score = matched->family_score,
+                                .face_score   = matched->face_score};
+        return IFD_OK;
+    });
+}
+
+ifd_status
+ifd_map_font(ifd_str id, ifd_font **out, ifd_bytes *data) {
+    if (! id.data || ! out || ! data) { return fail(IFD_INVALID_ARGUMENT, "Id or output pointer is null"); }
+    return guarded([&] {
+        const FontId font_id{std::string(id.data, id.size)};
+        const auto   path = detail::split_font_id(font_id).first;
+        if (path.empty()) { return fail(IFD_INVALID_ARGUMENT, "FontId is empty"); }
+
+        // A pinned file hands out its mapping, otherwise the daemon's descriptor or the path is mapped
+        std::shared_ptr<const detail::MappedFile> file = detail::pinned_fonts().find(path);
+        if (! file) {
+            if (auto remote = detail::daemon_client().map_font_data(font_id)) {
+                if (! *remote) { return fail(remote->error()); }
+                file = std::move(**remote);
+            }
+            else {
+                auto mapped = detail::MappedFile::open(path);
+                if (! mapped) { return fail(mapped.error()); }
+                file = std::move(*mapped);
+            }
+        }
+        const auto bytes = file->bytes();
+        if (auto valid = detail::validation_cache().check(font_id, bytes); ! valid) { return fail(valid.error()); }
+
+        *out  = new ifd_font{std::move(file)};
+        *data = ifd_bytes{reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size()};
+        return IFD_OK;
+    });
+}
+
+void
+ifd_font_release(ifd_font *font) {
+    delete font;
+}
+
+} // extern "C"
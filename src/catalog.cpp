@@ -0,0 +1,980 @@
+#include <incfontdisc_private/backend.hpp>
+#include <incfontdisc_private/catalog.hpp>
+#include <incfontdisc_private/deadline.hpp>
+#include <incfontdisc_private/file_hash.hpp>
+#include <incfontdisc_private/hash.hpp>
+#include <incfontdisc_private/mapped_file.hpp>
+#include <incfontdisc_private/memory.hpp>
+#include <incfontdisc_private/probes.hpp>
+#include <incfontdisc_private/sfnt.hpp>
+#include <incfontdisc_private/thread_pool.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace incfontdisc::detail {
+
+namespace {
+
+constexpr std::size_t build_grain  = 256;
+constexpr std::size_t family_grain = 64;
+constexpr std::size_t max_history  = 8;
+// Catalogs get one index shard per this many faces, system sized ones stay at a single shard
+constexpr std::size_t faces_per_shard = 8192;
+constexpr std::size_t max_shards      = 256;
+// Faces kept per fallback cell, a run rarely needs more than a handful of candidates
+constexpr std::size_t fallback_depth = 16;
+
+int
+levenshtein_distance(const std::string &a, const std::string &b) {
+    if (a == b) { return 0; }
+    if (a.empty()) { return static_cast<int>(b.size()); }
+    if (b.empty()) { return static_cast<int>(a.size()); }
+
+    // Fuzzy passes call this for every family, the rows are reused instead of allocated per call
+    thread_local std::vector<int> prev;
+    thread_local std::vector<int> curr;
+    prev.resize(b.size() + 1);
+    curr.resize(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) { prev[j] = static_cast<int>(j); }
+
+    for (size_t i = 1; i <= a.size(); ++i) {
+        curr[0] = static_cast<int>(i);
+        for (size_t j = 1; j <= b.size(); ++j) {
+            const int cost = (a[i - 1] == b[j - 1]) ? 0 : 1;
+            curr[j]        = std::min({prev[j] + 1, curr[j - 1] + 1, prev[j - 1] + cost});
+        }
+        std::swap(prev, curr);
+    }
+    return prev[b.size()];
+}
+
+// Both arguments are already normalized
+float
+family_similarity(const std::string &norm_candidate, const std::string &norm_query) {
+    if (norm_candidate.empty() || norm_query.empty()) { return 0.0f; }
+    if (norm_candidate == norm_query) { return 1.0f; }
+    const int   max_len = static_cast<int>(std::max(norm_candidate.size(), norm_query.size()));
+    const int   dist    = levenshtein_distance(norm_candidate, norm_query);
+    const float base    = 1.0f - std::min(static_cast<float>(dist) / static_cast<float>(max_len), 1.0f);
+    return std::max(0.0f, base);
+}
+
+// Upper bound of family_similarity from the lengths alone, the edit distance is at least the length difference
+float
+similarity_bound(std::size_t candidate_size, std::size_t query_size) {
+    if (candidate_size == 0 || query_size == 0) { return 0.0f; }
+    const auto max_len = std::max(candidate_size, query_size);
+    const auto delta   = max_len - std::min(candidate_size, query_size);
+    return 1.0f - static_cast<float>(delta) / static_cast<float>(max_len);
+}
+
+// A query reduced to what the face kernels compare, style as an id of Catalog::style_ids
+struct FaceQuery {
+    std::uint32_t       style   = 0;
+    std::int32_t        weight  = 0;
+    std::int32_t        stretch = 0;
+    std::uint8_t        italic  = 0;
+    // One entry per face of the family, only read by kernels for queries with layout requirements
+    const std::uint8_t *allowed = nullptr;
+};
+
+constexpr std::uint32_t no_style = std::numeric_limits<std::uint32_t>::max();
+// Faces the exact pass compares before it checks for a match, big families stop early
+constexpr std::size_t   exact_block = 64;
+
+// Exact pass, one instantiation per combination of set fields (style is always set). Returns the first matching
+// position in [0, count) or count. Blocks have no early exit so each reduces to a branch-free minimum.
+template <bool Weight, bool Stretch, bool Italic, bool Filtered>
+std::size_t
+find_exact(const FaceAttributes &attributes, std::size_t begin, std::size_t count, const FaceQuery &query) {
+    const auto *style   = attributes.style.data() + begin;
+    const auto *weight  = attributes.weight.data() + begin;
+    const auto *stretch = attributes.stretch.data() + begin;
+    const auto *italic  = attributes.italic.data() + begin;
+
+    std::size_t first = count;
+    for (std::size_t block = 0; block < count && first == count; block += exact_block) {
+        const std::size_t end = std::min(count, block + exact_block);
+        for (std::size_t k = block; k < end; ++k) {
+            bool match = style[k] == query.style;
+            if constexpr (Weight) { match &= weight[k] == query.weight; }
+            if constexpr (Stretch) { match &= stretch[k] == query.stretch; }
+            if constexpr (Italic) { match &= italic[k] == query.italic; }
+            if constexpr (Filtered) { match &= query.allowed[k] != 0; }
+            first = std::min(first, match ? k : count);
+        }
+    }
+    return first;
+}
+
+using ExactKernel = std::size_t (*)(const FaceAttributes &, std::size_t, std::size_t, const FaceQuery &);
+
+template <std::size_t Shape>
+constexpr ExactKernel exact_kernel =
+    &find_exact<(Shape & 1) != 0, (Shape & 2) != 0, (Shape & 4) != 0, (Shape & 8) != 0>;
+
+// Indexed by weight | stretch << 1 | italic << 2 | filtered << 3
+constexpr auto exact_kernels = []<std::size_t... Shapes>(std::index_sequence<Shapes...>) {
+    return std::array<ExactKernel, sizeof...(Shapes)>{exact_kernel<Shapes>...};
+}(std::make_index_sequence<16>{});
+
+// Scoring pass, every field is set by then (defaults fill the gaps) so only the layout filter varies. Each field
+// contributes a quarter, the first face with the highest score wins.
+template <bool Filtered>
+std::pair<std::size_t, float>
+best_face(const FaceAttributes &attributes, std::size_t begin, std::size_t count, const FaceQuery &query) {
+    const auto *style   = attributes.style.data() + begin;
+    const auto *weight  = attributes.weight.data() + begin;
+    const auto *stretch = attributes.stretch.data() + begin;
+    const auto *italic  = attributes.italic.data() + begin;
+
+    thread_local std::vector<float> scores;
+    scores.resize(count);
+    const bool query_width_class = query.stretch <= 9;
+    for (std::size_t k = 0; k < count; ++k) {
+        // Width classes (1-9) and percentages never meet on one scale, the range follows the pair
+        const float range  = (stretch[k] <= 9 && query_width_class) ? 8.0f : 150.0f;
+        float       total  = style[k] == query.style ? 1.0f : 0.0f;
+        total             += 1.0f - std::min(std::abs(static_cast<float>(weight[k] - query.weight)) / 900.0f, 1.0f);
+        total             += 1.0f - std::min(std::abs(static_cast<float>(stretch[k] - query.stretch)) / range, 1.0f);
+        total             += italic[k] == query.italic ? 1.0f : 0.0f;
+        scores[k]          = total / 4.0f;
+        if constexpr (Filtered) { scores[k] = query.allowed[k] != 0 ? scores[k] : -1.0f; }
+    }
+
+    std::size_t best = 0;
+    for (std::size_t k = 1; k < count; ++k) { best = scores[k] > scores[best] ? k : best; }
+    return {best, scores[best]};
+}
+
+struct FamilyPick {
+    float         score   = 0.0f;
+    std::uint32_t index   = 0;
+    bool          found   = false;
+    bool          by_name = false;
+    // Families actually scored, fewer than the catalog holds when the deadline cut the fuzzy pass short
+    std::size_t   scanned = 0;
+    // Ties go to the family enumerated first, which is not the one with the lowest index once the catalog is sharded
+    std::uint32_t first_face = 0;
+
+    bool
+    beats(const FamilyPick &other) const {
+        if (! found) { return false; }
+        if (! other.found) { return true; }
+        return score > other.score || (score == other.score && first_face < other.first_face);
+    }
+};
+
+// Layout tags a query asks for, sorted so that support is a std::includes over the tag sets of a face
+struct LayoutRequirements {
+    std::vector<std::uint32_t> scripts{};
+    std::vector<std::uint32_t> features{};
+
+    bool
+    empty() const {
+        return scripts.empty() && features.empty();
+    }
+};
+
+bool
+supports(const Catalog &catalog, const CatalogFace &face, const LayoutRequirements &required) {
+    const auto &layout = catalog.layouts[face.layout];
+    return std::includes(layout.scripts.begin(), layout.scripts.end(), required.scripts.begin(),
+                         required.scripts.end()) &&
+           std::includes(layout.features.begin(), layout.features.end(), required.features.begin(),
+                         required.features.end());
+}
+
+// Families outside 'eligible' (when given) are never picked, not even when the name matches exactly
+FamilyPick
+pick_family(const Catalog &catalog, const std::string &query_family, Deadline deadline,
+            const std::vector<char> *eligible) {
+    if (auto index = catalog.find_family(query_family); index && (! eligible || (*eligible)[*index])) {
+        return FamilyPick{.score = 1.0f, .index = *index, .found = true, .by_name = true, .scanned = 1};
+    }
+
+    // Fuzzy pass fanned out over chunks of the shard-ordered families, then merged. Families whose length alone
+    // rules out beating the chunk's best are not scored.
+    const auto              query_norm = normalize_family(query_family);
+    const auto             &families   = catalog.families;
+    const std::size_t       chunks     = (families.size() + family_grain - 1) / family_grain;
+    std::vector<FamilyPick> partial(chunks);
+    parallel_for(families.size(), family_grain, [&](std::size_t begin, std::size_t end) {
+        // Chunks starting after the deadline are skipped, the ones already running are finished
+        if (expired(deadline)) { return; }
+        FamilyPick best{};
+        for (size_t i = begin; i < end; ++i) {
+            if (eligible && ! (*eligible)[i]) { continue; }
+            const auto &family = families[i];
+            if (best.found && similarity_bound(family.name_norm.size(), query_norm.size()) < best.score) { continue; }
+            const FamilyPick candidate{.score      = family_similarity(family.name_norm, query_norm),
+                                       .index      = static_cast<std::uint32_t>(i),
+                                       .found      = true,
+                                       .first_face = family.faces.front()};
+            if (candidate.score > 0.0f && candidate.beats(best)) { best = candidate; }
+        }
+        best.scanned                  = end - begin;
+        partial[begin / family_grain] = best;
+    });
+
+    FamilyPick  best{};
+    std::size_t scanned = 0;
+    for (const auto &candidate : partial) {
+        scanned += candidate.scanned;
+        if (candidate.beats(best)) { best = candidate; }
+    }
+    best.scanned = scanned;
+    return best;
+}
+
+std::uint64_t
+hash_string(std::string_view value, std::uint64_t seed = 0) {
+    return hash_bytes(std::as_bytes(std::span(value.data(), value.size())), seed);
+}
+
+// Changes when the file behind the face or anything the backend reports about it changes
+std::uint64_t
+face_fingerprint(const FontDescriptor &font, const FileFingerprint &file) {
+    std::uint64_t hash = hash_combine(file.size, static_cast<std::uint64_t>(file.mtime));
+    hash               = hash_string(font.family, hash);
+    hash               = hash_string(font.style, hash);
+    hash = hash_combine(hash, (static_cast<std::uint64_t>(font.weight) << 32) ^ static_cast<std::uint64_t>(font.stretch));
+    return hash_combine(hash, font.italic ? 1 : 0);
+}
+
+// True when 'a' should be kept over its duplicate 'b'
+bool
+preferred(const CatalogFace &a, const CatalogFace &b, DuplicatePolicy policy) {
+    if (policy == DuplicatePolicy::PreferVariable && a.variable != b.variable) { return a.variable; }
+    if (policy == DuplicatePolicy::PreferCff && a.cff != b.cff) { return a.cff; }
+    if (a.file.size != b.file.size) { return a.file.size < b.file.size; }
+    return a.descriptor.id.value < b.descriptor.id.value;
+}
+
+// Points every member that duplicates another face at the face representing it, 'members' in enumeration order.
+// Duplicates share their family, so each family shard is resolved on its own.
+void
+resolve_duplicates(const std::vector<CatalogFace> &faces, std::span<const std::uint32_t> members,
+                   DuplicatePolicy policy, std::vector<std::uint32_t> &primary) {
+    std::unordered_map<std::string, std::uint32_t> by_key;
+    for (const auto i : members) {
+        const auto &face = faces[i];
+        // Without a PostScript name there is not enough identity to call two faces the same
+        if (face.postscript_name.empty()) { continue; }
+        std::string key = face.family_norm;
+        key.append(1, '\0').append(face.style_lower).append(1, '\0').append(face.postscript_name);
+        key.append(1, '\0').append(std::to_string(face.version));
+
+        auto [it, inserted] = by_key.try_emplace(std::move(key), i);
+        if (inserted) { continue; }
+        if (preferred(face, faces[it->second], policy)) {
+            primary[it->second] = i;
+            it->second          = i;
+        }
+        else { primary[i] = it->second; }
+    }
+    // Faces displaced later in the scan point at a face that got displaced too, follow to the final one
+    for (const auto i : members) {
+        auto &target = primary[i];
+        while (primary[target] != target) { target = primary[target]; }
+    }
+}
+
+std::size_t
+shards_for(std::size_t faces) {
+    return std::bit_ceil(std::clamp<std::size_t>(faces / faces_per_shard, 1, max_shards));
+}
+
+// What the optional indices need from a font file
+struct FaceTables {
+    sfnt::LayoutTags         layout{};
+    std::uint64_t            scripts = 0;
+    std::optional<FontGenre> genre{};
+    std::optional<int>       weight{};
+};
+
+FaceTables
+read_face_tables(const FontId &id, const CatalogOptions &options) {
+    // Only the pages of the table directory and of the tables asked for get read
+    const auto [path, index] = split_font_id(id);
+    auto file                = MappedFile::open(path);
+    if (! file) { return {}; }
+    auto font = sfnt::open_font((*file)->bytes(), face_in_file(index));
+    if (! font) { return {}; }
+
+    FaceTables tables{};
+    if (options.layout_index) { tables.layout = sfnt::layout_tags(*font); }
+    if (options.fallback_index) {
+        if (auto cmap = sfnt::CharMap::from_font(*font)) { tables.scripts = script_coverage(*cmap); }
+        tables.genre  = sfnt::genre(*font);
+        tables.weight = sfnt::weight_class(*font);
+    }
+    return tables;
+}
+
+// The face of 'previous' whose index tables still describe 'face', null when its file has to be read
+const CatalogFace *
+known_tables(const Catalog *previous, const CatalogFace &face, const CatalogOptions &options) {
+    if (! previous || (options.layout_index && ! previous->layout_indexed) ||
+        (options.fallback_index && ! previous->fallback_indexed)) {
+        return nullptr;
+    }
+    const auto index = previous->find_face(face.handle);
+    if (! index) { return nullptr; }
+    const auto &known = previous->faces[*index];
+    return known.handle == face.handle && known.fingerprint == face.fingerprint ? &known : nullptr;
+}
+
+// For faces whose file does not tell
+FontGenre
+genre_from_name(std::string_view family_lower) {
+    for (const std::string_view mono : {"mono", "code", "courier", "console", "fixed"}) {
+        if (family_lower.find(mono) != std::string_view::npos) { return FontGenre::Mono; }
+    }
+    const bool serif = family_lower.find("serif") != std::string_view::npos;
+    return serif && family_lower.find("sans") == std::string_view::npos ? FontGenre::Serif : FontGenre::Sans;
+}
+
+// Class mismatches are weighed genre first, then weight, then slant
+int
+fallback_distance(std::size_t face_class, std::size_t wanted_class) {
+    const std::size_t differ = face_class ^ wanted_class;
+    return (face_class / 4 != wanted_class / 4 ? 4 : 0) + ((differ & 2) != 0 ? 2 : 0) + ((differ & 1) != 0 ? 1 : 0);
+}
+
+// Cells keep the closest faces only, the enumeration order breaks ties
+void
+build_fallbacks(Catalog &catalog) {
+    catalog.fallbacks.resize(script_count * fallback_classes);
+    parallel_for(script_count, 1, [&](std::size_t begin, std::size_t end) {
+        std::vector<std::uint32_t> covering;
+        for (std::size_t script = begin; script < end; ++script) {
+            covering.clear();
+            for (std::size_t i = 0; i < catalog.faces.size(); ++i) {
+                if ((catalog.faces[i].scripts >> script) & 1) { covering.push_back(static_cast<std::uint32_t>(i)); }
+            }
+            for (std::size_t wanted = 0; wanted < fallback_classes; ++wanted) {
+                auto closer = [&](std::uint32_t a, std::uint32_t b) {
+                    const int da = fallback_distance(catalog.faces[a].fallback, wanted);
+                    const int db = fallback_distance(catalog.faces[b].fallback, wanted);
+                    return da != db ? da < db : a < b;
+                };
+                auto &cell = catalog.fallbacks[script * fallback_classes + wanted];
+                cell       = covering;
+                const auto depth = std::min(fallback_depth, cell.size());
+                std::partial_sort(cell.begin(), cell.begin() + static_cast<std::ptrdiff_t>(depth), cell.end(), closer);
+                cell.resize(depth);
+                cell.shrink_to_fit();
+            }
+        }
+    });
+}
+
+CatalogMemory
+measure_catalog(const Catalog &catalog) {
+    CatalogMemory memory{.descriptors = heap_bytes(catalog.faces) + heap_bytes(catalog.families)};
+    for (const auto &face : catalog.faces) {
+        const auto &font  = face.descriptor;
+        memory.strings   += heap_bytes(font.id.value) + heap_bytes(font.family) + heap_bytes(font.style) +
+                          heap_bytes(face.family_lower) + heap_bytes(face.style_lower) +
+                          heap_bytes(face.postscript_name);
+        memory.fuzzy_index += heap_bytes(face.family_norm);
+    }
+    memory.descriptors += heap_bytes(catalog.layouts);
+    for (const auto &layout : catalog.layouts) {
+        memory.descriptors += heap_bytes(layout.scripts) + heap_bytes(layout.features);
+    }
+    for (const auto &family : catalog.families) {
+        memory.fuzzy_index  += heap_bytes(family.name_norm);
+        memory.family_index += heap_bytes(family.faces);
+    }
+    memory.family_index += heap_bytes(catalog.shards);
+    memory.family_index += heap_bytes(catalog.attributes.style) + heap_bytes(catalog.attributes.weight) +
+                           heap_bytes(catalog.attributes.stretch) + heap_bytes(catalog.attributes.italic) +
+                           table_bytes(catalog.style_ids);
+    for (const auto &[key, id] : catalog.style_ids) { memory.family_index += heap_bytes(key); }
+    memory.coverage_index = heap_bytes(catalog.fallbacks);
+    for (const auto &cell : catalog.fallbacks) { memory.coverage_index += heap_bytes(cell); }
+    for (const auto &shard : catalog.shards) {
+        memory.family_index += table_bytes(shard.family_by_lower);
+        for (const auto &[key, index] : shard.family_by_lower) { memory.family_index += heap_bytes(key); }
+        memory.id_index += table_bytes(shard.face_by_id) + table_bytes(shard.face_by_handle);
+        for (const auto &[key, index] : shard.face_by_id) { memory.id_index += heap_bytes(key); }
+    }
+    return memory;
+}
+
+} // namespace
+
+std::string
+to_lower(std::string_view value) {
+    std::string lowered;
+    lowered.reserve(value.size());
+    for (unsigned char ch : value) { lowered.push_back(static_cast<char>(std::tolower(ch))); }
+    return lowered;
+}
+
+std::string
+normalize_family(std::string_view value) {
+    std::string normalized;
+    normalized.reserve(value.size());
+    for (unsigned char ch : value) {
+        if (std::isalnum(ch)) { normalized.push_back(static_cast<char>(std::tolower(ch))); }
+    }
+    return normalized;
+}
+
+std::pair<std::string, int>
+split_font_id(const FontId &id) {
+    const auto hash_pos = id.value.rfind('#');
+    if (hash_pos == std::string::npos) { return {id.value, 0}; }
+    std::string path  = id.value.substr(0, hash_pos);
+    int         index = 0;
+    try {
+        index = std::stoi(id.value.substr(hash_pos + 1));
+    }
+    catch (...) {
+        index = 0;
+    }
+    return {std::move(path), index};
+}
+
+std::expected<std::vector<std::uint32_t>, Error>
+parse_tags(const std::vector<std::string> &names) {
+    std::vector<std::uint32_t> tags;
+    tags.reserve(names.size());
+    for (const auto &name : names) {
+        const bool printable = std::all_of(name.begin(), name.end(), [](char ch) { return ch >= 0x20 && ch < 0x7F; });
+        if (name.empty() || name.size() > 4 || ! printable) {
+            return std::unexpected(Error{ErrorCode::InvalidArgument, "Invalid OpenType tag '" + name + "'"});
+        }
+        // Shorter tags are padded with spaces, as in the font
+        const auto padded = name + std::string(4 - name.size(), ' ');
+        tags.push_back(sfnt::make_tag(padded[0], padded[1], padded[2], padded[3]));
+    }
+    std::sort(tags.begin(), tags.end());
+    tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+    return tags;
+}
+
+FontHandle
+handle_of(const FontId &id) {
+    return FontHandle{hash_string(id.value)};
+}
+
+std::optional<std::uint32_t>
+Catalog::find_family(const std::string &family) const {
+    const auto &shard = shards[hash_string(normalize_family(family)) & (shards.size() - 1)];
+    auto        it    = shard.family_by_lower.find(to_lower(family));
+    if (it == shard.family_by_lower.end()) { return std::nullopt; }
+    return shard.family_begin + it->second;
+}
+
+std::optional<std::uint32_t>
+Catalog::find_face(const FontId &id) const {
+    const auto &shard = shards[handle_of(id).value & (shards.size() - 1)];
+    auto        it    = shard.face_by_id.find(id.value);
+    if (it == shard.face_by_id.end()) { return std::nullopt; }
+    return it->second;
+}
+
+std::optional<std::uint32_t>
+Catalog::find_face(FontHandle handle) const {
+    const auto &shard = shards[handle.value & (shards.size() - 1)];
+    auto        it    = shard.face_by_handle.find(handle.value);
+    if (it == shard.face_by_handle.end()) { return std::nullopt; }
+    return it->second;
+}
+
+void
+BuildControl::start(RefreshPhase phase, std::size_t total) {
+    if (! progress_) { return; }
+    std::lock_guard lock(mutex_);
+    current_ = RefreshProgress{phase, 0, total};
+    progress_(current_);
+}
+
+void
+BuildControl::advance(std::size_t count) {
+    if (! progress_) { return; }
+    std::lock_guard lock(mutex_);
+    current_.done += count;
+    progress_(current_);
+}
+
+Error
+cancelled_error(const std::string &operation) {
+    return Error{ErrorCode::Cancelled, operation + " was cancelled"};
+}
+
+std::expected<std::shared_ptr<Catalog>, Error>
+build_catalog(std::vector<FaceRecord> fonts, const CatalogOptions &options, BuildControl *control,
+              const Catalog *previous) {
+    auto stopped = [&] { return control && control->stopped(); };
+    if (control) { control->start(RefreshPhase::Scan, fonts.size()); }
+
+    std::vector<CatalogFace>      faces(fonts.size());
+    std::vector<std::uint64_t>    family_hash(fonts.size());
+    std::vector<sfnt::LayoutTags> layouts(options.layout_index ? fonts.size() : 0);
+    parallel_for(fonts.size(), build_grain, [&](std::size_t begin, std::size_t end) {
+        // The file reads are the slow part, progress and the stop token are checked between blocks of them
+        for (std::size_t block = begin; block < end; block += build_grain) {
+            if (stopped()) { return; }
+            const std::size_t block_end = std::min(end, block + build_grain);
+            for (std::size_t i = block; i < block_end; ++i) {
+                auto &face           = faces[i];
+                face.descriptor      = std::move(fonts[i].descriptor);
+                face.family_lower    = to_lower(face.descriptor.family);
+                face.family_norm     = normalize_family(face.descriptor.family);
+                face.style_lower     = to_lower(face.descriptor.style);
+                face.handle          = handle_of(face.descriptor.id);
+                family_hash[i]       = hash_string(face.family_norm);
+                face.postscript_name = std::move(fonts[i].postscript_name);
+                face.version         = fonts[i].version;
+                face.variable        = fonts[i].variable;
+                face.cff             = fonts[i].cff;
+
+                face.file        = file_fingerprint(split_font_id(face.descriptor.id).first).value_or(FileFingerprint{});
+                face.fingerprint = face_fingerprint(face.descriptor, face.file);
+                if (const auto *known = known_tables(previous, face, options)) {
+                    if (options.layout_index) { layouts[i] = previous->layouts[known->layout]; }
+                    face.scripts  = known->scripts;
+                    face.fallback = known->fallback;
+                }
+                else if (options.layout_index || options.fallback_index) {
+                    auto tables = read_face_tables(face.descriptor.id, options);
+                    if (options.layout_index) { layouts[i] = std::move(tables.layout); }
+                    face.scripts  = tables.scripts;
+                    face.fallback = static_cast<std::uint8_t>(fallback_class(FallbackStyle{
+                        .genre  = tables.genre.value_or(genre_from_name(face.family_lower)),
+                        .bold   = tables.weight.value_or(face.descriptor.weight) >= 600,
+                        .italic = face.descriptor.italic,
+                    }));
+                }
+            }
+            if (control) { control->advance(block_end - block); }
+        }
+    });
+    if (stopped()) { return std::unexpected(cancelled_error("Catalog build")); }
+
+    // Few distinct tag sets exist, each is stored once and faces refer to it by index (0 is the empty set)
+    auto catalog            = std::make_shared<Catalog>();
+    catalog->layout_indexed = options.layout_index;
+    catalog->layouts.emplace_back();
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> layout_by_hash;
+    for (std::size_t i = 0; i < layouts.size(); ++i) {
+        if (layouts[i] == sfnt::LayoutTags{}) { continue; }
+        const auto hash = hash_values(std::span<const std::uint32_t>(layouts[i].features),
+                                      hash_values(std::span<const std::uint32_t>(layouts[i].scripts)));
+        auto      &same = layout_by_hash[hash];
+        auto       it   = std::find_if(same.begin(), same.end(),
+                                       [&](std::uint32_t index) { return catalog->layouts[index] == layouts[i]; });
+        if (it != same.end()) {
+            faces[i].layout = *it;
+            continue;
+        }
+        faces[i].layout = static_cast<std::uint32_t>(catalog->layouts.size());
+        same.push_back(faces[i].layout);
+        catalog->layouts.push_back(std::move(layouts[i]));
+    }
+
+    // Families (and with them all duplicates) are routed to a shard by their normalized name, ids by their handle
+    const std::size_t                       shard_count = shards_for(faces.size());
+    const std::size_t                       shard_mask  = shard_count - 1;
+    std::vector<std::vector<std::uint32_t>> by_family(shard_count);
+    std::vector<std::vector<std::uint32_t>> by_handle(shard_count);
+    for (std::size_t i = 0; i < faces.size(); ++i) {
+        by_family[family_hash[i] & shard_mask].push_back(static_cast<std::uint32_t>(i));
+        by_handle[faces[i].handle.value & shard_mask].push_back(static_cast<std::uint32_t>(i));
+    }
+
+    std::vector<std::uint32_t> primary(faces.size());
+    std::iota(primary.begin(), primary.end(), std::uint32_t{0});
+    if (options.duplicates != DuplicatePolicy::KeepAll) {
+        parallel_for(shard_count, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t shard = begin; shard < end; ++shard) {
+                resolve_duplicates(faces, by_family[shard], options.duplicates, primary);
+            }
+        });
+    }
+
+    // Kept faces in enumeration order, the ids of dropped duplicates resolve to the face that represents them
+    std::vector<std::uint32_t> kept_index(faces.size());
+    catalog->faces.reserve(faces.size());
+    for (std::size_t i = 0; i < faces.size(); ++i) {
+        if (primary[i] != i) { continue; }
+        kept_index[i] = static_cast<std::uint32_t>(catalog->faces.size());
+        catalog->faces.push_back(std::move(faces[i]));
+    }
+    catalog->duplicates = faces.size() - catalog->faces.size();
+
+    if (control) { control->start(RefreshPhase::Index, shard_count); }
+    catalog->shards.resize(shard_count);
+    std::vector<std::vector<CatalogFamily>> shard_families(shard_count);
+    parallel_for(shard_count, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t index = begin; index < end && ! stopped(); ++index) {
+            auto &shard = catalog->shards[index];
+            shard.face_by_id.reserve(by_handle[index].size());
+            shard.face_by_handle.reserve(by_handle[index].size());
+            // Dropped duplicates resolve to the face kept in their place, by id as well as by handle
+            for (const auto i : by_handle[index]) {
+                if (primary[i] == i) { continue; }
+                shard.face_by_id.try_emplace(faces[i].descriptor.id.value, kept_index[primary[i]]);
+                shard.face_by_handle.try_emplace(faces[i].handle.value, kept_index[primary[i]]);
+            }
+            for (const auto i : by_handle[index]) {
+                if (primary[i] != i) { continue; }
+                const auto &face = catalog->faces[kept_index[i]];
+                shard.face_by_id.insert_or_assign(face.descriptor.id.value, kept_index[i]);
+                shard.face_by_handle.insert_or_assign(face.handle.value, kept_index[i]);
+            }
+
+            auto                                                &families = shard_families[index];
+            std::unordered_map<std::string_view, std::uint32_t> family_by_norm;
+            for (const auto i : by_family[index]) {
+                if (primary[i] != i) { continue; }
+                const auto &face = catalog->faces[kept_index[i]];
+                if (face.descriptor.family.empty()) { continue; }
+
+                auto [it, inserted] =
+                    family_by_norm.try_emplace(face.family_norm, static_cast<std::uint32_t>(families.size()));
+                if (inserted) { families.push_back(CatalogFamily{.name_norm = face.family_norm}); }
+                families[it->second].faces.push_back(kept_index[i]);
+                shard.family_by_lower.try_emplace(face.family_lower, it->second);
+            }
+            if (control) { control->advance(1); }
+        }
+    });
+    if (stopped()) { return std::unexpected(cancelled_error("Catalog build")); }
+    for (std::size_t index = 0; index < shard_count; ++index) {
+        auto &shard        = catalog->shards[index];
+        shard.family_begin = static_cast<std::uint32_t>(catalog->families.size());
+        std::move(shard_families[index].begin(), shard_families[index].end(), std::back_inserter(catalog->families));
+        shard.family_end = static_cast<std::uint32_t>(catalog->families.size());
+    }
+
+    auto &attributes = catalog->attributes;
+    attributes.style.reserve(catalog->faces.size());
+    attributes.weight.reserve(catalog->faces.size());
+    attributes.stretch.reserve(catalog->faces.size());
+    attributes.italic.reserve(catalog->faces.size());
+    for (auto &family : catalog->families) {
+        family.attributes = static_cast<std::uint32_t>(attributes.style.size());
+        for (const auto index : family.faces) {
+            const auto &face = catalog->faces[index];
+            attributes.style.push_back(
+                catalog->style_ids.try_emplace(face.style_lower, static_cast<std::uint32_t>(catalog->style_ids.size()))
+                    .first->second);
+            attributes.weight.push_back(face.descriptor.weight);
+            attributes.stretch.push_back(face.descriptor.stretch);
+            attributes.italic.push_back(face.descriptor.italic ? 1 : 0);
+        }
+    }
+    catalog->fallback_indexed = options.fallback_index;
+    if (options.fallback_index) { build_fallbacks(*catalog); }
+
+    // Kept faces in catalog order plus the options that change what matching returns
+    std::vector<std::uint64_t> identity;
+    identity.reserve(catalog->faces.size() * 2 + 1);
+    identity.push_back(static_cast<std::uint64_t>(options.duplicates) | (options.layout_index ? 0x100u : 0u) |
+                       (options.fallback_index ? 0x200u : 0u));
+    for (const auto &face : catalog->faces) {
+        identity.push_back(face.handle.value);
+        identity.push_back(face.fingerprint);
+    }
+    catalog->fingerprint = hash_values(std::span<const std::uint64_t>(identity));
+    catalog->memory = measure_catalog(*catalog);
+    return catalog;
+}
+
+std::expected<FaceMatch, Error>
+match_face_in_catalog(const Catalog &catalog, FontQuery query, MatchStats *stats, Deadline deadline) {
+    if (! query.family) { return std::unexpected(Error{ErrorCode::InvalidArgument, "FontQuery.family must be set"}); }
+
+    LayoutRequirements required{};
+    if (auto scripts = parse_tags(query.scripts)) { required.scripts = std::move(*scripts); }
+    else { return std::unexpected(scripts.error()); }
+    if (auto features = parse_tags(query.features)) { required.features = std::move(*features); }
+    else { return std::unexpected(features.error()); }
+    const bool filtered = ! required.empty();
+    if (filtered && ! catalog.layout_indexed) {
+        return std::unexpected(
+            Error{ErrorCode::InvalidArgument, "Scripts and features need a catalog built with layout_index"});
+    }
+
+    using Clock        = std::chrono::steady_clock;
+    const auto started = stats ? Clock::now() : Clock::time_point{};
+    // Layout requirements are answered from the catalog, only families with a supporting face take part
+    std::vector<char> eligible;
+    if (filtered) {
+        eligible.resize(catalog.families.size());
+        for (std::size_t i = 0; i < catalog.families.size(); ++i) {
+            const auto &faces = catalog.families[i].faces;
+            eligible[i]       = std::any_of(faces.begin(), faces.end(), [&](std::uint32_t face) {
+                return supports(catalog, catalog.faces[face], required);
+            });
+        }
+    }
+    const auto pick   = pick_family(catalog, *query.family, deadline, filtered ? &eligible : nullptr);
+    const auto picked = stats ? Clock::now() : Clock::time_point{};
+    if (! pick.found && pick.scanned < catalog.families.size()) {
+        return std::unexpected(timeout_error("Family matching"));
+    }
+    if (! pick.found || catalog.families[pick.index].name_norm.empty()) {
+        if (filtered) {
+            return std::unexpected(
+                Error{ErrorCode::NoFontsFound, "No installed face supports the required scripts and features"});
+        }
+        return std::unexpected(
+            Error{ErrorCode::NoFontsFound, "No fonts found on the system, this should be impossible."});
+    }
+    const auto &family  = catalog.families[pick.index];
+    const bool  partial = ! pick.by_name && pick.scanned < catalog.families.size();
+
+    std::size_t scored = 0;
+    auto        record = [&](MatchPath path) {
+        if (! stats) { return; }
+        stats->path             = pick.by_name ? path : MatchPath::Substitution;
+        stats->families_scanned = pick.scanned;
+        stats->faces_scored     = scored;
+        stats->family_phase     = picked - started;
+        stats->face_phase       = Clock::now() - picked;
+    };
+
+    if (! query.style) { query.style = "Regular"; }
+    const auto style = catalog.style_ids.find(to_lower(*query.style));
+
+    FaceQuery face_query{.style   = style != catalog.style_ids.end() ? style->second : no_style,
+                         .weight  = query.weight.value_or(400),
+                         .stretch = query.stretch.value_or(100),
+                         .italic  = static_cast<std::uint8_t>(query.italic.value_or(false))};
+    std::vector<std::uint8_t> allowed;
+    if (filtered) {
+        allowed.reserve(family.faces.size());
+        for (auto face_index : family.faces) {
+            allowed.push_back(supports(catalog, catalog.faces[face_index], required) ? 1 : 0);
+        }
+        face_query.allowed = allowed.data();
+    }
+
+    // The shape of the query picks the kernel once, the loops over the family carry no per-field branches
+    const std::size_t count = family.faces.size();
+    const std::size_t shape =
+        (query.weight ? 1 : 0) | (query.stretch ? 2 : 0) | (query.italic ? 4 : 0) | (filtered ? 8 : 0);
+    scored = count;
+    if (const auto exact = exact_kernels[shape](catalog.attributes, family.attributes, count, face_query);
+        exact < count) {
+        record(MatchPath::Exact);
+        return FaceMatch{
+            .face = family.faces[exact], .family_score = pick.score, .face_score = 1.0f, .partial = partial};
+    }
+
+    const auto [best, score] = filtered ? best_face<true>(catalog.attributes, family.attributes, count, face_query)
+                                        : best_face<false>(catalog.attributes, family.attributes, count, face_query);
+    scored += count;
+    record(MatchPath::Fuzzy);
+    return FaceMatch{.face = family.faces[best], .family_score = pick.score, .face_score = score, .partial = partial};
+}
+
+bool
+needs_layout_index(const FontQuery &query) {
+    return ! query.scripts.empty() || ! query.features.empty();
+}
+
+std::expected<FontMatch, Error>
+match_in_catalog(const Catalog &catalog, FontQuery query, MatchStats *stats, Deadline deadline) {
+    auto matched = match_face_in_catalog(catalog, std::move(query), stats, deadline);
+    if (! matched) { return std::unexpected(matched.error()); }
+    return FontMatch{.font         = catalog.faces[matched->face].descriptor,
+                     .family_score = matched->family_score,
+                     .face_score   = matched->face_score};
+}
+
+std::expected<std::shared_ptr<Catalog>, Error>
+CatalogStore::rebuild(RefreshStats *stats, const CatalogOptions &options,
+                      const std::shared_ptr<const std::vector<FaceRecord>> &registered, BuildControl *control,
+                      const Catalog *previous) {
+    const auto started = std::chrono::steady_clock::now();
+    if (control) { control->start(RefreshPhase::Enumerate, 0); }
+    INCFONTDISC_PROBE0(enumerate__start);
+    auto enumerated = registered ? std::expected<std::vector<FaceRecord>, Error>(*registered)
+                                 : backend_instance().enumerate_fonts();
+    if (! enumerated) {
+        INCFONTDISC_PROBE2(enumerate__end, 0, 0);
+        return std::unexpected(enumerated.error());
+    }
+    INCFONTDISC_PROBE2(enumerate__end, static_cast<int>(enumerated->size()), 1);
+
+    if (control && control->stopped()) { return std::unexpected(cancelled_error("Catalog build")); }
+
+    const auto enumerated_at = std::chrono::steady_clock::now();
+    auto       catalog       = build_catalog(std::move(*enumerated), options, control, previous);
+    if (! catalog) { return catalog; }
+    if (stats) {
+        stats->faces           = (*catalog)->faces.size();
+        stats->enumerate_phase = enumerated_at - started;
+        stats->index_phase     = std::chrono::steady_clock::now() - enumerated_at;
+    }
+    return catalog;
+}
+
+std::expected<std::shared_ptr<const Catalog>, Error>
+CatalogStore::snapshot() {
+    if (auto catalog = current()) {
+        INCFONTDISC_PROBE1(cache__hit, "catalog");
+        return catalog;
+    }
+
+    // Builds are serialized like refreshes, readers of current() never wait for one
+    std::lock_guard                                refresh_lock(refresh_mutex_);
+    CatalogOptions                                 options;
+    std::shared_ptr<const std::vector<FaceRecord>> registered;
+    {
+        std::lock_guard lock(mutex_);
+        if (catalog_) { return catalog_; }
+        options    = options_;
+        registered = registered_;
+    }
+    INCFONTDISC_PROBE1(cache__miss, "catalog");
+    auto built = rebuild(nullptr, options, registered, nullptr, nullptr);
+    if (! built) { return std::unexpected(built.error()); }
+
+    std::lock_guard lock(mutex_);
+    if (! catalog_) { install_locked(std::move(*built)); }
+    return catalog_;
+}
+
+std::expected<std::shared_ptr<const Catalog>, Error>
+CatalogStore::indexed_snapshot(bool layout_index, bool fallback_index) {
+    auto catalog = snapshot();
+    if (! catalog) { return catalog; }
+    if ((! layout_index || (*catalog)->layout_indexed) && (! fallback_index || (*catalog)->fallback_indexed)) {
+        return catalog;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        options_.layout_index   = options_.layout_index || layout_index;
+        options_.fallback_index = options_.fallback_index || fallback_index;
+    }
+    if (auto refreshed = refresh(); ! refreshed) { return std::unexpected(refreshed.error()); }
+    return snapshot();
+}
+
+std::expected<void, Error>
+CatalogStore::refresh(RefreshStats *stats, BuildControl *control) {
+    // Readers keep using the previous snapshot while the new one is being built
+    std::lock_guard refresh_lock(refresh_mutex_);
+    CatalogOptions                                 options;
+    std::shared_ptr<const std::vector<FaceRecord>> registered;
+    std::shared_ptr<const Catalog>                 previous;
+    {
+        std::lock_guard lock(mutex_);
+        options    = options_;
+        registered = registered_;
+        previous   = catalog_;
+    }
+    // Files that did not change are not opened again
+    auto built = rebuild(stats, options, registered, control, previous.get());
+    if (! built) { return std::unexpected(built.error()); }
+
+    std::lock_guard lock(mutex_);
+    // A stop that arrives while the build finishes still wins, the caller has been told nothing yet
+    if (control && control->stopped()) { return std::unexpected(cancelled_error("Catalog build")); }
+    install_locked(std::move(*built));
+    return {};
+}
+
+void
+CatalogStore::install_locked(std::shared_ptr<Catalog> catalog) {
+    catalog->generation = ++last_generation_;
+
+    auto faces = std::make_shared<std::vector<FaceState>>();
+    faces->reserve(catalog->faces.size());
+    for (const auto &face : catalog->faces) { faces->push_back(FaceState{face.handle.value, face.fingerprint}); }
+    std::sort(faces->begin(), faces->end(), [](const FaceState &a, const FaceState &b) { return a.handle < b.handle; });
+    history_.push_back(Generation{catalog->generation, std::move(faces)});
+    if (history_.size() > max_history) { history_.pop_front(); }
+
+    catalog_ = std::move(catalog);
+}
+
+std::expected<void, Error>
+CatalogStore::configure(CatalogOptions options) {
+    bool built = false;
+    {
+        std::lock_guard lock(mutex_);
+        options_ = options;
+        built    = catalog_ != nullptr;
+    }
+    if (! built) { return {}; }
+    return refresh();
+}
+
+std::expected<void, Error>
+CatalogStore::register_faces(std::vector<FaceRecord> faces) {
+    {
+        std::lock_guard lock(mutex_);
+        registered_ = faces.empty() ? nullptr : std::make_shared<const std::vector<FaceRecord>>(std::move(faces));
+    }
+    return refresh();
+}
+
+std::expected<CatalogDiff, Error>
+CatalogStore::diff(std::uint64_t old_generation, std::uint64_t new_generation) {
+    std::shared_ptr<const std::vector<FaceState>> before, after;
+    {
+        std::lock_guard lock(mutex_);
+        for (const auto &entry : history_) {
+            if (entry.generation == old_generation) { before = entry.faces; }
+            if (entry.generation == new_generation) { after = entry.faces; }
+        }
+    }
+    if (! before || ! after) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Catalog generation is not retained anymore"});
+    }
+
+    // Both sides are sorted by handle, a single merge pass classifies every face
+    CatalogDiff diff{.from = old_generation, .to = new_generation};
+    auto        old_it = before->begin();
+    auto        new_it = after->begin();
+    while (old_it != before->end() || new_it != after->end()) {
+        if (new_it == after->end() || (old_it != before->end() && old_it->handle < new_it->handle)) {
+            diff.removed.push_back(FaceChange{FontHandle{old_it->handle}, old_it->fingerprint});
+            ++old_it;
+        }
+        else if (old_it == before->end() || new_it->handle < old_it->handle) {
+            diff.added.push_back(FaceChange{FontHandle{new_it->handle}, new_it->fingerprint});
+            ++new_it;
+        }
+        else {
+            if (old_it->fingerprint != new_it->fingerprint) {
+                diff.modified.push_back(FaceChange{FontHandle{new_it->handle}, new_it->fingerprint});
+            }
+            ++old_it;
+            ++new_it;
+        }
+    }
+    return diff;
+}
+
+std::shared_ptr<const Catalog>
+CatalogStore::current() {
+    std::lock_guard lock(mutex_);
+    return catalog_;
+}
+
+CatalogStore &
+catalog_store() {
+    static CatalogStore store{};
+    return store;
+}
+
+} // namespace incfontdisc::detail
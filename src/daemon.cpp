@@ -0,0 +1,700 @@
+#include <incfontdisc_private/catalog.hpp>
+#include <incfontdisc_private/daemon.hpp>
+#include <incfontdisc_private/deadline.hpp>
+#include <incfontdisc_private/match_cache.hpp>
+#include <incfontdisc_private/thread_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#if defined(INCFONTDISC_HAS_UNIX_SOCKETS)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace incfontdisc::detail {
+
+#if defined(INCFONTDISC_HAS_UNIX_SOCKETS)
+
+namespace {
+
+using protocol::FrameHeader;
+using protocol::Op;
+
+constexpr auto request_timeout = std::chrono::seconds(5);
+
+Error
+error_from_response(const std::string &payload, std::uint8_t status) {
+    protocol::Reader reader(payload);
+    auto             message = reader.str();
+    return Error{static_cast<ErrorCode>(status - 1), reader.ok() ? std::move(message) : "Malformed daemon response"};
+}
+
+std::string
+error_payload(const Error &error) {
+    protocol::Writer writer;
+    writer.str(error.message);
+    return writer.data();
+}
+
+bool
+fill_address(const std::string &path, sockaddr_un &address) {
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) { return false; }
+    address            = {};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Waits until 'fd' is ready for 'events', false once the deadline passed
+bool
+wait_ready(int fd, short events, Deadline deadline) {
+    for (;;) {
+        int timeout = -1;
+        if (bounded(deadline)) {
+            const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - Deadline::clock::now()).count();
+            if (left <= 0) { return false; }
+            timeout = static_cast<int>(std::min<decltype(left)>(left, 60'000));
+        }
+        pollfd    entry{.fd = fd, .events = events, .revents = 0};
+        const int ready = ::poll(&entry, 1, timeout);
+        if (ready < 0 && errno != EINTR) { return false; }
+        // Hangups and errors count as ready, the following send or receive reports them
+        if (ready > 0) { return true; }
+    }
+}
+
+// Sends and receives never block past 'deadline', a false return after it passed means the peer was too slow
+bool
+send_frame(int fd, Op op, std::uint8_t status, const std::string &payload, int pass_fd = -1,
+           Deadline deadline = Deadline::max()) {
+    FrameHeader header{.size = static_cast<std::uint32_t>(payload.size()), .op = static_cast<std::uint8_t>(op),
+                       .status = status};
+
+    iovec iov[2]{
+        {&header, sizeof(header)},
+        {const_cast<char *>(payload.data()), payload.size()},
+    };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+
+    msghdr message{};
+    message.msg_iov    = iov;
+    message.msg_iovlen = payload.empty() ? 1 : 2;
+    if (pass_fd >= 0) {
+        message.msg_control    = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr *cmsg          = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level       = SOL_SOCKET;
+        cmsg->cmsg_type        = SCM_RIGHTS;
+        cmsg->cmsg_len         = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &pass_fd, sizeof(int));
+    }
+
+    // The descriptor rides along with the first byte, the remainder goes out as plain data
+    std::size_t total = sizeof(header) + payload.size();
+    std::size_t sent  = 0;
+    while (sent < total) {
+        if (! wait_ready(fd, POLLOUT, deadline)) { return false; }
+        constexpr int flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+        ssize_t       rc    = 0;
+        if (sent == 0) { rc = ::sendmsg(fd, &message, flags); }
+        else if (sent < sizeof(header)) {
+            rc = ::send(fd, reinterpret_cast<const char *>(&header) + sent, sizeof(header) - sent, flags);
+        }
+        else {
+            rc = ::send(fd, payload.data() + (sent - sizeof(header)), total - sent, flags);
+        }
+        if (rc < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) { continue; }
+        if (rc <= 0) { return false; }
+        sent += static_cast<std::size_t>(rc);
+    }
+    return true;
+}
+
+// Reads exactly 'size' bytes, picking up a passed descriptor if one arrives on the way
+bool
+recv_exact(int fd, void *out, std::size_t size, int *received_fd, Deadline deadline) {
+    auto       *cursor = static_cast<char *>(out);
+    std::size_t done   = 0;
+    while (done < size) {
+        if (! wait_ready(fd, POLLIN, deadline)) { return false; }
+        iovec                 iov{cursor + done, size - done};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+        msghdr                message{};
+        message.msg_iov        = &iov;
+        message.msg_iovlen     = 1;
+        message.msg_control    = control;
+        message.msg_controllen = sizeof(control);
+
+        const ssize_t rc = ::recvmsg(fd, &message, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+        if (rc < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) { continue; }
+        if (rc <= 0) { return false; }
+
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) { continue; }
+            int passed = -1;
+            std::memcpy(&passed, CMSG_DATA(cmsg), sizeof(int));
+            if (received_fd && *received_fd < 0) { *received_fd = passed; }
+            else { ::close(passed); }
+        }
+        done += static_cast<std::size_t>(rc);
+    }
+    return true;
+}
+
+bool
+recv_frame(int fd, FrameHeader &header, std::string &payload, int *received_fd, Deadline deadline = Deadline::max()) {
+    if (! recv_exact(fd, &header, sizeof(header), received_fd, deadline)) { return false; }
+    if (header.version != protocol::version || header.size > protocol::max_frame_size) { return false; }
+    payload.resize(header.size);
+    return header.size == 0 || recv_exact(fd, payload.data(), header.size, received_fd, deadline);
+}
+
+// Both ends of the socket must belong to the same user, a foreign daemon could answer with forged matches and files
+bool
+peer_is_same_user(int fd) {
+#if defined(__linux__)
+    ucred     credentials{};
+    socklen_t length = sizeof(credentials);
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) { return false; }
+    return credentials.uid == ::getuid();
+#else
+    uid_t user  = 0;
+    gid_t group = 0;
+    if (::getpeereid(fd, &user, &group) != 0) { return false; }
+    return user == ::getuid();
+#endif
+}
+
+// Copies the file for callers that want their own bytes, positioned reads leave the shared file offset alone
+std::expected<ByteBuffer, Error>
+read_passed_file(int fd) {
+    struct stat info{};
+    if (::fstat(fd, &info) != 0) {
+        return std::unexpected(Error{ErrorCode::SystemError, "Failed to stat font file received from daemon"});
+    }
+    if (info.st_size <= 0) { return std::unexpected(Error{ErrorCode::SystemError, "Font file is empty"}); }
+
+    ByteBuffer  buffer(static_cast<std::size_t>(info.st_size));
+    std::size_t done = 0;
+    while (done < buffer.size()) {
+        const auto got = ::pread(fd, buffer.data() + done, buffer.size() - done, static_cast<off_t>(done));
+        if (got < 0 && errno == EINTR) { continue; }
+        if (got <= 0) {
+            return std::unexpected(Error{ErrorCode::SystemError, "Failed to read font file received from daemon"});
+        }
+        done += static_cast<std::size_t>(got);
+    }
+    return buffer;
+}
+
+// Server side connection, requests are assembled here without blocking and only complete frames reach a worker
+struct Connection {
+    int         fd = -1;
+    std::string inbox{};
+    Deadline    deadline = Deadline::max(); // Set while a frame is partially received
+};
+
+enum class FrameState {
+    Partial,
+    Complete,
+    Invalid,
+};
+
+// Reads whatever the client has sent so far, false once the peer is gone
+bool
+receive_available(Connection &connection) {
+    char buffer[64 * 1024];
+    for (;;) {
+        const ssize_t rc = ::recv(connection.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (rc < 0 && errno == EINTR) { continue; }
+        if (rc < 0) { return errno == EAGAIN || errno == EWOULDBLOCK; }
+        if (rc == 0) { return false; }
+        connection.inbox.append(buffer, static_cast<std::size_t>(rc));
+        if (connection.inbox.size() > sizeof(FrameHeader) + protocol::max_frame_size) { return false; }
+    }
+}
+
+FrameState
+take_frame(Connection &connection, FrameHeader &header, std::string &payload) {
+    if (connection.inbox.size() < sizeof(header)) { return FrameState::Partial; }
+    std::memcpy(&header, connection.inbox.data(), sizeof(header));
+    if (header.version != protocol::version || header.size > protocol::max_frame_size) { return FrameState::Invalid; }
+    if (connection.inbox.size() < sizeof(header) + header.size) { return FrameState::Partial; }
+    payload.assign(connection.inbox, sizeof(header), header.size);
+    connection.inbox.erase(0, sizeof(header) + header.size);
+    return FrameState::Complete;
+}
+
+// Server side handling of a single request, returns false when the connection should be dropped
+bool
+serve_request(int fd, const FrameHeader &header, const std::string &payload, const std::stop_token &stop_token) {
+    // A client that does not take its answer in time is dropped
+    const auto op    = static_cast<Op>(header.op);
+    auto       reply = [&](std::uint8_t status, const std::string &data, int pass_fd = -1) {
+        return send_frame(fd, op, status, data, pass_fd, Deadline::clock::now() + request_timeout);
+    };
+    auto fail = [&](const Error &error) {
+        return reply(static_cast<std::uint8_t>(error.code) + 1, error_payload(error));
+    };
+
+    protocol::Reader reader(payload);
+    protocol::Writer writer;
+
+    if (op == Op::Refresh) {
+        // Shutting down abandons a rescan in progress
+        BuildControl control(stop_token, {});
+        auto         refreshed = catalog_store().refresh(nullptr, &control);
+        if (! refreshed) { return fail(refreshed.error()); }
+        return reply(0, {});
+    }
+
+    auto catalog = catalog_store().snapshot();
+    if (! catalog) { return fail(catalog.error()); }
+    const Catalog &snapshot = **catalog;
+
+    switch (op) {
+        case Op::List: {
+            writer.u64(snapshot.faces.size());
+            for (const auto &face : snapshot.faces) { writer.descriptor(face.descriptor); }
+            return reply(0, writer.data());
+        }
+        case Op::Match: {
+            auto query = reader.query();
+            if (! reader.at_end()) { return fail(Error{ErrorCode::InvalidArgument, "Malformed match request"}); }
+            auto indexed = needs_layout_index(query) ? catalog_store().indexed_snapshot(true, false) : catalog;
+            if (! indexed) { return fail(indexed.error()); }
+            auto matched = cached_match(**indexed, query);
+            if (! matched) { return fail(matched.error()); }
+            writer.descriptor((*indexed)->faces[matched->face].descriptor);
+            writer.f32(matched->family_score);
+            writer.f32(matched->face_score);
+            return reply(0, writer.data());
+        }
+        case Op::Describe:
+        case Op::Load: {
+            FontId id{reader.str()};
+            if (! reader.at_end()) { return fail(Error{ErrorCode::InvalidArgument, "Malformed request"}); }
+            auto face = snapshot.find_face(id);
+            // Only files that are part of the catalog are ever handed out
+            if (! face) { return fail(Error{ErrorCode::InvalidArgument, "FontId is not part of the catalog"}); }
+            if (op == Op::Describe) {
+                writer.descriptor(snapshot.faces[*face].descriptor);
+                return reply(0, writer.data());
+            }
+
+            // A dropped duplicate is served from the file of the face kept in its place, the one Describe reports
+            const auto path = split_font_id(snapshot.faces[*face].descriptor.id).first;
+            const int  file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (file < 0) { return fail(Error{ErrorCode::SystemError, "Failed to open font file"}); }
+            const bool sent = reply(0, {}, file);
+            ::close(file);
+            return sent;
+        }
+        default: return fail(Error{ErrorCode::NotImplemented, "Unknown daemon request"});
+    }
+}
+
+} // namespace
+
+std::string
+default_socket_path() {
+    if (const char *explicit_path = std::getenv("INCFONTDISC_SOCKET"); explicit_path && *explicit_path) {
+        return explicit_path;
+    }
+    // Only the per-user runtime directory is private to the user, a shared directory such as /tmp would let anyone
+    // create the socket first
+    if (const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR"); runtime_dir && *runtime_dir) {
+        return std::string(runtime_dir) + "/incfontdisc.sock";
+    }
+    return {};
+}
+
+void
+DaemonClient::configure(DaemonClientOptions options) {
+    std::lock_guard lock(mutex_);
+    disconnect_locked();
+    options_     = std::move(options);
+    retry_at_    = {};
+    retry_delay_ = std::chrono::seconds(0);
+}
+
+void
+DaemonClient::disconnect_locked() {
+    if (fd_ >= 0) { ::close(fd_); }
+    fd_ = -1;
+}
+
+void
+DaemonClient::mark_unreachable_locked() {
+    // Probing the socket on every call would defeat the purpose, a daemon started later is still found
+    retry_delay_ = std::clamp(retry_delay_ * 2, std::chrono::seconds(1), std::chrono::seconds(60));
+    retry_at_    = std::chrono::steady_clock::now() + retry_delay_;
+}
+
+bool
+DaemonClient::connect_locked() {
+    if (fd_ >= 0) { return true; }
+    if (! options_.enabled || std::chrono::steady_clock::now() < retry_at_) { return false; }
+
+    sockaddr_un address{};
+    if (! fill_address(options_.socket_path.empty() ? default_socket_path() : options_.socket_path, address)) {
+        mark_unreachable_locked();
+        return false;
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        mark_unreachable_locked();
+        return false;
+    }
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 || ! peer_is_same_user(fd)) {
+        ::close(fd);
+        mark_unreachable_locked();
+        return false;
+    }
+    fd_          = fd;
+    retry_delay_ = std::chrono::seconds(0);
+    return true;
+}
+
+std::optional<std::expected<DaemonClient::Response, Error>>
+DaemonClient::call(protocol::Op op, const std::string &payload, Deadline deadline) {
+    // Another call holding the connection counts against this one's deadline
+    std::unique_lock lock(mutex_, std::defer_lock);
+    if (! bounded(deadline)) { lock.lock(); }
+    else if (! lock.try_lock_until(deadline)) { return std::unexpected(timeout_error("Daemon request")); }
+    if (! connect_locked()) { return std::nullopt; }
+
+    Response response{};
+    if (! send_frame(fd_, op, 0, payload, -1, deadline) ||
+        ! recv_frame(fd_, response.header, response.payload, &response.fd, deadline) ||
+        response.header.op != static_cast<std::uint8_t>(op)) {
+        if (response.fd >= 0) { ::close(response.fd); }
+        // The answer may still arrive, the connection cannot be reused either way
+        disconnect_locked();
+        if (expired(deadline)) { return std::unexpected(timeout_error("Daemon request")); }
+        mark_unreachable_locked();
+        return std::nullopt;
+    }
+    return response;
+}
+
+std::optional<std::expected<std::vector<FontDescriptor>, Error>>
+DaemonClient::list_fonts() {
+    auto response = call(Op::List, {}, Deadline::max());
+    if (! response) { return std::nullopt; }
+    if (! *response) { return std::unexpected(response->error()); }
+    const auto &reply = **response;
+    if (reply.header.status != 0) {
+        return std::unexpected(error_from_response(reply.payload, reply.header.status));
+    }
+
+    protocol::Reader            reader(reply.payload);
+    const auto                  count = reader.u64();
+    std::vector<FontDescriptor> fonts;
+    fonts.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(count, reply.payload.size())));
+    for (std::uint64_t i = 0; i < count && reader.ok(); ++i) { fonts.push_back(reader.descriptor()); }
+    if (! reader.at_end()) { return std::unexpected(Error{ErrorCode::SystemError, "Malformed daemon response"}); }
+    return fonts;
+}
+
+std::optional<std::expected<void, Error>>
+DaemonClient::refresh_fonts(Deadline deadline) {
+    auto response = call(Op::Refresh, {}, deadline);
+    if (! response) { return std::nullopt; }
+    if (! *response) { return std::unexpected(response->error()); }
+    const auto &reply = **response;
+    if (reply.header.status != 0) {
+        return std::unexpected(error_from_response(reply.payload, reply.header.status));
+    }
+    return std::expected<void, Error>{};
+}
+
+std::optional<std::expected<FontMatch, Error>>
+DaemonClient::match_fonts(const FontQuery &query, Deadline deadline) {
+    protocol::Writer writer;
+    writer.query(query);
+    auto response = call(Op::Match, writer.data(), deadline);
+    if (! response) { return std::nullopt; }
+    if (! *response) { return std::unexpected(response->error()); }
+    const auto &reply = **response;
+    if (reply.header.status != 0) {
+        return std::unexpected(error_from_response(reply.payload, reply.header.status));
+    }
+
+    protocol::Reader reader(reply.payload);
+    FontMatch        match{};
+    match.font         = reader.descriptor();
+    match.family_score = reader.f32();
+    match.face_score   = reader.f32();
+    if (! reader.at_end()) { return std::unexpected(Error{ErrorCode::SystemError, "Malformed daemon response"}); }
+    return match;
+}
+
+std::optional<std::expected<FontDescriptor, Error>>
+DaemonClient::describe_font(const FontId &id) {
+    protocol::Writer writer;
+    writer.str(id.value);
+    auto response = call(Op::Describe, writer.data(), Deadline::max());
+    if (! response) { return std::nullopt; }
+    if (! *response) { return std::unexpected(response->error()); }
+    const auto &reply = **response;
+    if (reply.header.status != 0) {
+        return std::unexpected(error_from_response(reply.payload, reply.header.status));
+    }
+
+    protocol::Reader reader(reply.payload);
+    auto             font = reader.descriptor();
+    if (! reader.at_end()) { return std::unexpected(Error{ErrorCode::SystemError, "Malformed daemon response"}); }
+    return font;
+}
+
+std::optional<std::expected<int, Error>>
+DaemonClient::open_font_file(const FontId &id, Deadline deadline) {
+    protocol::Writer writer;
+    writer.str(id.value);
+    auto response = call(Op::Load, writer.data(), deadline);
+    if (! response) { return std::nullopt; }
+    if (! *response) { return std::unexpected(response->error()); }
+    const auto &reply = **response;
+    if (reply.header.status != 0) {
+        if (reply.fd >= 0) { ::close(reply.fd); }
+        return std::unexpected(error_from_response(reply.payload, reply.header.status));
+    }
+    if (reply.fd < 0) {
+        return std::unexpected(Error{ErrorCode::SystemError, "Daemon did not pass a font file descriptor"});
+    }
+    return reply.fd;
+}
+
+std::optional<std::expected<ByteBuffer, Error>>
+DaemonClient::load_font_data(const FontId &id, Deadline deadline) {
+    auto file = open_font_file(id, deadline);
+    if (! file) { return std::nullopt; }
+    if (! *file) { return std::unexpected(file->error()); }
+    auto data = read_passed_file(**file);
+    ::close(**file);
+    return data;
+}
+
+std::optional<std::expected<std::shared_ptr<const MappedFile>, Error>>
+DaemonClient::map_font_data(const FontId &id, Deadline deadline) {
+    auto file = open_font_file(id, deadline);
+    if (! file) { return std::nullopt; }
+    if (! *file) { return std::unexpected(file->error()); }
+    auto mapped = MappedFile::map(**file);
+    ::close(**file);
+    if (! mapped) { return std::unexpected(mapped.error()); }
+    return std::shared_ptr<const MappedFile>(std::move(*mapped));
+}
+
+std::expected<void, Error>
+serve_daemon(const DaemonOptions &options) {
+    // The daemon answers from its own catalog, it must never forward to itself
+    daemon_client().configure(DaemonClientOptions{.enabled = false});
+
+    auto warm = catalog_store().snapshot();
+    if (! warm) { return std::unexpected(warm.error()); }
+
+    const auto  path = options.socket_path.empty() ? default_socket_path() : options.socket_path;
+    sockaddr_un address{};
+    if (! fill_address(path, address)) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument,
+                                     "Daemon socket path is empty or too long, set $XDG_RUNTIME_DIR or pass a path"});
+    }
+
+    const int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to create daemon socket"}); }
+
+    // A socket file nobody listens on is a leftover of a crashed daemon, a live one is left alone
+    if (::connect(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0) {
+        ::close(listener);
+        return std::unexpected(Error{ErrorCode::SystemError, "Another daemon is already listening on " + path});
+    }
+    ::close(listener);
+    ::unlink(path.c_str());
+
+    const int server = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server < 0) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to create daemon socket"}); }
+    // The socket is created owner-only, there is no window in which another user could connect
+    const mode_t previous_mask = ::umask(S_IRWXG | S_IRWXO | S_IXUSR);
+    const bool   bound = ::bind(server, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+    ::umask(previous_mask);
+    if (! bound || ::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(server, 64) != 0) {
+        ::close(server);
+        return std::unexpected(Error{ErrorCode::SystemError, "Failed to bind daemon socket " + path});
+    }
+
+    // Requests run on the executor. A connection leaves the poll set while one of its requests is served and comes
+    // back through 'returned', the wake pipe interrupts the poll for it.
+    int wake[2] = {-1, -1};
+    if (::pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+        ::close(server);
+        return std::unexpected(Error{ErrorCode::SystemError, "Failed to create daemon wake pipe"});
+    }
+    struct Shared {
+        std::mutex              mutex{};
+        std::condition_variable drained{};
+        std::vector<Connection> returned{};
+        std::size_t             serving = 0;
+    };
+    auto shared = std::make_shared<Shared>();
+
+    std::vector<Connection> clients;
+    auto                    advance = [&](Connection connection) {
+        FrameHeader header{};
+        std::string payload;
+        switch (take_frame(connection, header, payload)) {
+            case FrameState::Invalid:
+                ::close(connection.fd);
+                return;
+            case FrameState::Partial:
+                // A frame has to arrive within the request timeout, a stalled client cannot hold its slot forever
+                if (connection.inbox.empty()) { connection.deadline = Deadline::max(); }
+                else if (! bounded(connection.deadline)) {
+                    connection.deadline = Deadline::clock::now() + request_timeout;
+                }
+                else if (expired(connection.deadline)) {
+                    ::close(connection.fd);
+                    return;
+                }
+                clients.push_back(std::move(connection));
+                return;
+            case FrameState::Complete:
+                break;
+        }
+        connection.deadline = Deadline::max();
+        {
+            std::lock_guard lock(shared->mutex);
+            ++shared->serving;
+        }
+        executor_instance().submit([shared, connection = std::move(connection), header = header,
+                                    payload = std::move(payload), wake_fd = wake[1], stop = options.stop_token] {
+            const bool      keep = serve_request(connection.fd, header, payload, stop);
+            std::lock_guard lock(shared->mutex);
+            if (keep) { shared->returned.push_back(connection); }
+            else { ::close(connection.fd); }
+            const char            byte    = 0;
+            [[maybe_unused]] auto written = ::write(wake_fd, &byte, 1);
+            if (--shared->serving == 0) { shared->drained.notify_all(); }
+        });
+    };
+
+    std::vector<pollfd> polled;
+    while (! options.stop_token.stop_requested()) {
+        polled.assign({{server, POLLIN, 0}, {wake[0], POLLIN, 0}});
+        for (const auto &client : clients) { polled.push_back(pollfd{client.fd, POLLIN, 0}); }
+
+        const int ready = ::poll(polled.data(), polled.size(), 250);
+        if (ready < 0 && errno != EINTR) { break; }
+
+        // Every waiting client passes through 'advance' so partial frames past their deadline are dropped
+        auto waiting = std::exchange(clients, {});
+        for (size_t i = 0; i < waiting.size(); ++i) {
+            const short revents = ready > 0 ? polled[i + 2].revents : 0;
+            if (revents != 0 && ! receive_available(waiting[i])) {
+                ::close(waiting[i].fd);
+                continue;
+            }
+            advance(std::move(waiting[i]));
+        }
+        if (ready <= 0) { continue; }
+
+        if (polled[1].revents & POLLIN) {
+            char drain[64];
+            while (::read(wake[0], drain, sizeof(drain)) > 0) {}
+            std::vector<Connection> returned;
+            {
+                std::lock_guard lock(shared->mutex);
+                returned.swap(shared->returned);
+            }
+            for (auto &connection : returned) { advance(std::move(connection)); }
+        }
+        if (polled[0].revents & POLLIN) {
+            const int client = ::accept4(server, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client >= 0 && ! peer_is_same_user(client)) { ::close(client); }
+            else if (client >= 0) { clients.push_back(Connection{.fd = client}); }
+        }
+    }
+
+    // Requests in flight see the stop token (a refresh is abandoned) or their I/O deadline
+    {
+        std::unique_lock lock(shared->mutex);
+        shared->drained.wait(lock, [&] { return shared->serving == 0; });
+        for (const auto &connection : shared->returned) { ::close(connection.fd); }
+    }
+    for (const auto &connection : clients) { ::close(connection.fd); }
+    ::close(server);
+    ::close(wake[0]);
+    ::close(wake[1]);
+    ::unlink(path.c_str());
+    return {};
+}
+
+#else
+
+std::string
+default_socket_path() {
+    return {};
+}
+
+void
+DaemonClient::configure(DaemonClientOptions options) {
+    std::lock_guard lock(mutex_);
+    options_ = std::move(options);
+}
+
+std::optional<std::expected<std::vector<FontDescriptor>, Error>>
+DaemonClient::list_fonts() {
+    return std::nullopt;
+}
+
+std::optional<std::expected<void, Error>>
+DaemonClient::refresh_fonts(Deadline) {
+    return std::nullopt;
+}
+
+std::optional<std::expected<FontMatch, Error>>
+DaemonClient::match_fonts(const FontQuery &, Deadline) {
+    return std::nullopt;
+}
+
+std::optional<std::expected<FontDescriptor, Error>>
+DaemonClient::describe_font(const FontId &) {
+    return std::nullopt;
+}
+
+std::optional<std::expected<ByteBuffer, Error>>
+DaemonClient::load_font_data(const FontId &, Deadline) {
+    return std::nullopt;
+}
+
+std::optional<std::expected<std::shared_ptr<const MappedFile>, Error>>
+DaemonClient::map_font_data(const FontId &, Deadline) {
+    return std::nullopt;
+}
+
+std::expected<void, Error>
+serve_daemon(const DaemonOptions &) {
+    return std::unexpected(Error{ErrorCode::NotImplemented, "The font daemon requires Unix domain sockets"});
+}
+
+#endif
+
+DaemonClient &
+daemon_client() {
+    static DaemonClient client{};
+    return client;
+}
+
+} // namespace incfontdisc::detail
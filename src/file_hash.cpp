@@ -0,0 +1,76 @@
+#include <incfontdisc_private/file_hash.hpp>
+#include <incfontdisc_private/hash.hpp>
+
+#include <cstdlib>
+#include <filesystem>
+
+namespace incfontdisc::detail {
+
+std::optional<FileFingerprint>
+file_fingerprint(const std::string &path) {
+    std::error_code ec;
+    const auto      fs_path = std::filesystem::path(std::u8string(
+        reinterpret_cast<const char8_t *>(path.data()), reinterpret_cast<const char8_t *>(path.data() + path.size())));
+    const auto      size    = std::filesystem::file_size(fs_path, ec);
+    if (ec) { return std::nullopt; }
+    const auto mtime = std::filesystem::last_write_time(fs_path, ec);
+    if (ec) { return std::nullopt; }
+    return FileFingerprint{size, static_cast<std::int64_t>(mtime.time_since_epoch().count())};
+}
+
+std::optional<std::filesystem::path>
+cache_directory(std::string_view name) {
+    std::filesystem::path directory;
+    if (const char *explicit_dir = std::getenv("INCFONTDISC_CACHE_DIR"); explicit_dir && *explicit_dir) {
+        directory = explicit_dir;
+    }
+#if defined(_WIN32)
+    else if (const char *local = std::getenv("LOCALAPPDATA"); local && *local) {
+        directory = std::filesystem::path(local) / "incfontdisc";
+    }
+#else
+    else if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        directory = std::filesystem::path(xdg) / "incfontdisc";
+    }
+    else if (const char *home = std::getenv("HOME"); home && *home) {
+        directory = std::filesystem::path(home) / ".cache" / "incfontdisc";
+    }
+#endif
+    else { return std::nullopt; }
+    directory /= name;
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) { return std::nullopt; }
+    return directory;
+}
+
+std::optional<std::uint64_t>
+FileHashes::find(const std::string &path) {
+    const auto fingerprint = file_fingerprint(path);
+    if (! fingerprint) { return std::nullopt; }
+
+    std::lock_guard lock(mutex_);
+    auto            it = entries_.find(path);
+    if (it == entries_.end() || it->second.fingerprint != *fingerprint) { return std::nullopt; }
+    return it->second.hash;
+}
+
+std::uint64_t
+FileHashes::remember(const std::string &path, std::span<const std::byte> data) {
+    const auto hash = hash_bytes(data);
+    // Taken after the read, a file replaced in between only costs one more read on the next call
+    if (const auto fingerprint = file_fingerprint(path); fingerprint && fingerprint->size == data.size()) {
+        std::lock_guard lock(mutex_);
+        entries_[path] = Entry{*fingerprint, hash};
+    }
+    return hash;
+}
+
+FileHashes &
+file_hashes() {
+    static FileHashes hashes{};
+    return hashes;
+}
+
+} // namespace incfontdisc::detail
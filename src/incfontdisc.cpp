@@ -1,26 +1,615 @@
 #include <incfontdisc/incfontdisc.hpp>
+#include <incfontdisc_private/advances.hpp>
 #include <incfontdisc_private/backend.hpp>
+#include <incfontdisc_private/catalog.hpp>
+#include <incfontdisc_private/daemon.hpp>
+#include <incfontdisc_private/deadline.hpp>
+#include <incfontdisc_private/mapped_file.hpp>
+#include <incfontdisc_private/match_cache.hpp>
+#include <incfontdisc_private/memory.hpp>
+#include <incfontdisc_private/pinned_fonts.hpp>
+#include <incfontdisc_private/probes.hpp>
+#include <incfontdisc_private/sfnt.hpp>
+#include <incfontdisc_private/slow_log.hpp>
+#include <incfontdisc_private/subset.hpp>
+#include <incfontdisc_private/thread_pool.hpp>
+#include <incfontdisc_private/trace.hpp>
+#include <incfontdisc_private/validate.hpp>
+#include <incfontdisc_private/woff2.hpp>
 
 namespace incfontdisc {
 
+namespace {
+
+std::expected<std::vector<FontDescriptor>, Error>
+list_fonts_impl() {
+    if (auto remote = detail::daemon_client().list_fonts()) { return std::move(*remote); }
+
+    auto catalog = detail::catalog_store().snapshot();
+    if (! catalog) { return std::unexpected(catalog.error()); }
+
+    std::vector<FontDescriptor> fonts;
+    fonts.reserve((*catalog)->faces.size());
+    for (const auto &face : (*catalog)->faces) { fonts.push_back(face.descriptor); }
+    return fonts;
+}
+
+std::expected<void, Error>
+refresh_fonts_impl(detail::RefreshStats *stats, detail::BuildControl &control, Deadline deadline) {
+    if (control.stopped()) { return std::unexpected(detail::cancelled_error("Font refresh")); }
+    if (auto remote = detail::daemon_client().refresh_fonts(deadline)) { return std::move(*remote); }
+    return detail::catalog_store().refresh(stats, &control);
+}
+
+std::expected<FontMatch, Error>
+match_fonts_impl(const FontQuery &query, detail::MatchStats *stats, Deadline deadline) {
+    if (auto remote = detail::daemon_client().match_fonts(query, deadline)) { return std::move(*remote); }
+
+    // Only the first call builds the catalog, that build is the part of a match that does I/O
+    const bool layout  = detail::needs_layout_index(query);
+    auto       catalog = detail::catalog_store().current();
+    if (! catalog || (layout && ! catalog->layout_indexed)) {
+        auto built = detail::run_until(deadline, "Catalog build",
+                                       [layout](Deadline) { return detail::catalog_store().indexed_snapshot(layout, false); });
+        if (! built) { return std::unexpected(built.error()); }
+        catalog = std::move(*built);
+    }
+    auto matched = detail::cached_match(*catalog, query, stats, deadline);
+    if (! matched) { return std::unexpected(matched.error()); }
+    return FontMatch{.font         = catalog->faces[matched->face].descriptor,
+                     .family_score = matched->family_score,
+                     .face_score   = matched->face_score};
+}
+
+std::expected<ByteBuffer, Error>
+load_font_data_impl(const FontId &id, Deadline deadline = Deadline::max()) {
+    auto data = [&]() -> std::expected<ByteBuffer, Error> {
+        if (auto remote = detail::daemon_client().load_font_data(id, deadline)) { return std::move(*remote); }
+        return detail::backend_instance().load_font_data(id, deadline);
+    }();
+    if (data) {
+        if (auto valid = detail::validation_cache().check(id, *data); ! valid) { return std::unexpected(valid.error()); }
+    }
+    return data;
+}
+
+using MappedData = std::expected<std::shared_ptr<const detail::MappedFile>, Error>;
+
+// The file of 'id' mapped, pages are read in on first touch. 'resident' tells whether it came already read in.
+MappedData
+open_mapped(const FontId &id, Deadline deadline, bool &resident) {
+    const auto path = detail::split_font_id(id).first;
+    if (path.empty()) { return std::unexpected(Error{ErrorCode::InvalidArgument, "FontId is empty"}); }
+    // A pinned file is already mapped and resident, otherwise the daemon's descriptor or the path is mapped
+    resident = false;
+    if (auto pinned = detail::pinned_fonts().find(path)) {
+        resident = true;
+        return pinned;
+    }
+    if (auto remote = detail::daemon_client().map_font_data(id, deadline)) { return std::move(*remote); }
+    return detail::MappedFile::open(path);
+}
+
+// The mapping counterpart of load_font_data_impl, with every page read in before it returns
+MappedData
+map_font_data(const FontId &id, const std::atomic<bool> *cancelled = nullptr, Deadline deadline = Deadline::max()) {
+    auto abandoned = [cancelled] { return cancelled && cancelled->load(std::memory_order_relaxed); };
+    bool resident  = false;
+    auto file      = open_mapped(id, deadline, resident);
+    if (! file) { return file; }
+    if (! resident) {
+        // A prefetch whose candidate lost the scoring stops before reading the file in or validating it
+        if (abandoned()) { return std::unexpected(detail::cancelled_error("Font prefetch")); }
+        if (detail::expired(deadline)) { return std::unexpected(detail::timeout_error("Font load")); }
+        (*file)->prefetch();
+    }
+    if (abandoned()) { return std::unexpected(detail::cancelled_error("Font prefetch")); }
+    if (auto valid = detail::validation_cache().check(id, (*file)->bytes()); ! valid) {
+        return std::unexpected(valid.error());
+    }
+    return file;
+}
+
+// A map_font_data handed to the executor. Whichever of the worker and the waiter claims it first runs it, so a busy
+// or serial executor costs the overlap but never blocks the waiter.
+class PendingMap final {
+public:
+    PendingMap(FontId id, Deadline deadline)
+        : id_(std::move(id))
+        , deadline_(deadline) {}
+
+    void
+    run() {
+        if (claimed_.exchange(true)) { return; }
+        auto            mapped = map_font_data(id_, &cancelled_, deadline_);
+        std::lock_guard lock(mutex_);
+        result_ = std::move(mapped);
+        done_.notify_all();
+    }
+    // A worker still reading the file in when the deadline passes is cancelled and the wait reports Timeout
+    MappedData
+    wait() {
+        run();
+        std::unique_lock lock(mutex_);
+        if (! detail::bounded(deadline_)) { done_.wait(lock, [&] { return result_.has_value(); }); }
+        else if (! done_.wait_until(lock, deadline_, [&] { return result_.has_value(); })) {
+            cancelled_.store(true, std::memory_order_relaxed);
+            return std::unexpected(detail::timeout_error("Font load"));
+        }
+        return *result_;
+    }
+    // Nobody will wait, work not started yet is skipped and work in progress stops early
+    void
+    cancel() {
+        cancelled_.store(true, std::memory_order_relaxed);
+        claimed_.store(true);
+    }
+
+private:
+    FontId                    id_{};
+    Deadline                  deadline_{};
+    std::atomic<bool>         claimed_{false};
+    std::atomic<bool>         cancelled_{false};
+    std::mutex                mutex_{};
+    std::condition_variable   done_{};
+    std::optional<MappedData> result_{};
+};
+
+// The face an exactly named family offers under the requested style name, where exact face matches usually land
+std::optional<std::uint32_t>
+leading_candidate(const detail::Catalog &catalog, const FontQuery &query) {
+    const auto family = catalog.find_family(*query.family);
+    if (! family) { return std::nullopt; }
+    const auto style = catalog.style_ids.find(detail::to_lower(query.style.value_or("Regular")));
+    if (style == catalog.style_ids.end()) { return std::nullopt; }
+
+    const auto &entry = catalog.families[*family];
+    for (std::size_t k = 0; k < entry.faces.size(); ++k) {
+        if (catalog.attributes.style[entry.attributes + k] == style->second) { return entry.faces[k]; }
+    }
+    return std::nullopt;
+}
+
+// Cancels a prefetch the match did not consume, on every way out of match_and_load_impl
+struct PrefetchGuard final {
+    std::shared_ptr<PendingMap> pending{};
+
+    PrefetchGuard() = default;
+    PrefetchGuard(const PrefetchGuard &) = delete;
+    PrefetchGuard &
+    operator=(const PrefetchGuard &) = delete;
+    ~PrefetchGuard() {
+        if (pending) { pending->cancel(); }
+    }
+};
+
+std::expected<LoadedMatch, Error>
+match_and_load_impl(const FontQuery &query, detail::MatchStats *stats, Deadline deadline) {
+    // The daemon answers both halves, there is nothing to overlap on this side. The file it passes is mapped.
+    if (auto remote = detail::daemon_client().match_fonts(query, deadline)) {
+        if (! *remote) { return std::unexpected(remote->error()); }
+        detail::trace_recorder().record_load((*remote)->font.id);
+        auto mapped = map_font_data((*remote)->font.id, nullptr, deadline);
+        if (! mapped) { return std::unexpected(mapped.error()); }
+        return LoadedMatch{.match = std::move(**remote), .data = (*mapped)->bytes(), .storage = std::move(*mapped)};
+    }
+
+    const bool layout  = detail::needs_layout_index(query);
+    auto       catalog = detail::catalog_store().current();
+    if (! catalog || (layout && ! catalog->layout_indexed)) {
+        auto built = detail::run_until(deadline, "Catalog build",
+                                       [layout](Deadline) { return detail::catalog_store().indexed_snapshot(layout, false); });
+        if (! built) { return std::unexpected(built.error()); }
+        catalog = std::move(*built);
+    }
+
+    // A cached answer needs no scoring, its file is mapped right here. Otherwise the leading candidate is mapped on
+    // the executor while the query is scored and kept when scoring agrees.
+    std::optional<detail::FaceMatch> matched = detail::match_cache().find(*catalog, query);
+    PrefetchGuard                    prefetch;
+    std::uint32_t                    leading = 0;
+    if (matched) {
+        if (stats) { stats->path = MatchPath::Cached; }
+    }
+    else {
+        if (auto candidate = leading_candidate(*catalog, query)) {
+            leading = *candidate;
+            prefetch.pending = std::make_shared<PendingMap>(catalog->faces[leading].descriptor.id, deadline);
+            detail::executor_instance().submit([pending = prefetch.pending] { pending->run(); });
+        }
+        auto scored = detail::cached_match(*catalog, query, stats, deadline);
+        if (! scored) { return std::unexpected(scored.error()); }
+        matched = *scored;
+    }
+
+    // A candidate that lost the scoring is cancelled by the guard, the winner's prefetch is taken over and awaited
+    auto pending = leading == matched->face ? std::exchange(prefetch.pending, nullptr) : nullptr;
+
+    const auto &font = catalog->faces[matched->face].descriptor;
+    detail::trace_recorder().record_load(font.id);
+    auto mapped = pending ? pending->wait() : map_font_data(font.id, nullptr, deadline);
+    if (! mapped) { return std::unexpected(mapped.error()); }
+    return LoadedMatch{
+        .match   = FontMatch{.font = font, .family_score = matched->family_score, .face_score = matched->face_score},
+        .data    = (*mapped)->bytes(),
+        .storage = std::move(*mapped)};
+}
+
+void
+describe_match(detail::SlowLogScope &slow, const FontQuery &query, const detail::MatchStats &stats) {
+    if (! slow.active()) { return; }
+    auto &operation            = slow.operation();
+    operation.query            = query;
+    operation.path             = stats.path;
+    operation.families_scanned = stats.families_scanned;
+    operation.faces_scored     = stats.faces_scored;
+    operation.phases           = {{"family", stats.family_phase}, {"face", stats.face_phase}};
+}
+
+} // namespace
+
 std::expected<std::vector<FontDescriptor>, Error>
 list_fonts() {
-    return detail::backend_instance().list_fonts();
+    detail::SlowLogScope slow(OperationKind::List);
+    auto                 fonts = list_fonts_impl();
+    slow.finish(fonts);
+    return fonts;
 }
 
 std::expected<void, Error>
 refresh_fonts() {
-    return detail::backend_instance().refresh_fonts();
+    return refresh_fonts(Deadline::max());
+}
+
+std::expected<void, Error>
+refresh_fonts(Deadline deadline) {
+    return refresh_fonts(RefreshOptions{.deadline = deadline});
+}
+
+std::expected<void, Error>
+refresh_fonts(RefreshOptions options) {
+    detail::SlowLogScope slow(OperationKind::Refresh);
+    // The stats and the control travel with the work, a refresh outliving the deadline must not touch this frame
+    auto control   = std::make_shared<detail::BuildControl>(std::move(options.stop_token), std::move(options.progress));
+    auto refreshed = detail::run_until(
+        options.deadline, "Font refresh",
+        [timed = slow.active(), control](Deadline deadline) -> std::expected<detail::RefreshStats, Error> {
+            detail::RefreshStats stats{};
+            auto                 refreshed = refresh_fonts_impl(timed ? &stats : nullptr, *control, deadline);
+            if (! refreshed) { return std::unexpected(refreshed.error()); }
+            return stats;
+        },
+        detail::LateWork::Complete);
+    if (slow.active() && refreshed) {
+        slow.operation().faces_scored = refreshed->faces;
+        slow.operation().phases       = {{"enumerate", refreshed->enumerate_phase}, {"index", refreshed->index_phase}};
+    }
+    slow.finish(refreshed);
+    if (! refreshed) { return std::unexpected(refreshed.error()); }
+    return {};
 }
 
 std::expected<FontMatch, Error>
 match_fonts(const FontQuery &query) {
-    return detail::backend_instance().match_fonts(query);
+    return match_fonts(query, Deadline::max());
+}
+
+std::expected<FontMatch, Error>
+match_fonts(const FontQuery &query, Deadline deadline) {
+    detail::trace_recorder().record_match(query);
+    if (! query.family) { return std::unexpected(Error{ErrorCode::InvalidArgument, "FontQuery.family must be set"}); }
+
+    detail::SlowLogScope slow(OperationKind::Match);
+    detail::MatchStats   stats{};
+    INCFONTDISC_PROBE1(match__start, query.family->c_str());
+    auto matched = match_fonts_impl(query, slow.active() ? &stats : nullptr, deadline);
+    INCFONTDISC_PROBE4(match__end, query.family->c_str(), matched ? matched->font.family.c_str() : "",
+                       INCFONTDISC_PROBE_SCORE(matched ? matched->family_score : 0.0f),
+                       INCFONTDISC_PROBE_SCORE(matched ? matched->face_score : 0.0f));
+    describe_match(slow, query, stats);
+    slow.finish(matched);
+    return matched;
+}
+
+std::expected<LoadedMatch, Error>
+match_and_load(const FontQuery &query) {
+    return match_and_load(query, Deadline::max());
+}
+
+std::expected<LoadedMatch, Error>
+match_and_load(const FontQuery &query, Deadline deadline) {
+    detail::trace_recorder().record_match(query);
+    if (! query.family) { return std::unexpected(Error{ErrorCode::InvalidArgument, "FontQuery.family must be set"}); }
+
+    detail::SlowLogScope slow(OperationKind::Match);
+    detail::MatchStats   stats{};
+    auto                 loaded = match_and_load_impl(query, slow.active() ? &stats : nullptr, deadline);
+    describe_match(slow, query, stats);
+    slow.finish(loaded);
+    return loaded;
+}
+
+std::expected<FontDescriptor, Error>
+describe_font(const FontId &id) {
+    if (id.value.empty()) { return std::unexpected(Error{ErrorCode::InvalidArgument, "FontId is empty"}); }
+    if (auto remote = detail::daemon_client().describe_font(id)) { return std::move(*remote); }
+
+    auto catalog = detail::catalog_store().snapshot();
+    if (! catalog) { return std::unexpected(catalog.error()); }
+    auto index = (*catalog)->find_face(id);
+    if (! index) { return std::unexpected(Error{ErrorCode::InvalidArgument, "FontId is not part of the catalog"}); }
+    return (*catalog)->faces[*index].descriptor;
 }
 
 std::expected<ByteBuffer, Error>
 load_font_data(const FontId &id) {
-    return detail::backend_instance().load_font_data(id);
+    return load_font_data(id, Deadline::max());
+}
+
+std::expected<ByteBuffer, Error>
+load_font_data(const FontId &id, Deadline deadline) {
+    detail::trace_recorder().record_load(id);
+
+    detail::SlowLogScope slow(OperationKind::Load);
+    INCFONTDISC_PROBE1(load__start, id.value.c_str());
+    auto data =
+        detail::run_until(deadline, "Font load", [id](Deadline bound) { return load_font_data_impl(id, bound); });
+    INCFONTDISC_PROBE2(load__end, id.value.c_str(), data ? data->size() : std::size_t{0});
+    if (slow.active()) { slow.operation().id = id; }
+    slow.finish(data);
+    return data;
+}
+
+std::expected<ByteBuffer, Error>
+load_font_data(const FontId &id, FontFormat format) {
+    if (format == FontFormat::Sfnt) { return load_font_data(id); }
+    if (! detail::woff2_available()) {
+        return std::unexpected(Error{ErrorCode::NotImplemented, "incfontdisc was built without WOFF2 support"});
+    }
+
+    auto &cache = detail::encoded_cache();
+    if (auto cached = cache.find(id)) { return std::move(*cached); }
+    auto data = load_font_data(id);
+    if (! data) { return std::unexpected(data.error()); }
+    return cache.encode(id, *data);
+}
+
+std::expected<CoverageReport, Error>
+check_coverage(const FontId &id, std::u32string_view codepoints) {
+    // Only the directory and the cmap are looked at, the mapping reads in just their pages
+    bool resident = false;
+    auto file     = open_mapped(id, Deadline::max(), resident);
+    if (! file) { return std::unexpected(file.error()); }
+    if (auto valid = detail::validation_cache().check(id, (*file)->bytes()); ! valid) {
+        return std::unexpected(valid.error());
+    }
+
+    auto font = detail::sfnt::open_font((*file)->bytes(), detail::face_in_file(detail::split_font_id(id).second));
+    if (! font) { return std::unexpected(font.error()); }
+    auto cmap = detail::sfnt::CharMap::from_font(*font);
+    if (! cmap) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Font has no usable Unicode cmap"}); }
+
+    CoverageReport report{};
+    for (char32_t codepoint : codepoints) {
+        if (cmap->glyph_for(codepoint) != 0) { ++report.covered; }
+        else { report.missing.push_back(codepoint); }
+    }
+    return report;
+}
+
+std::expected<GlyphAdvances, Error>
+glyph_advances(FontHandle face, std::u32string_view text) {
+    auto catalog = detail::catalog_store().snapshot();
+    if (! catalog) { return std::unexpected(catalog.error()); }
+    auto index = (*catalog)->find_face(face);
+    if (! index) { return std::unexpected(Error{ErrorCode::InvalidArgument, "FontHandle is not part of the catalog"}); }
+    const auto &entry = (*catalog)->faces[*index];
+
+    auto &cache = detail::advance_cache();
+    auto  table = cache.find(face, entry.fingerprint);
+    if (! table) {
+        auto data = load_font_data(entry.descriptor.id);
+        if (! data) { return std::unexpected(data.error()); }
+        auto font = detail::sfnt::open_font(*data, detail::face_in_file(detail::split_font_id(entry.descriptor.id).second));
+        if (! font) { return std::unexpected(font.error()); }
+        auto built = detail::AdvanceTable::from_font(*font);
+        if (! built) { return std::unexpected(built.error()); }
+        table = std::make_shared<const detail::AdvanceTable>(std::move(*built));
+        cache.insert(face, entry.fingerprint, table);
+    }
+
+    GlyphAdvances result{.units_per_em = table->units_per_em()};
+    result.advances.reserve(text.size());
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (auto advance = table->advance(text[i])) { result.advances.push_back(*advance); }
+        else {
+            result.advances.push_back(table->notdef_advance());
+            result.missing.push_back(i);
+        }
+    }
+    return result;
+}
+
+std::expected<std::vector<FontDescriptor>, Error>
+fallback_fonts(char32_t codepoint, FallbackStyle style) {
+    const auto script = detail::script_of(codepoint);
+    if (! script) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Codepoint does not belong to an indexed script"});
+    }
+    auto catalog = detail::catalog_store().indexed_snapshot(false, true);
+    if (! catalog) { return std::unexpected(catalog.error()); }
+
+    const auto &cell =
+        (*catalog)->fallbacks[static_cast<std::size_t>(*script) * detail::fallback_classes + detail::fallback_class(style)];
+    if (cell.empty()) { return std::unexpected(Error{ErrorCode::NoFontsFound, "No installed face covers the script"}); }
+    std::vector<FontDescriptor> fonts;
+    fonts.reserve(cell.size());
+    for (const auto index : cell) { fonts.push_back((*catalog)->faces[index].descriptor); }
+    return fonts;
+}
+
+FontHandle
+font_handle(const FontId &id) {
+    return detail::handle_of(id);
+}
+
+std::expected<std::uint64_t, Error>
+catalog_generation() {
+    auto catalog = detail::catalog_store().snapshot();
+    if (! catalog) { return std::unexpected(catalog.error()); }
+    return (*catalog)->generation;
+}
+
+std::expected<CatalogDiff, Error>
+diff_generations(std::uint64_t old_generation, std::uint64_t new_generation) {
+    return detail::catalog_store().diff(old_generation, new_generation);
+}
+
+std::expected<ByteBuffer, Error>
+subset_font(const FontId &id, std::u32string_view codepoints) {
+    auto &cache = detail::subset_cache();
+    if (auto cached = cache.find(id, codepoints)) { return std::move(*cached); }
+
+    auto data = load_font_data(id);
+    if (! data) { return std::unexpected(data.error()); }
+    return cache.build(id, *data, codepoints);
+}
+
+std::expected<void, Error>
+configure_catalog(CatalogOptions options) {
+    return detail::catalog_store().configure(options);
+}
+
+std::expected<void, Error>
+register_fonts(std::vector<FontDescriptor> fonts) {
+    std::vector<detail::FaceRecord> faces;
+    faces.reserve(fonts.size());
+    for (auto &font : fonts) {
+        if (font.id.value.empty()) {
+            return std::unexpected(Error{ErrorCode::InvalidArgument, "Registered font without a FontId"});
+        }
+        faces.push_back(detail::FaceRecord{.descriptor = std::move(font)});
+    }
+    return detail::catalog_store().register_faces(std::move(faces));
+}
+
+std::expected<void, Error>
+configure_executor(ExecutorOptions options) {
+    if (options.executor && ! options.cpu_affinity.empty()) {
+        return std::unexpected(
+            Error{ErrorCode::InvalidArgument, "CPU affinity cannot be applied to a user supplied executor"});
+    }
+    detail::executor_instance().configure(std::move(options));
+    return {};
+}
+
+std::expected<void, Error>
+configure_validation(ValidationLevel level) {
+    detail::validation_cache().configure(level);
+    return {};
+}
+
+std::expected<void, Error>
+configure_match_cache(MatchCacheOptions options) {
+    if (options.slots == 0 || options.slots > (std::size_t{1} << 24)) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "MatchCacheOptions.slots must be in [1, 2^24]"});
+    }
+    detail::match_cache().configure(options);
+    return {};
+}
+
+std::expected<void, Error>
+configure_daemon_client(DaemonClientOptions options) {
+    detail::daemon_client().configure(std::move(options));
+    return {};
+}
+
+std::expected<void, Error>
+start_trace_recording(const std::string &path) {
+    if (path.empty()) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Trace path is empty"}); }
+    return detail::trace_recorder().start(path);
+}
+
+std::expected<void, Error>
+stop_trace_recording() {
+    return detail::trace_recorder().stop();
+}
+
+std::expected<std::vector<TraceEvent>, Error>
+read_trace(const std::string &path) {
+    return detail::read_trace_file(path);
+}
+
+std::expected<void, Error>
+configure_slow_log(SlowLogOptions options) {
+    if (options.threshold.count() < 0) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Slow log threshold must not be negative"});
+    }
+    detail::slow_log().configure(std::move(options));
+    return {};
+}
+
+std::vector<SlowOperation>
+drain_slow_log() {
+    return detail::slow_log().drain();
+}
+
+MemoryUsage
+memory_usage() {
+    MemoryUsage usage{};
+    if (auto catalog = detail::catalog_store().current()) {
+        usage.descriptors    = catalog->memory.descriptors;
+        usage.strings        = catalog->memory.strings;
+        usage.family_index   = catalog->memory.family_index;
+        usage.fuzzy_index    = catalog->memory.fuzzy_index;
+        usage.id_index       = catalog->memory.id_index;
+        usage.coverage_index = catalog->memory.coverage_index;
+    }
+    const auto &counters  = detail::memory_counters();
+    usage.advance_tables  = counters.value(detail::MemoryCategory::AdvanceTables);
+    usage.byte_caches     = counters.value(detail::MemoryCategory::ByteCaches);
+    usage.mapped_resident = counters.value(detail::MemoryCategory::MappedResident);
+    return usage;
+}
+
+std::expected<void, Error>
+configure_memory(MemoryOptions options) {
+    return detail::memory_budget().configure(std::move(options));
+}
+
+std::size_t
+trim(TrimLevel level) {
+    return detail::memory_budget().trim(level);
+}
+
+std::expected<void, Error>
+configure_pinning(PinOptions options) {
+    detail::pinned_fonts().configure(options);
+    return {};
+}
+
+std::expected<void, Error>
+pin_font(FontHandle face) {
+    auto catalog = detail::catalog_store().snapshot();
+    if (! catalog) { return std::unexpected(catalog.error()); }
+    auto index = (*catalog)->find_face(face);
+    if (! index) { return std::unexpected(Error{ErrorCode::InvalidArgument, "FontHandle is not part of the catalog"}); }
+    return detail::pinned_fonts().pin(face, detail::split_font_id((*catalog)->faces[*index].descriptor.id).first);
+}
+
+std::expected<void, Error>
+unpin_font(FontHandle face) {
+    return detail::pinned_fonts().unpin(face);
+}
+
+PinStats
+pin_stats() {
+    return detail::pinned_fonts().stats();
+}
+
+std::expected<void, Error>
+run_daemon(const DaemonOptions &options) {
+    return detail::serve_daemon(options);
 }
 
 } // namespace incfontdisc
@@ -0,0 +1,136 @@
+#include <incfontdisc_private/mapped_file.hpp>
+#include <incfontdisc_private/memory.hpp>
+
+#include <cstdint>
+#include <string>
+
+#if defined(_WIN32)
+#include <filesystem>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace incfontdisc::detail {
+
+#if defined(_WIN32)
+
+std::expected<std::unique_ptr<MappedFile>, Error>
+MappedFile::open(const std::string &path) {
+    const std::filesystem::path native(path);
+    HANDLE file = ::CreateFileW(native.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return std::unexpected(Error{ErrorCode::SystemError, "Failed to open font file " + path});
+    }
+    LARGE_INTEGER size{};
+    if (! ::GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+        ::CloseHandle(file);
+        return std::unexpected(Error{ErrorCode::SystemError, "Font file is empty"});
+    }
+
+    // The view keeps the mapping object alive, neither handle is needed afterwards
+    HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(file);
+    if (! mapping) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to map font file " + path}); }
+    void *view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    ::CloseHandle(mapping);
+    if (! view) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to map font file " + path}); }
+
+    std::unique_ptr<MappedFile> mapped(new MappedFile());
+    mapped->data_ = static_cast<const std::byte *>(view);
+    mapped->size_ = static_cast<std::size_t>(size.QuadPart);
+    memory_counters().add(MemoryCategory::MappedResident, mapped->size_);
+    return mapped;
+}
+
+MappedFile::~MappedFile() {
+    if (! data_) { return; }
+    ::UnmapViewOfFile(data_);
+    memory_counters().release(MemoryCategory::MappedResident, size_);
+}
+
+void
+MappedFile::prefetch() const {
+    WIN32_MEMORY_RANGE_ENTRY range{const_cast<std::byte *>(data_), size_};
+    ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+    touch_pages(4096);
+}
+
+std::expected<void, Error>
+MappedFile::lock() const {
+    if (! ::VirtualLock(const_cast<std::byte *>(data_), size_)) {
+        return std::unexpected(Error{ErrorCode::SystemError, "VirtualLock failed with error " +
+                                                                 std::to_string(::GetLastError())});
+    }
+    return {};
+}
+
+#else
+
+std::expected<std::unique_ptr<MappedFile>, Error>
+MappedFile::open(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to open font file " + path}); }
+    // The mapping holds its own reference to the file
+    auto mapped = map(fd);
+    ::close(fd);
+    return mapped;
+}
+
+std::expected<std::unique_ptr<MappedFile>, Error>
+MappedFile::map(int fd) {
+    struct stat info{};
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+        return std::unexpected(Error{ErrorCode::SystemError, "Font file is empty"});
+    }
+
+    const auto size    = static_cast<std::size_t>(info.st_size);
+    void      *mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to map font file"}); }
+
+    std::unique_ptr<MappedFile> mapped(new MappedFile());
+    mapped->data_ = static_cast<const std::byte *>(mapping);
+    mapped->size_ = size;
+    memory_counters().add(MemoryCategory::MappedResident, size);
+    return mapped;
+}
+
+MappedFile::~MappedFile() {
+    if (! data_) { return; }
+    ::munmap(const_cast<std::byte *>(data_), size_);
+    memory_counters().release(MemoryCategory::MappedResident, size_);
+}
+
+void
+MappedFile::prefetch() const {
+    // Readahead of the whole range is queued at once, the loop then only waits for pages still in flight
+    ::madvise(const_cast<std::byte *>(data_), size_, MADV_WILLNEED);
+    touch_pages(static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)));
+}
+
+std::expected<void, Error>
+MappedFile::lock() const {
+    if (::mlock(data_, size_) != 0) {
+        return std::unexpected(Error{ErrorCode::SystemError, std::string("mlock failed: ") + std::strerror(errno)});
+    }
+    return {};
+}
+
+#endif
+
+void
+MappedFile::touch_pages(std::size_t page_size) const {
+    std::uint8_t sum = 0;
+    for (std::size_t offset = 0; offset < size_; offset += page_size) {
+        sum += static_cast<std::uint8_t>(static_cast<const volatile std::byte *>(data_)[offset]);
+    }
+    (void)sum;
+}
+
+} // namespace incfontdisc::detail
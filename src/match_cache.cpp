@@ -0,0 +1,364 @@
+#include <incfontdisc_private/file_hash.hpp>
+#include <incfontdisc_private/hash.hpp>
+#include <incfontdisc_private/match_cache.hpp>
+#include <incfontdisc_private/memory.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace incfontdisc::detail {
+
+namespace {
+
+// Table file: a 64 byte header followed by the slots, all words in host byte order. A zeroed slot is empty.
+constexpr std::array<char, 8> table_signature = {'I', 'F', 'D', 'M', 'C', 'H', '0', '1'};
+constexpr std::size_t         header_size     = 64;
+// Slots probed per key, one bucket spans four cache lines
+constexpr std::size_t         bucket_size     = 4;
+// A slot claimed longer ago than this belongs to a writer that died, the next insert takes it over
+constexpr std::uint64_t       stale_claim_ms  = 5000;
+
+struct Slot {
+    // Odd while a writer fills the slot, the claim then holds the time it was taken in milliseconds since the epoch
+    // shifted left by one. Every claim and release is larger than the value it replaces.
+    std::uint64_t sequence = 0;
+    std::uint64_t key      = 0;
+    std::uint64_t check    = 0;
+    std::uint64_t catalog  = 0;
+    std::uint64_t handle   = 0;
+    // Family score in the high half, face score in the low half, as float bits
+    std::uint64_t scores   = 0;
+    // Index into Catalog::faces, verified against the handle on every hit
+    std::uint64_t face     = 0;
+    std::uint64_t padding  = 0;
+};
+static_assert(sizeof(Slot) == 64);
+static_assert(std::atomic_ref<std::uint64_t>::is_always_lock_free, "slots are shared between processes");
+
+std::uint64_t
+load(std::uint64_t &word, std::memory_order order = std::memory_order_relaxed) {
+    return std::atomic_ref<std::uint64_t>(word).load(order);
+}
+
+void
+store(std::uint64_t &word, std::uint64_t value, std::memory_order order = std::memory_order_relaxed) {
+    std::atomic_ref<std::uint64_t>(word).store(value, order);
+}
+
+std::uint64_t
+now_ms() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                          std::chrono::system_clock::now().time_since_epoch())
+                                          .count());
+}
+
+// Moves the slot to an odd sequence, skipped when another writer holds a fresh claim
+std::optional<std::uint64_t>
+claim(Slot &slot) {
+    auto       sequence = load(slot.sequence);
+    const auto now      = now_ms();
+    if ((sequence & 1) != 0 && (sequence >> 1) + stale_claim_ms > now) { return std::nullopt; }
+    const auto claimed = std::max(sequence, now << 1) | 1;
+    if (! std::atomic_ref<std::uint64_t>(slot.sequence)
+              .compare_exchange_strong(sequence, claimed, std::memory_order_acquire)) {
+        return std::nullopt;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    return claimed;
+}
+
+// Ends a claim, false when the slot was taken over as stale meanwhile
+bool
+release(Slot &slot, std::uint64_t claimed) {
+    return std::atomic_ref<std::uint64_t>(slot.sequence)
+        .compare_exchange_strong(claimed, claimed + 1, std::memory_order_release);
+}
+
+struct QueryKey {
+    std::uint64_t key   = 0;
+    std::uint64_t check = 0;
+};
+
+// Queries that matching treats the same get the same key: names compare case-insensitively, an unset style is
+// "Regular", unset numeric fields stay distinct from any value since they are not compared in the exact pass, and
+// tag lists are compared as sets. Tags keep their case, OpenType tells 'DFLT' from 'dflt' and so does matching.
+// Queries with invalid tags get no key, matching rejects them.
+std::optional<QueryKey>
+key_of(const FontQuery &query) {
+    std::string text = to_lower(*query.family);
+    text.push_back('\0');
+    text += to_lower(query.style.value_or("Regular"));
+    for (const auto &field : {query.weight, query.stretch}) {
+        text.push_back('\0');
+        text += field ? std::to_string(*field) : "-";
+    }
+    text.push_back('\0');
+    text += query.italic ? (*query.italic ? "1" : "0") : "-";
+    for (const auto *names : {&query.features, &query.scripts}) {
+        text.push_back('\0');
+        const auto tags = parse_tags(*names);
+        if (! tags) { return std::nullopt; }
+        for (const auto tag : *tags) { text.append(std::to_string(tag)).push_back(','); }
+    }
+    const auto bytes = std::as_bytes(std::span(text.data(), text.size()));
+    return QueryKey{hash_bytes(bytes, 0x6D61746368ull), hash_bytes(bytes, 0x7175657279ull)};
+}
+
+} // namespace
+
+struct MatchCache::Table {
+    std::byte  *base  = nullptr;
+    std::size_t size  = 0;
+    std::size_t slots = 0;
+
+    Table() = default;
+    Table(const Table &) = delete;
+    Table &
+    operator=(const Table &) = delete;
+    ~Table();
+
+    // Maps the table file, creating and stamping it when needed, null on any failure
+    static std::shared_ptr<Table>
+    open(const std::filesystem::path &path, std::size_t slots);
+
+    Slot *
+    bucket(std::uint64_t key) {
+        auto *first = reinterpret_cast<Slot *>(base + header_size);
+        return first + ((key & (slots - 1)) & ~(bucket_size - 1));
+    }
+};
+
+namespace {
+
+// Stamps a fresh or foreign file, the caller holds the file lock so no other process maps it half written
+void
+initialize(std::byte *base, std::size_t size, std::size_t slots) {
+    std::uint64_t stamped[3] = {0, slots, sizeof(Slot)};
+    std::memcpy(&stamped[0], table_signature.data(), table_signature.size());
+    if (std::memcmp(base, stamped, sizeof(stamped)) == 0) { return; }
+    std::memset(base, 0, size);
+    std::memcpy(base, stamped, sizeof(stamped));
+}
+
+} // namespace
+
+#if defined(_WIN32)
+
+std::shared_ptr<MatchCache::Table>
+MatchCache::Table::open(const std::filesystem::path &path, std::size_t slots) {
+    const std::size_t size = header_size + slots * sizeof(Slot);
+    HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return nullptr; }
+
+    // First user sizes and stamps the file, everyone else waits for that under the lock
+    OVERLAPPED whole{};
+    if (! ::LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &whole)) {
+        ::CloseHandle(file);
+        return nullptr;
+    }
+    std::shared_ptr<Table> table;
+    LARGE_INTEGER          current{};
+    LARGE_INTEGER          wanted{};
+    wanted.QuadPart = static_cast<LONGLONG>(size);
+    if (::GetFileSizeEx(file, &current) &&
+        (current.QuadPart == wanted.QuadPart ||
+         (::SetFilePointerEx(file, wanted, nullptr, FILE_BEGIN) && ::SetEndOfFile(file)))) {
+        // The view keeps the mapping object alive, neither handle is needed afterwards
+        if (HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READWRITE, 0, 0, nullptr)) {
+            void *view = ::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+            ::CloseHandle(mapping);
+            if (view) {
+                table        = std::make_shared<Table>();
+                table->base  = static_cast<std::byte *>(view);
+                table->size  = size;
+                table->slots = slots;
+                initialize(table->base, size, slots);
+                memory_counters().add(MemoryCategory::MappedResident, size);
+            }
+        }
+    }
+    ::UnlockFileEx(file, 0, MAXDWORD, MAXDWORD, &whole);
+    ::CloseHandle(file);
+    return table;
+}
+
+#else
+
+std::shared_ptr<MatchCache::Table>
+MatchCache::Table::open(const std::filesystem::path &path, std::size_t slots) {
+    const std::size_t size = header_size + slots * sizeof(Slot);
+    const int         fd   = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) { return nullptr; }
+
+    // First user sizes and stamps the file, everyone else waits for that under the lock
+    if (::flock(fd, LOCK_EX) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    std::shared_ptr<Table> table;
+    struct stat            info{};
+    if (::fstat(fd, &info) == 0 &&
+        (static_cast<std::size_t>(info.st_size) == size || ::ftruncate(fd, static_cast<off_t>(size)) == 0)) {
+        void *mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED) {
+            table        = std::make_shared<Table>();
+            table->base  = static_cast<std::byte *>(mapping);
+            table->size  = size;
+            table->slots = slots;
+            initialize(table->base, size, slots);
+            memory_counters().add(MemoryCategory::MappedResident, size);
+        }
+    }
+    ::flock(fd, LOCK_UN);
+    ::close(fd);
+    return table;
+}
+
+#endif
+
+MatchCache::Table::~Table() {
+    if (! base) { return; }
+#if defined(_WIN32)
+    ::UnmapViewOfFile(base);
+#else
+    ::munmap(base, size);
+#endif
+    memory_counters().release(MemoryCategory::MappedResident, size);
+}
+
+void
+MatchCache::configure(MatchCacheOptions options) {
+    options.slots = std::bit_ceil(std::max(options.slots, bucket_size));
+    std::lock_guard lock(mutex_);
+    options_ = options;
+    // Lookups in flight keep the previous mapping alive through their own reference
+    table_.store(nullptr, std::memory_order_release);
+    opened_.store(false, std::memory_order_release);
+}
+
+std::shared_ptr<MatchCache::Table>
+MatchCache::table() {
+    if (opened_.load(std::memory_order_acquire)) { return table_.load(std::memory_order_acquire); }
+
+    // Only the first lookup after a configure gets here
+    std::lock_guard lock(mutex_);
+    if (! opened_.load(std::memory_order_relaxed)) {
+        std::shared_ptr<Table> table;
+        if (options_.persistent) {
+            if (auto directory = cache_directory("matches")) {
+                table = Table::open(*directory / ("table-" + std::to_string(options_.slots)), options_.slots);
+            }
+        }
+        table_.store(std::move(table), std::memory_order_release);
+        opened_.store(true, std::memory_order_release);
+    }
+    return table_.load(std::memory_order_acquire);
+}
+
+std::optional<FaceMatch>
+MatchCache::find(const Catalog &catalog, const FontQuery &query) {
+    const auto queried = key_of(query);
+    auto       table   = this->table();
+    if (! queried || ! table) { return std::nullopt; }
+
+    const auto &key  = *queried;
+    Slot       *slot = table->bucket(key.key);
+    for (std::size_t i = 0; i < bucket_size; ++i, ++slot) {
+        const auto before = load(slot->sequence, std::memory_order_acquire);
+        if ((before & 1) != 0) { continue; }
+        const Slot read{.key     = load(slot->key),
+                        .check   = load(slot->check),
+                        .catalog = load(slot->catalog),
+                        .handle  = load(slot->handle),
+                        .scores  = load(slot->scores),
+                        .face    = load(slot->face)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (load(slot->sequence) != before) { continue; }
+
+        if (read.key != key.key || read.check != key.check || read.catalog != catalog.fingerprint) { continue; }
+        if (read.face >= catalog.faces.size() || catalog.faces[read.face].handle.value != read.handle) {
+            return std::nullopt;
+        }
+        return FaceMatch{.face         = static_cast<std::uint32_t>(read.face),
+                         .family_score = std::bit_cast<float>(static_cast<std::uint32_t>(read.scores >> 32)),
+                         .face_score   = std::bit_cast<float>(static_cast<std::uint32_t>(read.scores))};
+    }
+    return std::nullopt;
+}
+
+void
+MatchCache::insert(const Catalog &catalog, const FontQuery &query, const FaceMatch &match) {
+    const auto queried = key_of(query);
+    auto       table   = this->table();
+    if (! queried || ! table) { return; }
+
+    // Same key first, then a slot of another catalog (empty ones included), else the key picks the victim
+    const auto &key    = *queried;
+    Slot       *bucket = table->bucket(key.key);
+    Slot       *slot   = nullptr;
+    for (std::size_t i = 0; i < bucket_size && ! slot; ++i) {
+        if (load(bucket[i].key) == key.key && load(bucket[i].check) == key.check) { slot = &bucket[i]; }
+    }
+    for (std::size_t i = 0; i < bucket_size && ! slot; ++i) {
+        if (load(bucket[i].catalog) != catalog.fingerprint) { slot = &bucket[i]; }
+    }
+    if (! slot) { slot = &bucket[(key.check >> 32) & (bucket_size - 1)]; }
+
+    const auto claimed = claim(*slot);
+    if (! claimed) { return; }
+    store(slot->key, key.key);
+    store(slot->check, key.check);
+    store(slot->catalog, catalog.fingerprint);
+    store(slot->handle, catalog.faces[match.face].handle.value);
+    store(slot->scores, (static_cast<std::uint64_t>(std::bit_cast<std::uint32_t>(match.family_score)) << 32) |
+                            std::bit_cast<std::uint32_t>(match.face_score));
+    store(slot->face, match.face);
+    if (release(*slot, *claimed)) { return; }
+
+    // This writer stalled past the stale limit and its words may be mixed with those of the writer that took over,
+    // so the entry is wiped (a writer holding the slot now overwrites it anyway)
+    if (const auto wiped = claim(*slot)) {
+        store(slot->key, 0);
+        store(slot->check, 0);
+        release(*slot, *wiped);
+    }
+}
+
+MatchCache &
+match_cache() {
+    static MatchCache cache{};
+    return cache;
+}
+
+std::expected<FaceMatch, Error>
+cached_match(const Catalog &catalog, const FontQuery &query, MatchStats *stats, Deadline deadline) {
+    if (! query.family) { return match_face_in_catalog(catalog, query, stats, deadline); }
+    auto &cache = match_cache();
+    if (auto hit = cache.find(catalog, query)) {
+        if (stats) { stats->path = MatchPath::Cached; }
+        return *hit;
+    }
+    auto matched = match_face_in_catalog(catalog, query, stats, deadline);
+    if (matched && ! matched->partial) { cache.insert(catalog, query, *matched); }
+    return matched;
+}
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,163 @@
+#include <incfontdisc_private/memory.hpp>
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace incfontdisc::detail {
+
+namespace {
+
+#if defined(__linux__)
+// PSI of our own cgroup when running under cgroup v2 (containers), the system wide file otherwise
+std::string
+pressure_path() {
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string   line;
+    while (std::getline(cgroups, line)) {
+        if (! line.starts_with("0::")) { continue; }
+        std::string path = "/sys/fs/cgroup" + line.substr(3) + "/memory.pressure";
+        if (::access(path.c_str(), R_OK | W_OK) == 0) { return path; }
+    }
+    return "/proc/pressure/memory";
+}
+
+std::expected<int, Error>
+open_pressure_trigger(const MemoryOptions &options) {
+    const auto path = pressure_path();
+    const int  fd   = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return std::unexpected(
+            Error{ErrorCode::SystemError, "Failed to open " + path + ": " + std::strerror(errno)});
+    }
+    const auto trigger = "some " + std::to_string(options.pressure_stall.count()) + " " +
+                         std::to_string(options.pressure_window.count());
+    if (::write(fd, trigger.c_str(), trigger.size() + 1) < 0) {
+        const int error = errno;
+        ::close(fd);
+        return std::unexpected(
+            Error{ErrorCode::SystemError, "Failed to register PSI trigger on " + path + ": " + std::strerror(error)});
+    }
+    return fd;
+}
+#endif
+
+} // namespace
+
+MemoryCounters &
+memory_counters() {
+    static MemoryCounters counters{};
+    return counters;
+}
+
+std::uint64_t
+MemoryBudget::add_cache(Cache cache) {
+    std::lock_guard lock(mutex_);
+    const auto      handle = next_handle_++;
+    caches_.emplace_back(handle, std::move(cache));
+    std::stable_sort(caches_.begin(), caches_.end(),
+                     [](const auto &a, const auto &b) { return a.second.cost < b.second.cost; });
+    return handle;
+}
+
+void
+MemoryBudget::remove_cache(std::uint64_t handle) {
+    std::lock_guard lock(mutex_);
+    std::erase_if(caches_, [&](const auto &entry) { return entry.first == handle; });
+}
+
+std::expected<void, Error>
+MemoryBudget::configure(MemoryOptions options) {
+    if (options.watch_pressure && options.pressure_stall > options.pressure_window) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Pressure stall must not exceed its window"});
+    }
+
+    // Stop the previous watcher first, the new options may not ask for one
+    std::lock_guard configure_lock(configure_mutex_);
+    pressure_thread_ = {};
+    budget_.store(options.budget, std::memory_order_relaxed);
+    if (options.watch_pressure) {
+#if defined(__linux__)
+        auto fd = open_pressure_trigger(options);
+        if (! fd) { return std::unexpected(fd.error()); }
+        pressure_thread_ = std::jthread([this, fd = *fd, level = options.pressure_level](std::stop_token stop) {
+            watch_pressure(std::move(stop), fd, level);
+        });
+#else
+        return std::unexpected(Error{ErrorCode::NotImplemented, "Memory pressure watching requires Linux PSI"});
+#endif
+    }
+    charged();
+    return {};
+}
+
+void
+MemoryBudget::charged() {
+    const auto budget = budget_.load(std::memory_order_relaxed);
+    if (budget == 0) { return; }
+
+    std::lock_guard lock(mutex_);
+    const auto      used = trimmable_locked();
+    if (used > budget) { evict_locked(used - budget); }
+}
+
+std::size_t
+MemoryBudget::trim(TrimLevel level) {
+    std::lock_guard lock(mutex_);
+    const auto      used = trimmable_locked();
+    switch (level) {
+        case TrimLevel::Light:    return evict_locked(used / 4);
+        case TrimLevel::Moderate: return evict_locked(used / 2);
+        case TrimLevel::Complete: return evict_locked(used);
+    }
+    return 0;
+}
+
+std::size_t
+MemoryBudget::trimmable_locked() const {
+    std::size_t used = 0;
+    for (const auto &[handle, cache] : caches_) { used += cache.usage(); }
+    return used;
+}
+
+std::size_t
+MemoryBudget::evict_locked(std::size_t bytes) {
+    std::size_t freed = 0;
+    for (auto &[handle, cache] : caches_) {
+        if (freed >= bytes) { break; }
+        freed += cache.evict(bytes - freed);
+    }
+    return freed;
+}
+
+void
+MemoryBudget::watch_pressure([[maybe_unused]] std::stop_token stop, [[maybe_unused]] int fd,
+                             [[maybe_unused]] TrimLevel level) {
+#if defined(__linux__)
+    while (! stop.stop_requested()) {
+        pollfd entry{.fd = fd, .events = POLLPRI, .revents = 0};
+        const int ready = ::poll(&entry, 1, 250);
+        if (ready < 0 && errno != EINTR) { break; }
+        if (ready <= 0) { continue; }
+        // POLLERR means the cgroup went away, there is nothing left to watch
+        if (entry.revents & POLLERR) { break; }
+        if (entry.revents & POLLPRI) { trim(level); }
+    }
+    ::close(fd);
+#endif
+}
+
+MemoryBudget &
+memory_budget() {
+    static MemoryBudget budget{};
+    return budget;
+}
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,239 @@
+#include <incfontdisc_private/catalog.hpp>
+#include <incfontdisc_private/deadline.hpp>
+#include <incfontdisc_private/open_files.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace incfontdisc::detail {
+
+namespace {
+
+// Stays well below the default descriptor limits while covering the fonts a UI uses at once
+constexpr std::size_t open_file_capacity = 64;
+// Reads between two deadline checks
+constexpr std::size_t read_chunk         = std::size_t{1} << 20;
+
+std::filesystem::path
+native_path(const std::string &path) {
+    return std::filesystem::path(std::u8string(reinterpret_cast<const char8_t *>(path.data()),
+                                               reinterpret_cast<const char8_t *>(path.data() + path.size())));
+}
+
+} // namespace
+
+#if defined(_WIN32)
+
+class OpenFileCache::File final {
+public:
+    static std::expected<std::shared_ptr<File>, Error>
+    open(const std::string &path) {
+        HANDLE handle = ::CreateFileW(native_path(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            const auto error = ::GetLastError();
+            if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND) {
+                return std::unexpected(Error{ErrorCode::InvalidArgument, "Font file does not exist"});
+            }
+            return std::unexpected(Error{ErrorCode::SystemError, "Failed to open font file"});
+        }
+        return std::make_shared<File>(handle);
+    }
+
+    explicit File(HANDLE handle)
+        : handle_(handle) {}
+    ~File() {
+        ::CloseHandle(handle_);
+    }
+    File(const File &)            = delete;
+    File &operator=(const File &) = delete;
+
+    // Size and write time as file_fingerprint reports them, a FILETIME is what file_clock counts
+    std::optional<FileFingerprint>
+    fingerprint() const {
+        BY_HANDLE_FILE_INFORMATION info{};
+        if (! ::GetFileInformationByHandle(handle_, &info)) { return std::nullopt; }
+        return FileFingerprint{
+            .size  = (static_cast<std::uintmax_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow,
+            .mtime = static_cast<std::int64_t>((static_cast<std::uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+                                               info.ftLastWriteTime.dwLowDateTime)};
+    }
+
+    // Positioned reads of the first 'size' bytes, several threads may read the same file at once
+    std::expected<ByteBuffer, Error>
+    read(std::uintmax_t size, Deadline deadline) const {
+        if (size == 0) { return std::unexpected(Error{ErrorCode::SystemError, "Font file is empty"}); }
+        ByteBuffer  buffer(static_cast<std::size_t>(size));
+        std::size_t done = 0;
+        while (done < buffer.size()) {
+            if (expired(deadline)) { return std::unexpected(timeout_error("Font load")); }
+            OVERLAPPED at{};
+            at.Offset     = static_cast<DWORD>(done);
+            at.OffsetHigh = static_cast<DWORD>(static_cast<std::uint64_t>(done) >> 32);
+            const auto chunk = static_cast<DWORD>(std::min(buffer.size() - done, read_chunk));
+            DWORD      got   = 0;
+            if (! ::ReadFile(handle_, buffer.data() + done, chunk, &got, &at) || got == 0) {
+                return std::unexpected(Error{ErrorCode::SystemError, "Failed to read font file"});
+            }
+            done += got;
+        }
+        return buffer;
+    }
+
+private:
+    HANDLE handle_ = INVALID_HANDLE_VALUE;
+};
+
+#else
+
+class OpenFileCache::File final {
+public:
+    static std::expected<std::shared_ptr<File>, Error>
+    open(const std::string &path) {
+        const int fd = ::open(native_path(path).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT || errno == ENOTDIR) {
+                return std::unexpected(Error{ErrorCode::InvalidArgument, "Font file does not exist"});
+            }
+            return std::unexpected(Error{ErrorCode::SystemError, "Failed to open font file"});
+        }
+        return std::make_shared<File>(fd);
+    }
+
+    explicit File(int fd)
+        : fd_(fd) {}
+    ~File() {
+        ::close(fd_);
+    }
+    File(const File &)            = delete;
+    File &operator=(const File &) = delete;
+
+    // Size and write time as file_fingerprint reports them
+    std::optional<FileFingerprint>
+    fingerprint() const {
+        struct stat info{};
+        if (::fstat(fd_, &info) != 0) { return std::nullopt; }
+        const auto written = std::chrono::sys_seconds(std::chrono::seconds(info.st_mtim.tv_sec)) +
+                             std::chrono::nanoseconds(info.st_mtim.tv_nsec);
+        const auto ticks   = std::chrono::time_point_cast<std::chrono::file_clock::duration>(
+            std::chrono::file_clock::from_sys(written));
+        return FileFingerprint{.size  = static_cast<std::uintmax_t>(info.st_size),
+                               .mtime = static_cast<std::int64_t>(ticks.time_since_epoch().count())};
+    }
+
+    // Positioned reads of the first 'size' bytes, several threads may read the same file at once
+    std::expected<ByteBuffer, Error>
+    read(std::uintmax_t size, Deadline deadline) const {
+        if (size == 0) { return std::unexpected(Error{ErrorCode::SystemError, "Font file is empty"}); }
+        ByteBuffer  buffer(static_cast<std::size_t>(size));
+        std::size_t done = 0;
+        while (done < buffer.size()) {
+            if (expired(deadline)) { return std::unexpected(timeout_error("Font load")); }
+            const auto got = ::pread(fd_, buffer.data() + done, std::min(buffer.size() - done, read_chunk),
+                                     static_cast<off_t>(done));
+            if (got < 0 && errno == EINTR) { continue; }
+            // Zero means the file shrank since fstat
+            if (got <= 0) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to read font file"}); }
+            done += static_cast<std::size_t>(got);
+        }
+        return buffer;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+#endif
+
+std::expected<ByteBuffer, Error>
+OpenFileCache::read(const FontId &id, Deadline deadline) {
+    const auto path = split_font_id(id).first;
+    if (path.empty()) { return std::unexpected(Error{ErrorCode::InvalidArgument, "FontId is empty"}); }
+    const auto catalog = catalog_store().current();
+    // What the catalog saw of this file, absent for faces it does not know (or knows through a duplicate in another
+    // file)
+    std::optional<FileFingerprint> expected;
+    if (catalog) {
+        if (const auto face = catalog->find_face(id);
+            face && split_font_id(catalog->faces[*face].descriptor.id).first == path) {
+            expected = catalog->faces[*face].file;
+        }
+    }
+    if (! expected) {
+        auto file = File::open(path);
+        if (! file) { return std::unexpected(file.error()); }
+        const auto fingerprint = (*file)->fingerprint();
+        if (! fingerprint) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to query font file"}); }
+        return (*file)->read(fingerprint->size, deadline);
+    }
+
+    // Files leaving the cache are closed after the lock is released
+    std::shared_ptr<File>              file;
+    std::vector<std::shared_ptr<File>> retired;
+    {
+        std::lock_guard lock(mutex_);
+        if (auto it = by_path_.find(path); it != by_path_.end()) {
+            if (it->second->generation == catalog->generation) {
+                entries_.splice(entries_.begin(), entries_, it->second);
+                file = it->second->file;
+            }
+            else {
+                retired.push_back(std::move(it->second->file));
+                entries_.erase(it->second);
+                by_path_.erase(it);
+            }
+        }
+    }
+    if (file) {
+        // A file rewritten in place no longer is the one the catalog describes, it is read without the cache until a
+        // refresh catches up. A file replaced by a rename keeps serving the old version until then, like the catalog.
+        const auto fingerprint = file->fingerprint();
+        if (fingerprint && *fingerprint == *expected) { return file->read(fingerprint->size, deadline); }
+        std::lock_guard lock(mutex_);
+        if (auto it = by_path_.find(path); it != by_path_.end() && it->second->file == file) {
+            retired.push_back(std::move(it->second->file));
+            entries_.erase(it->second);
+            by_path_.erase(it);
+        }
+    }
+
+    // Opened without the lock, a racing load of the same path may open it too and the later insert is dropped
+    auto opened = File::open(path);
+    if (! opened) { return std::unexpected(opened.error()); }
+    file                   = std::move(*opened);
+    const auto fingerprint = file->fingerprint();
+    if (! fingerprint) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to query font file"}); }
+    if (*fingerprint == *expected) {
+        std::lock_guard lock(mutex_);
+        if (! by_path_.contains(path)) {
+            entries_.push_front(Entry{.path = path, .generation = catalog->generation, .file = file});
+            by_path_.emplace(path, entries_.begin());
+            if (entries_.size() > open_file_capacity) {
+                retired.push_back(std::move(entries_.back().file));
+                by_path_.erase(entries_.back().path);
+                entries_.pop_back();
+            }
+        }
+    }
+    // Reads in flight keep an evicted file open through their own reference
+    return file->read(fingerprint->size, deadline);
+}
+
+OpenFileCache &
+open_files() {
+    static OpenFileCache files{};
+    return files;
+}
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,113 @@
+#include <incfontdisc_private/memory.hpp>
+#include <incfontdisc_private/pinned_fonts.hpp>
+
+#include <filesystem>
+#include <system_error>
+
+namespace incfontdisc::detail {
+
+void
+PinnedFonts::configure(PinOptions options) {
+    std::lock_guard lock(mutex_);
+    options_ = options;
+}
+
+std::expected<void, Error>
+PinnedFonts::fits_locked(std::size_t bytes) const {
+    if (options_.budget != 0 && pinned_bytes_ + bytes > options_.budget) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Pinning " + std::to_string(bytes) +
+                                                                     " bytes would exceed the pinned memory budget"});
+    }
+    return {};
+}
+
+std::expected<void, Error>
+PinnedFonts::pin(FontHandle face, const std::string &path) {
+    PinOptions options{};
+    {
+        std::lock_guard lock(mutex_);
+        if (faces_.contains(face.value)) { return {}; }
+        if (auto file = files_.find(path); file != files_.end()) {
+            ++file->second.faces;
+            faces_.emplace(face.value, path);
+            return {};
+        }
+        // Refuse before reading anything when the size on disk already rules the file out
+        std::error_code error;
+        const auto      size = std::filesystem::file_size(path, error);
+        if (! error) {
+            if (auto fits = fits_locked(static_cast<std::size_t>(size)); ! fits) { return fits; }
+        }
+        options = options_;
+    }
+
+    auto mapped = MappedFile::open(path);
+    if (! mapped) { return std::unexpected(mapped.error()); }
+    (*mapped)->prefetch();
+    if (options.lock) {
+        if (auto locked = (*mapped)->lock(); ! locked) { return locked; }
+    }
+
+    std::lock_guard lock(mutex_);
+    if (faces_.contains(face.value)) { return {}; }
+    faces_.emplace(face.value, path);
+    // Another face of the file got pinned while this one was read in, its mapping wins
+    if (auto file = files_.find(path); file != files_.end()) {
+        ++file->second.faces;
+        return {};
+    }
+    const auto bytes = (*mapped)->bytes().size();
+    if (auto fits = fits_locked(bytes); ! fits) {
+        faces_.erase(face.value);
+        return fits;
+    }
+    files_.emplace(path, File{.mapping = std::move(*mapped), .faces = 1, .locked = options.lock});
+    pinned_bytes_ += bytes;
+    if (options.lock) { locked_bytes_ += bytes; }
+    return {};
+}
+
+std::expected<void, Error>
+PinnedFonts::unpin(FontHandle face) {
+    std::shared_ptr<const MappedFile> released;
+    {
+        std::lock_guard lock(mutex_);
+        auto            pinned = faces_.find(face.value);
+        if (pinned == faces_.end()) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Face is not pinned"}); }
+        auto file = files_.find(pinned->second);
+        faces_.erase(pinned);
+        if (--file->second.faces > 0) { return {}; }
+
+        const auto bytes = file->second.mapping->bytes().size();
+        pinned_bytes_ -= bytes;
+        if (file->second.locked) { locked_bytes_ -= bytes; }
+        released = std::move(file->second.mapping);
+        files_.erase(file);
+    }
+    // Unmapping (and unlocking) happens outside the lock, or when the last load sharing the mapping lets go of it
+    return {};
+}
+
+std::shared_ptr<const MappedFile>
+PinnedFonts::find(const std::string &path) {
+    std::lock_guard lock(mutex_);
+    auto            file = files_.find(path);
+    return file == files_.end() ? nullptr : file->second.mapping;
+}
+
+PinStats
+PinnedFonts::stats() {
+    std::lock_guard lock(mutex_);
+    return PinStats{.faces        = faces_.size(),
+                    .files        = files_.size(),
+                    .pinned_bytes = pinned_bytes_,
+                    .locked_bytes = locked_bytes_};
+}
+
+PinnedFonts &
+pinned_fonts() {
+    static PinnedFonts pinned{};
+    return pinned;
+}
+
+} // namespace incfontdisc::detail
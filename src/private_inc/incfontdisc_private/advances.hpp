@@ -0,0 +1,89 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+#include <incfontdisc_private/sfnt.hpp>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace incfontdisc::detail {
+
+// Codepoint -> horizontal advance of one face, flattened from cmap and hmtx so measuring never needs the font again
+class AdvanceTable final {
+public:
+    static std::expected<AdvanceTable, Error>
+    from_font(const sfnt::FontFile &font);
+
+    // std::nullopt when the face does not map 'codepoint'
+    std::optional<std::uint16_t>
+    advance(char32_t codepoint) const;
+    std::uint16_t
+    units_per_em() const {
+        return units_per_em_;
+    }
+    std::uint16_t
+    notdef_advance() const {
+        return notdef_advance_;
+    }
+    std::size_t
+    bytes() const;
+
+private:
+    // Consecutive mapped codepoints [first, first + count), their advances start at advances_[offset]
+    struct Run {
+        char32_t      first  = 0;
+        std::uint32_t count  = 0;
+        std::uint32_t offset = 0;
+    };
+
+    std::vector<Run>           runs_{};
+    std::vector<std::uint16_t> advances_{};
+    std::uint16_t              units_per_em_   = 0;
+    std::uint16_t              notdef_advance_ = 0;
+};
+
+// Advance tables keyed by face handle, an entry whose face fingerprint changed is treated as missing.
+// Accounted as AdvanceTables memory and evicted last since rebuilding an entry means reading the font file.
+class AdvanceCache final {
+public:
+    AdvanceCache();
+    ~AdvanceCache();
+
+    std::shared_ptr<const AdvanceTable>
+    find(FontHandle face, std::uint64_t fingerprint);
+    void
+    insert(FontHandle face, std::uint64_t fingerprint, std::shared_ptr<const AdvanceTable> table);
+
+    std::size_t
+    usage() const;
+    std::size_t
+    evict(std::size_t bytes);
+
+private:
+    struct Entry {
+        std::uint64_t                       face        = 0;
+        std::uint64_t                       fingerprint = 0;
+        std::shared_ptr<const AdvanceTable> table{};
+    };
+
+    void
+    erase_locked(std::list<Entry>::iterator entry);
+    std::size_t
+    evict_locked(std::size_t bytes);
+
+    mutable std::mutex                                            mutex_{};
+    std::list<Entry>                                              lru_{};
+    std::unordered_map<std::uint64_t, std::list<Entry>::iterator> entries_{};
+    std::size_t                                                   bytes_         = 0;
+    std::uint64_t                                                 budget_handle_ = 0;
+};
+
+AdvanceCache &
+advance_cache();
+
+} // namespace incfontdisc::detail
@@ -4,22 +4,30 @@
 
 namespace incfontdisc::detail {
 
+// Backends only discover faces and read font files.
+// Matching, caching and everything else happens on top of the catalog built from 'enumerate_fonts'.
+
+// A discovered face, the fields beyond the descriptor let the catalog recognise one design installed twice
+struct FaceRecord {
+    FontDescriptor descriptor{};
+    std::string    postscript_name{};
+    // head.fontRevision as 16.16 fixed point, 0 when unknown
+    std::int32_t   version  = 0;
+    // A variable font or one of its named instances
+    bool           variable = false;
+    // PostScript (CFF) outlines
+    bool           cff      = false;
+};
+
 #if defined(INCFONTDISC_BACKEND_FONTCONFIG)
 
 class FontconfigBackend final {
 public:
-    std::expected<std::vector<FontDescriptor>, Error>
-    list_fonts();
-    std::expected<void, Error>
-    refresh_fonts();
-    std::expected<FontMatch, Error>
-    match_fonts(FontQuery query);
-    std::expected<ByteBuffer, Error>
-    load_font_data(const FontId &id);
-
-private:
-    std::expected<std::vector<FontDescriptor>, Error>
+    std::expected<std::vector<FaceRecord>, Error>
     enumerate_fonts();
+    // Stops reading with Timeout once 'deadline' passes
+    std::expected<ByteBuffer, Error>
+    load_font_data(const FontId &id, Deadline deadline = Deadline::max());
 };
 
 using Backend = FontconfigBackend;
@@ -28,18 +36,11 @@ using Backend = FontconfigBackend;
 
 class DWriteBackend final {
 public:
-    std::expected<std::vector<FontDescriptor>, Error>
-    list_fonts();
-    std::expected<void, Error>
-    refresh_fonts();
-    std::expected<FontMatch, Error>
-    match_fonts(FontQuery query);
-    std::expected<ByteBuffer, Error>
-    load_font_data(const FontId &id);
-
-private:
-    std::expected<std::vector<FontDescriptor>, Error>
+    std::expected<std::vector<FaceRecord>, Error>
     enumerate_fonts();
+    // Stops reading with Timeout once 'deadline' passes
+    std::expected<ByteBuffer, Error>
+    load_font_data(const FontId &id, Deadline deadline = Deadline::max());
 };
 
 using Backend = DWriteBackend;
@@ -48,20 +49,12 @@ using Backend = DWriteBackend;
 
 class BackendUnavailable final {
 public:
-    std::expected<std::vector<FontDescriptor>, Error>
-    list_fonts() {
-        return std::unexpected(Error{ErrorCode::BackendUnavailable, "No backend configured"});
-    }
-    std::expected<void, Error>
-    refresh_fonts() {
-        return std::unexpected(Error{ErrorCode::BackendUnavailable, "No backend configured"});
-    }
-    std::expected<FontMatch, Error>
-    match_fonts(FontQuery) {
+    std::expected<std::vector<FaceRecord>, Error>
+    enumerate_fonts() {
         return std::unexpected(Error{ErrorCode::BackendUnavailable, "No backend configured"});
     }
     std::expected<ByteBuffer, Error>
-    load_font_data(const FontId &) {
+    load_font_data(const FontId &, Deadline = Deadline::max()) {
         return std::unexpected(Error{ErrorCode::BackendUnavailable, "No backend configured"});
     }
 };
@@ -76,4 +69,4 @@ backend_instance() {
     return backend;
 }
 
-} // namespace incfontdisc::detail
\ No newline at end of file
+} // namespace incfontdisc::detail
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+#include <incfontdisc_private/backend.hpp>
+#include <incfontdisc_private/file_hash.hpp>
+#include <incfontdisc_private/script.hpp>
+#include <incfontdisc_private/sfnt.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace incfontdisc::detail {
+
+std::string
+to_lower(std::string_view value);
+std::string
+normalize_family(std::string_view value);
+// FontIds of both backends have the form "<file path>#<face index>"
+std::pair<std::string, int>
+split_font_id(const FontId &id);
+// The face within its file, fontconfig ids carry the named instance of a variable font in the upper 16 bits
+constexpr int
+face_in_file(int index) {
+    return index & 0xFFFF;
+}
+FontHandle
+handle_of(const FontId &id);
+// Script or feature names as matching compares them: padded to four characters, sorted and without repeats
+std::expected<std::vector<std::uint32_t>, Error>
+parse_tags(const std::vector<std::string> &names);
+
+struct CatalogFace {
+    FontDescriptor  descriptor{};
+    std::string     family_lower{};
+    std::string     family_norm{};
+    std::string     style_lower{};
+    FontHandle      handle{};
+    std::uint64_t   fingerprint = 0;
+    std::string     postscript_name{};
+    std::int32_t    version  = 0;
+    bool            variable = false;
+    bool            cff      = false;
+    // Size and write time of the face's file when the catalog was built
+    FileFingerprint file{};
+    // Index into Catalog::layouts
+    std::uint32_t   layout   = 0;
+    // Bit i set when the face covers Script(i)
+    std::uint64_t   scripts  = 0;
+    // The face's own style class, see fallback_class
+    std::uint8_t    fallback = 0;
+};
+
+constexpr std::size_t fallback_classes = 12;
+
+// Genre, weight and slant packed into [0, fallback_classes)
+constexpr std::size_t
+fallback_class(const FallbackStyle &style) {
+    return static_cast<std::size_t>(style.genre) * 4 + (style.bold ? 2 : 0) + (style.italic ? 1 : 0);
+}
+
+// What a generation looked like, sorted by handle, kept after its catalog is gone so generations can be diffed
+struct FaceState {
+    std::uint64_t handle      = 0;
+    std::uint64_t fingerprint = 0;
+};
+
+// All faces whose family names normalize to the same key, in enumeration order
+struct CatalogFamily {
+    std::string                name_norm{};
+    std::vector<std::uint32_t> faces{};
+    // Where the family's run in Catalog::attributes starts
+    std::uint32_t              attributes = 0;
+};
+
+// What face matching compares, packed family by family so scoring runs over contiguous arrays.
+// Entry attributes + k of a family describes its faces[k].
+struct FaceAttributes {
+    // Into Catalog::style_ids
+    std::vector<std::uint32_t> style{};
+    std::vector<std::int32_t>  weight{};
+    std::vector<std::int32_t>  stretch{};
+    std::vector<std::uint8_t>  italic{};
+};
+
+// Heap footprint of a catalog, computed once when it is built
+struct CatalogMemory {
+    std::size_t descriptors    = 0;
+    std::size_t strings        = 0;
+    std::size_t family_index   = 0;
+    std::size_t fuzzy_index    = 0;
+    std::size_t id_index       = 0;
+    std::size_t coverage_index = 0;
+};
+
+// One partition of the catalog's indices. Families are routed to a shard by the hash of their normalized name and
+// faces by their handle, so every shard is built on its own and lookups touch a single shard.
+struct CatalogShard {
+    // Lowercased family name -> family, relative to family_begin
+    std::unordered_map<std::string, std::uint32_t>   family_by_lower{};
+    std::unordered_map<std::string, std::uint32_t>   face_by_id{};
+    std::unordered_map<std::uint64_t, std::uint32_t> face_by_handle{};
+    // The families of this shard, a contiguous range of Catalog::families
+    std::uint32_t                                    family_begin = 0;
+    std::uint32_t                                    family_end   = 0;
+};
+
+// Immutable snapshot of the system fonts, shared by readers and replaced as a whole on refresh
+struct Catalog {
+    std::vector<CatalogFace>                       faces{};
+    // Grouped by shard, within a shard in the order their first face was enumerated
+    std::vector<CatalogFamily>                     families{};
+    // A power of two, one for system sized catalogs
+    std::vector<CatalogShard>                      shards{};
+    FaceAttributes                                 attributes{};
+    // Lowercased style name -> id, styles of queries that name none of these match no face exactly
+    std::unordered_map<std::string, std::uint32_t> style_ids{};
+    // Distinct GSUB/GPOS tag sets of the faces, the first one is empty
+    std::vector<sfnt::LayoutTags>                  layouts{};
+    bool                                           layout_indexed = false;
+    // Faces to fall back to per script and style class, closest first, at script * fallback_classes + class
+    std::vector<std::vector<std::uint32_t>>        fallbacks{};
+    bool                                           fallback_indexed = false;
+    std::uint64_t                                  generation       = 0;
+    // Equal in every process that built from the same faces with the same options
+    std::uint64_t                                  fingerprint      = 0;
+    std::size_t                                    duplicates       = 0;
+    CatalogMemory                                  memory{};
+
+    std::optional<std::uint32_t>
+    find_family(const std::string &family) const;
+    // Ids of faces left out as duplicates resolve to the face that was kept
+    std::optional<std::uint32_t>
+    find_face(const FontId &id) const;
+    std::optional<std::uint32_t>
+    find_face(FontHandle handle) const;
+};
+
+// Progress reporting and cancellation of one catalog build
+class BuildControl final {
+public:
+    BuildControl(std::stop_token stop_token, std::function<void(const RefreshProgress &)> progress)
+        : stop_token_(std::move(stop_token)), progress_(std::move(progress)) {}
+
+    bool
+    stopped() const {
+        return stop_token_.stop_requested();
+    }
+    void
+    start(RefreshPhase phase, std::size_t total);
+    // Adds 'count' to the current phase, safe to call from worker threads
+    void
+    advance(std::size_t count);
+
+private:
+    std::stop_token                              stop_token_;
+    std::function<void(const RefreshProgress &)> progress_;
+    std::mutex                                   mutex_{};
+    RefreshProgress                              current_{};
+};
+
+Error
+cancelled_error(const std::string &operation);
+
+// Faces that duplicate another one under 'options.duplicates' are left out, their ids resolve to the kept face.
+// Cancelled when 'control' is stopped before the catalog is complete.
+// Faces whose fingerprint is unchanged since 'previous' take their index tables from it instead of their file.
+std::expected<std::shared_ptr<Catalog>, Error>
+build_catalog(std::vector<FaceRecord> fonts, const CatalogOptions &options, BuildControl *control = nullptr,
+              const Catalog *previous = nullptr);
+
+// Filled in by match_in_catalog on request, timing is only taken when stats are asked for
+struct MatchStats {
+    MatchPath                path             = MatchPath::Unknown;
+    std::size_t              families_scanned = 0;
+    std::size_t              faces_scored     = 0;
+    std::chrono::nanoseconds family_phase{};
+    std::chrono::nanoseconds face_phase{};
+};
+
+struct RefreshStats {
+    std::size_t              faces = 0;
+    std::chrono::nanoseconds enumerate_phase{};
+    std::chrono::nanoseconds index_phase{};
+};
+
+// The face chosen for a query, as an index into Catalog::faces
+struct FaceMatch {
+    std::uint32_t face         = 0;
+    float         family_score = 0.0f;
+    float         face_score   = 0.0f;
+    // The deadline cut the family pass short, another call might choose differently
+    bool          partial      = false;
+};
+
+// A fuzzy family pass interrupted by 'deadline' settles for the best family scored so far
+std::expected<FaceMatch, Error>
+match_face_in_catalog(const Catalog &catalog, FontQuery query, MatchStats *stats = nullptr,
+                      Deadline deadline = Deadline::max());
+std::expected<FontMatch, Error>
+match_in_catalog(const Catalog &catalog, FontQuery query, MatchStats *stats = nullptr,
+                 Deadline deadline = Deadline::max());
+// True when matching 'query' needs a catalog built with layout_index
+bool
+needs_layout_index(const FontQuery &query);
+
+class CatalogStore final {
+public:
+    std::expected<std::shared_ptr<const Catalog>, Error>
+    snapshot();
+    // snapshot() with the indices asked for, a catalog built without one is rebuilt with it and keeps it from then on
+    std::expected<std::shared_ptr<const Catalog>, Error>
+    indexed_snapshot(bool layout_index, bool fallback_index);
+    // A stopped 'control' abandons the new catalog and keeps the current one
+    std::expected<void, Error>
+    refresh(RefreshStats *stats = nullptr, BuildControl *control = nullptr);
+    // The current snapshot without building one, null before the first use
+    std::shared_ptr<const Catalog>
+    current();
+    std::expected<void, Error>
+    configure(CatalogOptions options);
+    std::expected<CatalogDiff, Error>
+    diff(std::uint64_t old_generation, std::uint64_t new_generation);
+    // Builds from 'faces' instead of the backend's enumeration from now on, an empty list goes back to the backend
+    std::expected<void, Error>
+    register_faces(std::vector<FaceRecord> faces);
+
+private:
+    struct Generation {
+        std::uint64_t                                 generation = 0;
+        std::shared_ptr<const std::vector<FaceState>> faces{};
+    };
+
+    std::expected<std::shared_ptr<Catalog>, Error>
+    rebuild(RefreshStats *stats, const CatalogOptions &options,
+            const std::shared_ptr<const std::vector<FaceRecord>> &registered, BuildControl *control,
+            const Catalog *previous);
+    void
+    install_locked(std::shared_ptr<Catalog> catalog);
+
+    std::mutex                                     mutex_{};
+    std::mutex                                     refresh_mutex_{};
+    std::shared_ptr<const Catalog>                 catalog_{};
+    CatalogOptions                                 options_{};
+    std::shared_ptr<const std::vector<FaceRecord>> registered_{};
+    std::uint64_t                                  last_generation_ = 0;
+    std::deque<Generation>                         history_{};
+};
+
+CatalogStore &
+catalog_store();
+
+} // namespace incfontdisc::detail
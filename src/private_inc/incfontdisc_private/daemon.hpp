@@ -0,0 +1,77 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+#include <incfontdisc_private/daemon_protocol.hpp>
+#include <incfontdisc_private/mapped_file.hpp>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define INCFONTDISC_HAS_UNIX_SOCKETS 1
+#endif
+
+namespace incfontdisc::detail {
+
+std::string
+default_socket_path();
+
+// Forwards requests to a running incfontdiscd.
+// Every call returns std::nullopt when no daemon is reachable, the caller then serves the request locally.
+// Calls given a deadline return Timeout once it passes, a daemon busy with other clients included.
+class DaemonClient final {
+public:
+    void
+    configure(DaemonClientOptions options);
+
+    std::optional<std::expected<std::vector<FontDescriptor>, Error>>
+    list_fonts();
+    std::optional<std::expected<void, Error>>
+    refresh_fonts(Deadline deadline = Deadline::max());
+    std::optional<std::expected<FontMatch, Error>>
+    match_fonts(const FontQuery &query, Deadline deadline = Deadline::max());
+    std::optional<std::expected<FontDescriptor, Error>>
+    describe_font(const FontId &id);
+    std::optional<std::expected<ByteBuffer, Error>>
+    load_font_data(const FontId &id, Deadline deadline = Deadline::max());
+    // Maps the descriptor the daemon passes, the file is never reopened or copied
+    std::optional<std::expected<std::shared_ptr<const MappedFile>, Error>>
+    map_font_data(const FontId &id, Deadline deadline = Deadline::max());
+
+private:
+    struct Response {
+        protocol::FrameHeader header{};
+        std::string           payload{};
+        int                   fd = -1;
+    };
+
+    std::optional<std::expected<Response, Error>>
+    call(protocol::Op op, const std::string &payload, Deadline deadline);
+    // The descriptor of the face's file, owned by the caller
+    std::optional<std::expected<int, Error>>
+    open_font_file(const FontId &id, Deadline deadline);
+    bool
+    connect_locked();
+    void
+    disconnect_locked();
+    void
+    mark_unreachable_locked();
+
+    std::timed_mutex    mutex_{};
+    DaemonClientOptions options_{};
+    int                 fd_ = -1;
+    // Connecting is not retried before 'retry_at_', the wait doubles with every failed probe
+    std::chrono::steady_clock::time_point retry_at_{};
+    std::chrono::seconds                  retry_delay_{0};
+};
+
+DaemonClient &
+daemon_client();
+
+std::expected<void, Error>
+serve_daemon(const DaemonOptions &options);
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Wire format between incfontdiscd and the library in client mode.
+// Both ends always run on the same host, so integers travel in native byte order.
+//
+// Every message is a FrameHeader followed by 'size' bytes of payload.
+// Requests carry the opcode, responses echo it and set 'status' (0 on success, ErrorCode + 1 otherwise).
+// Error payloads are a single string. A successful Load response also carries the open font file as SCM_RIGHTS.
+
+namespace incfontdisc::detail::protocol {
+
+inline constexpr std::uint16_t version        = 2;
+inline constexpr std::uint32_t max_frame_size = 64u * 1024u * 1024u;
+
+enum class Op : std::uint8_t {
+    List     = 1,
+    Match    = 2,
+    Describe = 3,
+    Load     = 4,
+    Refresh  = 5,
+};
+
+struct FrameHeader {
+    std::uint32_t size    = 0;
+    std::uint16_t version = protocol::version;
+    std::uint8_t  op      = 0;
+    std::uint8_t  status  = 0;
+};
+static_assert(sizeof(FrameHeader) == 8);
+
+class Writer final {
+public:
+    void
+    u8(std::uint8_t value) {
+        buffer_.push_back(static_cast<char>(value));
+    }
+    void
+    i32(std::int32_t value) {
+        raw(&value, sizeof(value));
+    }
+    void
+    u64(std::uint64_t value) {
+        raw(&value, sizeof(value));
+    }
+    void
+    f32(float value) {
+        raw(&value, sizeof(value));
+    }
+    void
+    str(std::string_view value) {
+        const auto size = static_cast<std::uint32_t>(value.size());
+        raw(&size, sizeof(size));
+        buffer_.append(value);
+    }
+    void
+    descriptor(const FontDescriptor &font) {
+        str(font.id.value);
+        str(font.family);
+        str(font.style);
+        i32(font.weight);
+        i32(font.stretch);
+        u8(font.italic ? 1 : 0);
+    }
+    void
+    query(const FontQuery &query) {
+        u8(query.family ? 1 : 0);
+        if (query.family) { str(*query.family); }
+        u8(query.style ? 1 : 0);
+        if (query.style) { str(*query.style); }
+        u8(query.weight ? 1 : 0);
+        if (query.weight) { i32(*query.weight); }
+        u8(query.stretch ? 1 : 0);
+        if (query.stretch) { i32(*query.stretch); }
+        u8(query.italic ? 1 : 0);
+        if (query.italic) { u8(*query.italic ? 1 : 0); }
+        strings(query.features);
+        strings(query.scripts);
+    }
+    void
+    strings(const std::vector<std::string> &values) {
+        i32(static_cast<std::int32_t>(values.size()));
+        for (const auto &value : values) { str(value); }
+    }
+
+    const std::string &
+    data() const {
+        return buffer_;
+    }
+
+private:
+    void
+    raw(const void *data, std::size_t size) {
+        buffer_.append(static_cast<const char *>(data), size);
+    }
+
+    std::string buffer_{};
+};
+
+// Every read reports failure instead of reading past the end, a failed read poisons the reader
+class Reader final {
+public:
+    explicit Reader(std::span<const char> data) : data_(data) {}
+
+    bool
+    ok() const {
+        return ok_;
+    }
+    bool
+    at_end() const {
+        return ok_ && pos_ == data_.size();
+    }
+
+    std::uint8_t
+    u8() {
+        std::uint8_t value = 0;
+        raw(&value, sizeof(value));
+        return value;
+    }
+    std::int32_t
+    i32() {
+        std::int32_t value = 0;
+        raw(&value, sizeof(value));
+        return value;
+    }
+    std::uint64_t
+    u64() {
+        std::uint64_t value = 0;
+        raw(&value, sizeof(value));
+        return value;
+    }
+    float
+    f32() {
+        float value = 0.0f;
+        raw(&value, sizeof(value));
+        return value;
+    }
+    std::string
+    str() {
+        std::uint32_t size = 0;
+        raw(&size, sizeof(size));
+        if (! ok_ || data_.size() - pos_ < size) {
+            ok_ = false;
+            return {};
+        }
+        std::string value(data_.data() + pos_, size);
+        pos_ += size;
+        return value;
+    }
+    FontDescriptor
+    descriptor() {
+        FontDescriptor font{};
+        font.id.value = str();
+        font.family   = str();
+        font.style    = str();
+        font.weight   = i32();
+        font.stretch  = i32();
+        font.italic   = u8() != 0;
+        return font;
+    }
+    FontQuery
+    query() {
+        FontQuery query{};
+        if (u8()) { query.family = str(); }
+        if (u8()) { query.style = str(); }
+        if (u8()) { query.weight = i32(); }
+        if (u8()) { query.stretch = i32(); }
+        if (u8()) { query.italic = u8() != 0; }
+        query.features = strings();
+        query.scripts  = strings();
+        return query;
+    }
+    std::vector<std::string>
+    strings() {
+        const std::int32_t       count = i32();
+        std::vector<std::string> values;
+        // Every string takes at least its length prefix, larger counts cannot be satisfied by the payload
+        if (count < 0 || static_cast<std::size_t>(count) > (data_.size() - pos_) / 4) {
+            ok_ = false;
+            return values;
+        }
+        for (std::int32_t i = 0; i < count && ok_; ++i) { values.push_back(str()); }
+        return values;
+    }
+
+private:
+    void
+    raw(void *out, std::size_t size) {
+        if (! ok_ || data_.size() - pos_ < size) {
+            ok_ = false;
+            return;
+        }
+        std::memcpy(out, data_.data() + pos_, size);
+        pos_ += size;
+    }
+
+    std::span<const char> data_;
+    std::size_t           pos_ = 0;
+    bool                  ok_  = true;
+};
+
+} // namespace incfontdisc::detail::protocol
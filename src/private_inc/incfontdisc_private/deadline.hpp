@@ -0,0 +1,79 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+#include <incfontdisc_private/thread_pool.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace incfontdisc::detail {
+
+inline bool
+bounded(Deadline deadline) {
+    return deadline != Deadline::max();
+}
+
+inline bool
+expired(Deadline deadline) {
+    return bounded(deadline) && Deadline::clock::now() >= deadline;
+}
+
+inline Error
+timeout_error(const std::string &operation) {
+    return Error{ErrorCode::Timeout, operation + " did not finish before the deadline"};
+}
+
+// What becomes of work the deadline overtakes before a worker picks it up
+enum class LateWork : std::uint8_t {
+    Drop,    // never runs
+    Complete // runs anyway with its result dropped, for work whose side effects were promised
+};
+
+// Runs blocking work 'fn' on the executor and waits for it until 'deadline'. 'fn' receives the deadline and should
+// check it between steps, work already running finishes on its worker with its result dropped, so 'fn' must own what
+// it uses. Unbounded deadlines run 'fn' on the calling thread, as do calls made from a pool worker, whose task could be
+// queued behind the caller: those are bounded only by 'fn' honouring the deadline and report Timeout when it overran.
+template <typename Fn>
+auto
+run_until(Deadline deadline, const std::string &operation, Fn fn, LateWork late = LateWork::Drop)
+    -> decltype(fn(deadline)) {
+    using Result = decltype(fn(deadline));
+    if (! bounded(deadline)) { return fn(deadline); }
+    if (on_pool_thread()) {
+        if (late == LateWork::Drop && expired(deadline)) { return std::unexpected(timeout_error(operation)); }
+        auto result = fn(deadline);
+        if (result && expired(deadline)) { return std::unexpected(timeout_error(operation)); }
+        return result;
+    }
+    if (late == LateWork::Drop && expired(deadline)) { return std::unexpected(timeout_error(operation)); }
+
+    struct State {
+        std::atomic<bool>       abandoned{false};
+        std::mutex              mutex{};
+        std::condition_variable done{};
+        std::optional<Result>   result{};
+    };
+    auto state = std::make_shared<State>();
+    executor_instance().submit([state, late, deadline, fn = std::move(fn)]() mutable {
+        if (late == LateWork::Drop && state->abandoned.load()) { return; }
+        auto            result = fn(deadline);
+        std::lock_guard lock(state->mutex);
+        state->result = std::move(result);
+        state->done.notify_all();
+    });
+
+    std::unique_lock lock(state->mutex);
+    if (! state->done.wait_until(lock, deadline, [&] { return state->result.has_value(); })) {
+        state->abandoned.store(true);
+        return std::unexpected(timeout_error(operation));
+    }
+    return std::move(*state->result);
+}
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace incfontdisc::detail {
+
+// Size and modification time of a file, enough to notice that it changed without reading it
+struct FileFingerprint {
+    std::uintmax_t size  = 0;
+    std::int64_t   mtime = 0;
+    bool
+    operator==(const FileFingerprint &) const = default;
+};
+
+std::optional<FileFingerprint>
+file_fingerprint(const std::string &path);
+
+// Per-user directory for caches shared by all processes on the host, created on demand:
+// $INCFONTDISC_CACHE_DIR, else $XDG_CACHE_HOME/incfontdisc (%LOCALAPPDATA% on Windows), followed by 'name'
+std::optional<std::filesystem::path>
+cache_directory(std::string_view name);
+
+// Content hashes of font files remembered by size and mtime, lets caches recognise a file without reading it
+class FileHashes final {
+public:
+    std::optional<std::uint64_t>
+    find(const std::string &path);
+    // 'data' was read from 'path', returns its hash
+    std::uint64_t
+    remember(const std::string &path, std::span<const std::byte> data);
+
+private:
+    struct Entry {
+        FileFingerprint fingerprint{};
+        std::uint64_t   hash = 0;
+    };
+
+    std::mutex                             mutex_{};
+    std::unordered_map<std::string, Entry> entries_{};
+};
+
+FileHashes &
+file_hashes();
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace incfontdisc::detail {
+
+// Fast non-cryptographic 64-bit hash for cache keys, 8 bytes per step with a murmur style finalizer
+inline std::uint64_t
+hash_bytes(std::span<const std::byte> data, std::uint64_t seed = 0) {
+    constexpr std::uint64_t k1 = 0x9E3779B97F4A7C15ull;
+    constexpr std::uint64_t k2 = 0xC2B2AE3D27D4EB4Full;
+
+    std::uint64_t hash = seed ^ (data.size() * k1);
+    std::size_t   at   = 0;
+    for (; at + 8 <= data.size(); at += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data.data() + at, 8);
+        hash = std::rotl(hash ^ (std::rotl(word * k2, 31) * k1), 27) * k1 + k2;
+    }
+    if (at < data.size()) {
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, data.data() + at, data.size() - at);
+        hash ^= std::rotl(tail * k2, 31) * k1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+template <typename T>
+std::uint64_t
+hash_values(std::span<const T> values, std::uint64_t seed = 0) {
+    return hash_bytes(std::as_bytes(values), seed);
+}
+
+inline std::uint64_t
+hash_combine(std::uint64_t a, std::uint64_t b) {
+    return a ^ (b + 0x9E3779B97F4A7C15ull + (a << 6) + (a >> 2));
+}
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+
+namespace incfontdisc::detail {
+
+// Read-only mapping of a whole file, unmapped on destruction. Counted as MemoryCategory::MappedResident while it lives.
+class MappedFile final {
+public:
+    static std::expected<std::unique_ptr<MappedFile>, Error>
+    open(const std::string &path);
+#if ! defined(_WIN32)
+    // Maps the file behind an open descriptor, which stays owned by the caller
+    static std::expected<std::unique_ptr<MappedFile>, Error>
+    map(int fd);
+#endif
+
+    ~MappedFile();
+    MappedFile(const MappedFile &)            = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    std::span<const std::byte>
+    bytes() const {
+        return {data_, size_};
+    }
+    // Starts reading the whole file ahead and waits until every page is in memory, later reads never block on disk
+    void
+    prefetch() const;
+    // Keeps the pages in RAM until the file is unmapped, bounded by the process's locked memory limit
+    std::expected<void, Error>
+    lock() const;
+
+private:
+    MappedFile() = default;
+
+    void
+    touch_pages(std::size_t page_size) const;
+
+    const std::byte *data_ = nullptr;
+    std::size_t      size_ = 0;
+};
+
+} // namespace incfontdisc::detail
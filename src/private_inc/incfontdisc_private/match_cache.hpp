@@ -0,0 +1,49 @@
+#pragma once
+
+#include <incfontdisc_private/catalog.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace incfontdisc::detail {
+
+// Match results shared by every process of the host through a memory mapped table in the host cache directory,
+// keyed by catalog fingerprint and normalized query. Each slot is guarded by a sequence counter: readers never
+// block or write, a writer that finds its slot busy skips the insert, a slot left claimed by a writer that died is
+// taken over after a few seconds.
+class MatchCache final {
+public:
+    void
+    configure(MatchCacheOptions options);
+    // The face chosen for 'query' on this catalog by any process, checked against the catalog before it is returned
+    std::optional<FaceMatch>
+    find(const Catalog &catalog, const FontQuery &query);
+    void
+    insert(const Catalog &catalog, const FontQuery &query, const FaceMatch &match);
+
+private:
+    struct Table;
+
+    // Maps the table on first use, null when persistence is off or the file cannot be mapped. Lock-free once the
+    // table is published, the mutex only orders configure against the first open.
+    std::shared_ptr<Table>
+    table();
+
+    std::mutex                          mutex_{};
+    MatchCacheOptions                   options_{};
+    std::atomic<bool>                   opened_{false};
+    std::atomic<std::shared_ptr<Table>> table_{};
+};
+
+MatchCache &
+match_cache();
+
+// match_face_in_catalog behind the shared cache, results cut short by the deadline are not stored
+std::expected<FaceMatch, Error>
+cached_match(const Catalog &catalog, const FontQuery &query, MatchStats *stats = nullptr,
+             Deadline deadline = Deadline::max());
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace incfontdisc::detail {
+
+// Counters for memory that comes and goes at runtime (caches, mappings), the catalog accounts for itself on build
+enum class MemoryCategory : std::uint8_t {
+    AdvanceTables,
+    ByteCaches,
+    MappedResident,
+    Count
+};
+
+class MemoryCounters final {
+public:
+    void
+    add(MemoryCategory category, std::size_t bytes) {
+        slot(category).fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void
+    release(MemoryCategory category, std::size_t bytes) {
+        slot(category).fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    std::size_t
+    value(MemoryCategory category) const {
+        return counters_[static_cast<std::size_t>(category)].load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::size_t> &
+    slot(MemoryCategory category) {
+        return counters_[static_cast<std::size_t>(category)];
+    }
+
+    std::array<std::atomic<std::size_t>, static_cast<std::size_t>(MemoryCategory::Count)> counters_{};
+};
+
+MemoryCounters &
+memory_counters();
+
+// Registry of the caches that can give memory back, enforces the global budget and serves trim().
+// Caches must not hold their own lock while calling charged(), evict callbacks take it.
+class MemoryBudget final {
+public:
+    struct Cache {
+        // Lower cost is evicted first
+        int                                      cost = 0;
+        std::function<std::size_t()>             usage{};
+        // Frees at least the given number of bytes when possible, returns what was freed
+        std::function<std::size_t(std::size_t)> evict{};
+    };
+
+    std::uint64_t
+    add_cache(Cache cache);
+    void
+    remove_cache(std::uint64_t handle);
+
+    std::expected<void, Error>
+    configure(MemoryOptions options);
+    // Called by caches after they grew
+    void
+    charged();
+    std::size_t
+    trim(TrimLevel level);
+
+private:
+    std::size_t
+    trimmable_locked() const;
+    std::size_t
+    evict_locked(std::size_t bytes);
+    void
+    watch_pressure(std::stop_token stop, int fd, TrimLevel level);
+
+    std::mutex                                   mutex_{};
+    std::mutex                                   configure_mutex_{};
+    std::vector<std::pair<std::uint64_t, Cache>> caches_{};
+    std::uint64_t                                next_handle_ = 1;
+    std::atomic<std::size_t>                     budget_{0};
+    std::jthread                                 pressure_thread_{};
+};
+
+MemoryBudget &
+memory_budget();
+
+// Heap bytes owned by a string, zero while it fits in the small string buffer
+inline std::size_t
+heap_bytes(const std::string &value) {
+    const auto *self = reinterpret_cast<const char *>(&value);
+    const auto *data = value.data();
+    if (data >= self && data < self + sizeof(value)) { return 0; }
+    return value.capacity() + 1;
+}
+
+template <typename T>
+std::size_t
+heap_bytes(const std::vector<T> &value) {
+    return value.capacity() * sizeof(T);
+}
+
+// Approximation for node based hash tables: the bucket array plus one node (next pointer, cached hash, value)
+// per element, key and value heap storage is accounted for separately
+template <typename Map>
+std::size_t
+table_bytes(const Map &map) {
+    return map.bucket_count() * sizeof(void *) +
+           map.size() * (sizeof(void *) + sizeof(std::size_t) + sizeof(typename Map::value_type));
+}
+
+} // namespace incfontdisc::detail
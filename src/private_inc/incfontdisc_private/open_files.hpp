@@ -0,0 +1,43 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace incfontdisc::detail {
+
+// Font files kept open between loads, so a hot font costs an fstat and a read instead of a path lookup, an open and a
+// close. Only files of catalog faces are kept, each for one catalog generation and only while its size and write time
+// are those the catalog recorded: a file rewritten in place is read without the cache, one replaced by a rename is
+// picked up by the refresh that notices it.
+class OpenFileCache final {
+public:
+    // Reads in chunks and gives up with Timeout between two of them once 'deadline' passed
+    std::expected<ByteBuffer, Error>
+    read(const FontId &id, Deadline deadline = Deadline::max());
+
+private:
+    class File;
+
+    struct Entry {
+        std::string           path{};
+        std::uint64_t         generation = 0;
+        std::shared_ptr<File> file{};
+    };
+
+    std::mutex                                                  mutex_{};
+    // Most recently used first
+    std::list<Entry>                                            entries_{};
+    std::unordered_map<std::string, std::list<Entry>::iterator> by_path_{};
+};
+
+OpenFileCache &
+open_files();
+
+} // namespace incfontdisc::detail
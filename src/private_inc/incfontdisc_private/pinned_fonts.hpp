@@ -0,0 +1,54 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+#include <incfontdisc_private/mapped_file.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace incfontdisc::detail {
+
+// Font files kept mapped and resident on request, one mapping per file however many of its faces are pinned.
+// Pinned mappings are never trimmed.
+// Loads of a pinned file share its mapping, which outlives an unpin for as long as they hold it.
+class PinnedFonts final {
+public:
+    void
+    configure(PinOptions options);
+    // 'path' is the file of 'face', the file is read in without holding the lock
+    std::expected<void, Error>
+    pin(FontHandle face, const std::string &path);
+    std::expected<void, Error>
+    unpin(FontHandle face);
+    // The mapping of 'path' while it is pinned, null otherwise
+    std::shared_ptr<const MappedFile>
+    find(const std::string &path);
+    PinStats
+    stats();
+
+private:
+    struct File {
+        std::shared_ptr<const MappedFile> mapping{};
+        std::size_t                       faces  = 0;
+        bool                              locked = false;
+    };
+
+    std::expected<void, Error>
+    fits_locked(std::size_t bytes) const;
+
+    std::mutex                                     mutex_{};
+    PinOptions                                     options_{};
+    // Handle value -> path of its file
+    std::unordered_map<std::uint64_t, std::string> faces_{};
+    std::unordered_map<std::string, File>          files_{};
+    std::size_t                                    pinned_bytes_ = 0;
+    std::size_t                                    locked_bytes_ = 0;
+};
+
+PinnedFonts &
+pinned_fonts();
+
+} // namespace incfontdisc::detail
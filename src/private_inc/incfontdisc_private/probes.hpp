@@ -0,0 +1,38 @@
+#pragma once
+
+// USDT (sys/sdt.h) probe points under the 'incfontdisc' provider, for example:
+//   bpftrace -e 'usdt:/usr/lib/libincfontdisc.so:incfontdisc:match__end { @[str(arg1)] = count(); }'
+//
+// A probe is a single nop in the instruction stream until a tracer attaches to it.
+// Arguments are limited to integers and pointers, scores are therefore passed as per mille integers.
+//
+//   enumerate__start()
+//   enumerate__end(int face_count, int ok)
+//   match__start(const char *family)
+//   match__end(const char *family, const char *matched_family, int family_score, int face_score)
+//   cache__hit(const char *cache)
+//   cache__miss(const char *cache)
+//   load__start(const char *font_id)
+//   load__end(const char *font_id, size_t bytes)
+
+#if defined(INCFONTDISC_USDT) && __has_include(<sys/sdt.h>)
+
+#include <sys/sdt.h>
+
+#define INCFONTDISC_PROBE0(name)                   DTRACE_PROBE(incfontdisc, name)
+#define INCFONTDISC_PROBE1(name, a1)               DTRACE_PROBE1(incfontdisc, name, a1)
+#define INCFONTDISC_PROBE2(name, a1, a2)           DTRACE_PROBE2(incfontdisc, name, a1, a2)
+#define INCFONTDISC_PROBE3(name, a1, a2, a3)       DTRACE_PROBE3(incfontdisc, name, a1, a2, a3)
+#define INCFONTDISC_PROBE4(name, a1, a2, a3, a4)   DTRACE_PROBE4(incfontdisc, name, a1, a2, a3, a4)
+
+#else
+
+#define INCFONTDISC_PROBE0(name)                 ((void)0)
+#define INCFONTDISC_PROBE1(name, a1)             ((void)0)
+#define INCFONTDISC_PROBE2(name, a1, a2)         ((void)0)
+#define INCFONTDISC_PROBE3(name, a1, a2, a3)     ((void)0)
+#define INCFONTDISC_PROBE4(name, a1, a2, a3, a4) ((void)0)
+
+#endif
+
+#define INCFONTDISC_PROBE_SCORE(score) static_cast<int>((score) * 1000.0f)
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <incfontdisc_private/sfnt.hpp>
+
+#include <cstdint>
+#include <optional>
+
+// Unicode scripts known to the fallback table, enough to tell which faces cover a script without shaping anything
+
+namespace incfontdisc::detail {
+
+// The order is the bit order of script coverage masks
+enum class Script : std::uint8_t {
+    Latin,
+    Greek,
+    Cyrillic,
+    Armenian,
+    Hebrew,
+    Arabic,
+    Syriac,
+    Thaana,
+    Devanagari,
+    Bengali,
+    Gurmukhi,
+    Gujarati,
+    Oriya,
+    Tamil,
+    Telugu,
+    Kannada,
+    Malayalam,
+    Sinhala,
+    Thai,
+    Lao,
+    Tibetan,
+    Myanmar,
+    Georgian,
+    Hangul,
+    Ethiopic,
+    Cherokee,
+    CanadianAboriginal,
+    Khmer,
+    Mongolian,
+    Hiragana,
+    Katakana,
+    Han,
+    Yi,
+    Count
+};
+
+constexpr std::size_t script_count = static_cast<std::size_t>(Script::Count);
+
+// nullopt for characters shared by scripts (digits, punctuation, symbols) and for scripts not in the table
+std::optional<Script>
+script_of(char32_t codepoint);
+
+// Bit i is set when the face maps every probe character of Script(i)
+std::uint64_t
+script_coverage(const sfnt::CharMap &cmap);
+
+} // namespace incfontdisc::detail
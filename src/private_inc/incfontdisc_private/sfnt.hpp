@@ -0,0 +1,157 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Minimal read-only access to sfnt (TrueType/OpenType) data, enough for the features that need to look into font files
+
+namespace incfontdisc::detail::sfnt {
+
+constexpr std::uint32_t
+make_tag(char a, char b, char c, char d) {
+    return (static_cast<std::uint32_t>(static_cast<unsigned char>(a)) << 24) |
+           (static_cast<std::uint32_t>(static_cast<unsigned char>(b)) << 16) |
+           (static_cast<std::uint32_t>(static_cast<unsigned char>(c)) << 8) |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(d));
+}
+
+inline std::uint16_t
+read_u16(std::span<const std::byte> data, std::size_t offset) {
+    return static_cast<std::uint16_t>((std::to_integer<unsigned>(data[offset]) << 8) |
+                                      std::to_integer<unsigned>(data[offset + 1]));
+}
+
+inline std::uint32_t
+read_u32(std::span<const std::byte> data, std::size_t offset) {
+    return (static_cast<std::uint32_t>(read_u16(data, offset)) << 16) | read_u16(data, offset + 2);
+}
+
+inline void
+put_u16(ByteBuffer &out, std::uint16_t value) {
+    out.push_back(static_cast<std::byte>(value >> 8));
+    out.push_back(static_cast<std::byte>(value));
+}
+
+inline void
+put_u32(ByteBuffer &out, std::uint32_t value) {
+    put_u16(out, static_cast<std::uint16_t>(value >> 16));
+    put_u16(out, static_cast<std::uint16_t>(value));
+}
+
+inline void
+patch_u16(ByteBuffer &out, std::size_t offset, std::uint16_t value) {
+    out[offset]     = static_cast<std::byte>(value >> 8);
+    out[offset + 1] = static_cast<std::byte>(value);
+}
+
+inline void
+patch_u32(ByteBuffer &out, std::size_t offset, std::uint32_t value) {
+    patch_u16(out, offset, static_cast<std::uint16_t>(value >> 16));
+    patch_u16(out, offset + 2, static_cast<std::uint16_t>(value));
+}
+
+// OpenType table checksum, the sum of the big-endian 32-bit words with the tail zero padded
+std::uint32_t
+checksum(std::span<const std::byte> data);
+
+struct TableRecord {
+    std::uint32_t tag      = 0;
+    std::uint32_t checksum = 0;
+    std::uint32_t offset   = 0;
+    std::uint32_t length   = 0;
+};
+
+struct FontFile {
+    std::span<const std::byte> data{};
+    std::uint32_t              flavor = 0;
+    std::vector<TableRecord>   tables{};
+
+    // Empty span when the table is missing or points outside of the file
+    std::span<const std::byte>
+    table(std::uint32_t tag) const;
+    const TableRecord *
+    record(std::uint32_t tag) const;
+};
+
+// Parses the table directory of face 'face_index', collections ('ttcf') are resolved to that face
+std::expected<FontFile, Error>
+open_font(std::span<const std::byte> data, int face_index);
+
+struct TableData {
+    std::uint32_t              tag = 0;
+    std::span<const std::byte> data{};
+};
+
+// Writes a standalone sfnt with checksums and head.checkSumAdjustment filled in, 'tables' may be in any order
+ByteBuffer
+write_font(std::uint32_t flavor, std::vector<TableData> tables);
+// The face as a standalone font, used to take single faces out of collections
+ByteBuffer
+extract_face(const FontFile &font);
+
+// Script and feature tags of the GSUB and GPOS tables combined, each sorted and without duplicates
+struct LayoutTags {
+    std::vector<std::uint32_t> scripts{};
+    std::vector<std::uint32_t> features{};
+
+    bool
+    operator==(const LayoutTags &) const = default;
+};
+
+LayoutTags
+layout_tags(const FontFile &font);
+
+// From post.isFixedPitch and the OS/2 PANOSE classification, nullopt when neither tells
+std::optional<FontGenre>
+genre(const FontFile &font);
+// OS/2 usWeightClass
+std::optional<int>
+weight_class(const FontFile &font);
+
+// Unicode cmap lookup built from the best available subtable (format 12 preferred over format 4)
+class CharMap final {
+public:
+    static std::optional<CharMap>
+    from_font(const FontFile &font);
+
+    std::uint32_t
+    glyph_for(char32_t codepoint) const;
+
+    // Calls fn(codepoint, glyph) for every mapped codepoint in increasing order
+    template <typename Fn>
+    void
+    for_each(Fn &&fn) const {
+        for (const auto &group : groups_) {
+            for (std::uint32_t cp = group.first; cp <= group.last; ++cp) {
+                if (const std::uint32_t glyph = resolve(group, cp); glyph != 0) { fn(static_cast<char32_t>(cp), glyph); }
+            }
+        }
+    }
+
+private:
+    enum class GroupKind : std::uint8_t {
+        Sequential, // format 12, glyph = value + (cp - first)
+        Delta,      // format 4 without glyphIdArray, glyph = (cp + value) mod 65536
+        Array,      // format 4 with glyphIdArray, value is the subtable offset of the entry for 'first'
+    };
+
+    struct Group {
+        std::uint32_t first    = 0;
+        std::uint32_t last     = 0;
+        std::uint32_t value    = 0;
+        std::uint16_t id_delta = 0;
+        GroupKind     kind     = GroupKind::Sequential;
+    };
+
+    std::uint32_t
+    resolve(const Group &group, std::uint32_t codepoint) const;
+
+    std::span<const std::byte> subtable_{};
+    std::vector<Group>         groups_{};
+};
+
+} // namespace incfontdisc::detail::sfnt
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+namespace incfontdisc::detail {
+
+class SlowLog final {
+public:
+    bool
+    enabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    bool
+    exceeds(std::chrono::nanoseconds duration) const {
+        return duration.count() >= threshold_ns_.load(std::memory_order_relaxed);
+    }
+
+    void
+    configure(SlowLogOptions options);
+    void
+    submit(SlowOperation operation);
+    std::vector<SlowOperation>
+    drain();
+
+private:
+    std::atomic<bool>         enabled_{false};
+    std::atomic<std::int64_t> threshold_ns_{0};
+    std::mutex                mutex_{};
+    SlowLogOptions            options_{};
+    std::deque<SlowOperation> entries_{};
+};
+
+SlowLog &
+slow_log();
+
+// Measures one public call and hands it to the slow log when it took too long.
+// Does nothing beyond a relaxed load when the slow log is disabled.
+class SlowLogScope final {
+public:
+    explicit SlowLogScope(OperationKind kind)
+        : active_(slow_log().enabled()) {
+        if (active_) {
+            operation_.kind    = kind;
+            operation_.started = std::chrono::system_clock::now();
+            start_             = std::chrono::steady_clock::now();
+        }
+    }
+
+    bool
+    active() const {
+        return active_;
+    }
+    SlowOperation &
+    operation() {
+        return operation_;
+    }
+
+    template <typename T>
+    void
+    finish(const std::expected<T, Error> &result) {
+        if (! active_) { return; }
+        operation_.duration = std::chrono::steady_clock::now() - start_;
+        if (! slow_log().exceeds(operation_.duration)) { return; }
+        if (! result) { operation_.error = result.error().code; }
+        slow_log().submit(std::move(operation_));
+    }
+
+private:
+    bool                                  active_ = false;
+    std::chrono::steady_clock::time_point start_{};
+    SlowOperation                         operation_{};
+};
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+#include <incfontdisc_private/sfnt.hpp>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace incfontdisc::detail {
+
+namespace sfnt {
+
+// Glyphs needed to render 'codepoints': .notdef, the mapped glyphs and every composite component, sorted
+std::expected<std::vector<std::uint16_t>, Error>
+plan_subset(const FontFile &font, const CharMap &cmap, std::u32string_view codepoints);
+
+// Builds a font with the original's outline format (glyf or CFF) holding only 'glyphs' (renumbered in order, .notdef
+// first). The cmap keeps every codepoint of the original that maps to one of them so the result depends on the
+// glyph set alone.
+std::expected<ByteBuffer, Error>
+build_subset(const FontFile &font, const CharMap &cmap, std::span<const std::uint16_t> glyphs);
+
+} // namespace sfnt
+
+// Subset results keyed by (face content hash, glyph set hash). Hits only stat the font file: the content hash comes
+// from file_hashes() and the glyph set is remembered per codepoint set, so neither reading nor planning is repeated.
+class SubsetCache final {
+public:
+    SubsetCache();
+    ~SubsetCache();
+
+    std::optional<ByteBuffer>
+    find(const FontId &id, std::u32string_view codepoints);
+    std::expected<ByteBuffer, Error>
+    build(const FontId &id, const ByteBuffer &data, std::u32string_view codepoints);
+
+    std::size_t
+    usage() const;
+    std::size_t
+    evict(std::size_t bytes);
+
+private:
+    struct Key {
+        std::uint64_t face   = 0;
+        std::uint64_t glyphs = 0;
+        bool
+        operator==(const Key &) const = default;
+    };
+    struct KeyHash {
+        std::size_t
+        operator()(const Key &key) const;
+    };
+    struct Entry {
+        Key        key{};
+        ByteBuffer data{};
+    };
+
+    void
+    insert_locked(Key key, ByteBuffer data);
+    std::size_t
+    evict_locked(std::size_t bytes);
+
+    mutable std::mutex                                           mutex_{};
+    // (face, codepoint set hash) -> glyph set hash
+    std::unordered_map<Key, std::uint64_t, KeyHash>              glyph_sets_{};
+    std::list<Entry>                                             lru_{};
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entries_{};
+    std::size_t                                                  bytes_         = 0;
+    std::uint64_t                                                budget_handle_ = 0;
+};
+
+SubsetCache &
+subset_cache();
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace incfontdisc::detail {
+
+// Fixed size pool where every worker owns a deque.
+// Workers pop from the back of their own deque and steal from the front of the others.
+class ThreadPool final {
+public:
+    using Task = std::function<void()>;
+
+    ThreadPool(std::size_t thread_count, std::vector<int> cpu_affinity);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &)            = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void
+    submit(Task task);
+    std::size_t
+    size() const {
+        return threads_.size();
+    }
+    // True on this pool's workers, which must not destroy the pool since that joins them
+    bool
+    owns_current_thread() const;
+
+private:
+    struct Worker {
+        std::mutex       mutex{};
+        std::deque<Task> tasks{};
+    };
+
+    void
+    run(std::size_t index);
+    bool
+    try_pop(std::size_t index, Task &out);
+    bool
+    try_steal(std::size_t thief, Task &out);
+
+    std::vector<std::unique_ptr<Worker>> workers_{};
+    std::vector<std::thread>             threads_{};
+    std::mutex                           wake_mutex_{};
+    std::condition_variable              wake_{};
+    std::atomic<std::size_t>             pending_{0};
+    std::atomic<std::size_t>             next_worker_{0};
+    bool                                 stopping_ = false;
+};
+
+// The single place through which the library runs parallel work.
+// Either dispatches to the internal pool (created lazily) or to a user supplied executor.
+class Executor final {
+public:
+    void
+    configure(ExecutorOptions options);
+    void
+    submit(ThreadPool::Task task);
+    std::size_t
+    concurrency();
+
+private:
+    std::shared_ptr<ThreadPool>
+    pool_locked();
+
+    std::mutex                  mutex_{};
+    ExecutorOptions             options_{};
+    std::shared_ptr<ThreadPool> pool_{};
+};
+
+Executor &
+executor_instance();
+
+// True on the workers of the internal pool, work they wait for may be queued behind themselves
+bool
+on_pool_thread();
+
+// Runs fn(begin, end) over [0, count) split into chunks of 'grain' elements.
+// The calling thread takes part in the work, so this never deadlocks on a busy or serial executor.
+template <typename Fn>
+void
+parallel_for(std::size_t count, std::size_t grain, Fn &&fn) {
+    if (count == 0) { return; }
+    grain               = std::max<std::size_t>(grain, 1);
+    const size_t chunks = (count + grain - 1) / grain;
+
+    auto        &exec    = executor_instance();
+    const size_t helpers = std::min(chunks, exec.concurrency()) - 1;
+    if (chunks == 1 || helpers == 0) {
+        fn(std::size_t{0}, count);
+        return;
+    }
+
+    struct State {
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+        std::mutex               mutex{};
+        std::condition_variable  finished{};
+        std::exception_ptr       error{};
+    };
+    auto state = std::make_shared<State>();
+
+    // Helpers that start late find no chunk left and never touch 'fn', so capturing it by reference is safe.
+    auto work = [state, chunks, count, grain, &fn]() {
+        for (;;) {
+            const std::size_t chunk = state->next.fetch_add(1);
+            if (chunk >= chunks) { return; }
+            const std::size_t begin = chunk * grain;
+            try {
+                fn(begin, std::min(count, begin + grain));
+            }
+            catch (...) {
+                std::lock_guard lock(state->mutex);
+                if (! state->error) { state->error = std::current_exception(); }
+            }
+            if (state->done.fetch_add(1) + 1 == chunks) {
+                std::lock_guard lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    for (size_t i = 0; i < helpers; ++i) { exec.submit(work); }
+    work();
+
+    std::unique_lock lock(state->mutex);
+    state->finished.wait(lock, [&] { return state->done.load() == chunks; });
+    if (state->error) { std::rethrow_exception(state->error); }
+}
+
+} // namespace incfontdisc::detail
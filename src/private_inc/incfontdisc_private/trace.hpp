@@ -0,0 +1,73 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace incfontdisc::detail {
+
+// Trace file layout:
+//   "IFDTRACE" u32 version (2, version 1 lacks the tag lists), then records until EOF
+//   record: u8 kind, varint nanoseconds since the previous record, then
+//     Match: u8 field mask, [family] [style] [zigzag weight] [zigzag stretch] [features scripts]
+//            (italic lives in the mask, each tag list is a varint count followed by that many strings)
+//     Load:  id
+//   strings are a varint reference into the dictionary of already seen strings (index + 1),
+//   0 introduces a literal (varint length + bytes) which is appended to the dictionary while it has room
+class TraceRecorder final {
+public:
+    ~TraceRecorder();
+
+    std::expected<void, Error>
+    start(const std::string &path);
+    std::expected<void, Error>
+    stop();
+
+    void
+    record_match(const FontQuery &query) {
+        start_from_environment();
+        if (active_.load(std::memory_order_relaxed)) { write_match(query); }
+    }
+    void
+    record_load(const FontId &id) {
+        start_from_environment();
+        if (active_.load(std::memory_order_relaxed)) { write_load(id); }
+    }
+
+private:
+    void
+    start_from_environment();
+    void
+    write_match(const FontQuery &query);
+    void
+    write_load(const FontId &id);
+    void
+    begin_record_locked(TraceEventKind kind);
+    void
+    put_varint(std::uint64_t value);
+    void
+    put_string(const std::string &value);
+    void
+    flush_record_locked();
+
+    std::atomic<bool>                              active_{false};
+    std::once_flag                                 env_once_{};
+    std::mutex                                     mutex_{};
+    std::FILE                                     *file_ = nullptr;
+    std::chrono::steady_clock::time_point          last_{};
+    std::unordered_map<std::string, std::uint32_t> dictionary_{};
+    std::string                                    record_{};
+};
+
+TraceRecorder &
+trace_recorder();
+
+std::expected<std::vector<TraceEvent>, Error>
+read_trace_file(const std::string &path);
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+
+namespace incfontdisc::detail {
+
+namespace sfnt {
+
+// Checks a whole file, every face of a collection included
+std::expected<void, Error>
+validate(std::span<const std::byte> data, ValidationLevel level);
+
+} // namespace sfnt
+
+// Verdicts per file fingerprint, kept in memory and appended to a log in the host cache directory
+class ValidationCache final {
+public:
+    void
+    configure(ValidationLevel level) {
+        level_.store(level, std::memory_order_relaxed);
+    }
+    ValidationLevel
+    level() const {
+        return level_.load(std::memory_order_relaxed);
+    }
+
+    // 'data' was loaded for 'id', does nothing while validation is off
+    std::expected<void, Error>
+    check(const FontId &id, std::span<const std::byte> data);
+
+private:
+    struct Verdict {
+        std::uintmax_t  size  = 0;
+        std::int64_t    mtime = 0;
+        ValidationLevel level = ValidationLevel::None;
+        // ErrorCode + 1 of the failure, 0 when the file passed
+        std::uint8_t    status = 0;
+    };
+
+    void
+    load_locked();
+    std::optional<std::expected<void, Error>>
+    lookup_locked(std::uint64_t path, std::uintmax_t size, std::int64_t mtime, ValidationLevel level) const;
+    void
+    store_locked(std::uint64_t path, const Verdict &verdict);
+
+    std::atomic<ValidationLevel>               level_{ValidationLevel::None};
+    std::mutex                                 mutex_{};
+    bool                                       loaded_ = false;
+    std::optional<std::filesystem::path>       log_{};
+    std::unordered_map<std::uint64_t, Verdict> verdicts_{};
+};
+
+ValidationCache &
+validation_cache();
+
+} // namespace incfontdisc::detail
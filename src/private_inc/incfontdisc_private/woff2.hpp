@@ -0,0 +1,60 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace incfontdisc::detail {
+
+// False when the library was built without the WOFF2 encoder
+bool
+woff2_available();
+
+// WOFF2 output keyed by face content hash. Encoded faces are kept in memory and written to a cache directory
+// shared by all processes of the user ($INCFONTDISC_CACHE_DIR, else $XDG_CACHE_HOME/incfontdisc/woff2), so a face
+// is compressed once per host. The directory is pruned by last use once it outgrows its size limit.
+class EncodedCache final {
+public:
+    EncodedCache();
+    ~EncodedCache();
+
+    std::optional<ByteBuffer>
+    find(const FontId &id);
+    std::expected<ByteBuffer, Error>
+    encode(const FontId &id, const ByteBuffer &data);
+
+    std::size_t
+    usage() const;
+    std::size_t
+    evict(std::size_t bytes);
+
+private:
+    struct Entry {
+        std::uint64_t key = 0;
+        ByteBuffer    data{};
+    };
+
+    std::optional<ByteBuffer>
+    find_key(std::uint64_t key);
+    void
+    insert(std::uint64_t key, const ByteBuffer &data);
+    std::size_t
+    evict_locked(std::size_t bytes);
+
+    mutable std::mutex                                           mutex_{};
+    std::list<Entry>                                             lru_{};
+    std::unordered_map<std::uint64_t, std::list<Entry>::iterator> entries_{};
+    std::size_t                                                  bytes_         = 0;
+    std::optional<std::filesystem::path>                         directory_{};
+    std::uint64_t                                                budget_handle_ = 0;
+};
+
+EncodedCache &
+encoded_cache();
+
+} // namespace incfontdisc::detail
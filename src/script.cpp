@@ -0,0 +1,155 @@
+#include <incfontdisc_private/script.hpp>
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+namespace incfontdisc::detail {
+
+namespace {
+
+struct ScriptRange {
+    char32_t first;
+    char32_t last;
+    Script   script;
+};
+
+// Letters of the main blocks, sorted and disjoint. Blocks that mix scripts or hold shared characters are left out.
+constexpr ScriptRange script_ranges[] = {
+    {0x0041, 0x005A, Script::Latin},
+    {0x0061, 0x007A, Script::Latin},
+    {0x00AA, 0x00AA, Script::Latin},
+    {0x00BA, 0x00BA, Script::Latin},
+    {0x00C0, 0x00D6, Script::Latin},
+    {0x00D8, 0x00F6, Script::Latin},
+    {0x00F8, 0x02AF, Script::Latin},
+    {0x0370, 0x03FF, Script::Greek},
+    {0x0400, 0x052F, Script::Cyrillic},
+    {0x0531, 0x058F, Script::Armenian},
+    {0x0591, 0x05FF, Script::Hebrew},
+    {0x0600, 0x06FF, Script::Arabic},
+    {0x0700, 0x074F, Script::Syriac},
+    {0x0750, 0x077F, Script::Arabic},
+    {0x0780, 0x07BF, Script::Thaana},
+    {0x0900, 0x097F, Script::Devanagari},
+    {0x0980, 0x09FF, Script::Bengali},
+    {0x0A00, 0x0A7F, Script::Gurmukhi},
+    {0x0A80, 0x0AFF, Script::Gujarati},
+    {0x0B00, 0x0B7F, Script::Oriya},
+    {0x0B80, 0x0BFF, Script::Tamil},
+    {0x0C00, 0x0C7F, Script::Telugu},
+    {0x0C80, 0x0CFF, Script::Kannada},
+    {0x0D00, 0x0D7F, Script::Malayalam},
+    {0x0D80, 0x0DFF, Script::Sinhala},
+    {0x0E00, 0x0E7F, Script::Thai},
+    {0x0E80, 0x0EFF, Script::Lao},
+    {0x0F00, 0x0FFF, Script::Tibetan},
+    {0x1000, 0x109F, Script::Myanmar},
+    {0x10A0, 0x10FF, Script::Georgian},
+    {0x1100, 0x11FF, Script::Hangul},
+    {0x1200, 0x139F, Script::Ethiopic},
+    {0x13A0, 0x13FF, Script::Cherokee},
+    {0x1400, 0x167F, Script::CanadianAboriginal},
+    {0x1780, 0x17FF, Script::Khmer},
+    {0x1800, 0x18AF, Script::Mongolian},
+    {0x18B0, 0x18FF, Script::CanadianAboriginal},
+    {0x19E0, 0x19FF, Script::Khmer},
+    {0x1C80, 0x1C8F, Script::Cyrillic},
+    {0x1C90, 0x1CBF, Script::Georgian},
+    {0x1E00, 0x1EFF, Script::Latin},
+    {0x1F00, 0x1FFF, Script::Greek},
+    {0x2C60, 0x2C7F, Script::Latin},
+    {0x2D00, 0x2D2F, Script::Georgian},
+    {0x2D80, 0x2DDF, Script::Ethiopic},
+    {0x2DE0, 0x2DFF, Script::Cyrillic},
+    {0x2E80, 0x2FDF, Script::Han},
+    {0x3041, 0x309F, Script::Hiragana},
+    {0x30A1, 0x30FA, Script::Katakana},
+    {0x3131, 0x318E, Script::Hangul},
+    {0x31F0, 0x31FF, Script::Katakana},
+    {0x3400, 0x4DBF, Script::Han},
+    {0x4E00, 0x9FFF, Script::Han},
+    {0xA000, 0xA4CF, Script::Yi},
+    {0xA640, 0xA69F, Script::Cyrillic},
+    {0xA720, 0xA7FF, Script::Latin},
+    {0xA960, 0xA97F, Script::Hangul},
+    {0xAB30, 0xAB6F, Script::Latin},
+    {0xAB70, 0xABBF, Script::Cherokee},
+    {0xAC00, 0xD7FF, Script::Hangul},
+    {0xF900, 0xFAFF, Script::Han},
+    {0xFB00, 0xFB06, Script::Latin},
+    {0xFB1D, 0xFB4F, Script::Hebrew},
+    {0xFB50, 0xFDFF, Script::Arabic},
+    {0xFE70, 0xFEFC, Script::Arabic},
+    {0xFF21, 0xFF3A, Script::Latin},
+    {0xFF41, 0xFF5A, Script::Latin},
+    {0xFF66, 0xFF9D, Script::Katakana},
+    {0xFFA0, 0xFFDC, Script::Hangul},
+    {0x20000, 0x2FA1F, Script::Han},
+    {0x30000, 0x3134F, Script::Han},
+};
+
+// Common letters a face has to map to count as covering the script, indexed by Script
+constexpr std::array<std::array<char32_t, 3>, script_count> script_probes{{
+    {0x0041, 0x0061, 0x007A}, // Latin
+    {0x0391, 0x03B1, 0x03C9}, // Greek
+    {0x0410, 0x0430, 0x044F}, // Cyrillic
+    {0x0531, 0x0561, 0x0586}, // Armenian
+    {0x05D0, 0x05E9, 0x05EA}, // Hebrew
+    {0x0627, 0x0628, 0x064A}, // Arabic
+    {0x0710, 0x0712, 0x072C}, // Syriac
+    {0x0780, 0x0781, 0x0782}, // Thaana
+    {0x0915, 0x0928, 0x093F}, // Devanagari
+    {0x0995, 0x09A8, 0x09BF}, // Bengali
+    {0x0A15, 0x0A28, 0x0A3F}, // Gurmukhi
+    {0x0A95, 0x0AA8, 0x0ABF}, // Gujarati
+    {0x0B15, 0x0B28, 0x0B3F}, // Oriya
+    {0x0B95, 0x0BA8, 0x0BBF}, // Tamil
+    {0x0C15, 0x0C28, 0x0C3F}, // Telugu
+    {0x0C95, 0x0CA8, 0x0CBF}, // Kannada
+    {0x0D15, 0x0D28, 0x0D3F}, // Malayalam
+    {0x0D9A, 0x0DB1, 0x0DD2}, // Sinhala
+    {0x0E01, 0x0E19, 0x0E32}, // Thai
+    {0x0E81, 0x0E99, 0x0EB2}, // Lao
+    {0x0F40, 0x0F53, 0x0F72}, // Tibetan
+    {0x1000, 0x1014, 0x102D}, // Myanmar
+    {0x10D0, 0x10D8, 0x10F0}, // Georgian
+    {0xAC00, 0xB098, 0xD7A3}, // Hangul
+    {0x1200, 0x1208, 0x1260}, // Ethiopic
+    {0x13A0, 0x13A1, 0x13F4}, // Cherokee
+    {0x1401, 0x140A, 0x1450}, // CanadianAboriginal
+    {0x1780, 0x1793, 0x17B6}, // Khmer
+    {0x1820, 0x1828, 0x1842}, // Mongolian
+    {0x3042, 0x304B, 0x3093}, // Hiragana
+    {0x30A2, 0x30AB, 0x30F3}, // Katakana
+    {0x4E00, 0x4EBA, 0x5927}, // Han
+    {0xA000, 0xA001, 0xA48C}, // Yi
+}};
+
+static_assert(script_count <= 64, "script coverage masks are 64 bits wide");
+
+} // namespace
+
+std::optional<Script>
+script_of(char32_t codepoint) {
+    auto it = std::upper_bound(std::begin(script_ranges), std::end(script_ranges), codepoint,
+                               [](char32_t value, const ScriptRange &range) { return value < range.first; });
+    if (it == std::begin(script_ranges)) { return std::nullopt; }
+    --it;
+    if (codepoint > it->last) { return std::nullopt; }
+    return it->script;
+}
+
+std::uint64_t
+script_coverage(const sfnt::CharMap &cmap) {
+    std::uint64_t mask = 0;
+    for (std::size_t script = 0; script < script_count; ++script) {
+        const auto &probes = script_probes[script];
+        if (std::all_of(probes.begin(), probes.end(), [&](char32_t cp) { return cmap.glyph_for(cp) != 0; })) {
+            mask |= std::uint64_t{1} << script;
+        }
+    }
+    return mask;
+}
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,341 @@
+#include <incfontdisc_private/sfnt.hpp>
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define INCFONTDISC_CHECKSUM_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define INCFONTDISC_CHECKSUM_NEON
+#endif
+
+namespace incfontdisc::detail::sfnt {
+
+namespace {
+
+constexpr std::uint32_t tag_ttcf     = make_tag('t', 't', 'c', 'f');
+constexpr std::uint32_t tag_true     = make_tag('t', 'r', 'u', 'e');
+constexpr std::uint32_t tag_otto     = make_tag('O', 'T', 'T', 'O');
+constexpr std::uint32_t tag_cmap     = make_tag('c', 'm', 'a', 'p');
+constexpr std::uint32_t tag_head     = make_tag('h', 'e', 'a', 'd');
+constexpr std::uint32_t tag_gsub     = make_tag('G', 'S', 'U', 'B');
+constexpr std::uint32_t tag_gpos     = make_tag('G', 'P', 'O', 'S');
+constexpr std::uint32_t tag_os2      = make_tag('O', 'S', '/', '2');
+constexpr std::uint32_t tag_post     = make_tag('p', 'o', 's', 't');
+constexpr std::uint32_t sfnt_version = 0x00010000;
+constexpr std::uint32_t max_unicode  = 0x10FFFF;
+// head.checkSumAdjustment makes the whole file sum up to this value
+constexpr std::uint32_t checksum_magic = 0xB1B0AFBA;
+
+bool
+in_bounds(std::span<const std::byte> data, std::size_t offset, std::size_t size) {
+    return offset <= data.size() && size <= data.size() - offset;
+}
+
+// Appends the tags of a ScriptList or FeatureList, both are a count followed by (tag, offset16) records
+void
+append_list_tags(std::span<const std::byte> table, std::size_t list_offset, std::vector<std::uint32_t> &out) {
+    if (list_offset == 0 || ! in_bounds(table, list_offset, 2)) { return; }
+    const std::size_t count = read_u16(table, list_offset);
+    if (! in_bounds(table, list_offset + 2, count * 6)) { return; }
+    for (std::size_t i = 0; i < count; ++i) { out.push_back(read_u32(table, list_offset + 2 + i * 6)); }
+}
+
+void
+sort_unique(std::vector<std::uint32_t> &tags) {
+    std::sort(tags.begin(), tags.end());
+    tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+    tags.shrink_to_fit();
+}
+
+} // namespace
+
+// Adds big-endian words four (SSE2/NEON) at a time, the remainder goes through the scalar loop
+std::uint32_t
+checksum(std::span<const std::byte> data) {
+    std::uint32_t sum = 0;
+    std::size_t   at  = 0;
+#if defined(INCFONTDISC_CHECKSUM_SSE2)
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data.data());
+    __m128i     acc_a = _mm_setzero_si128();
+    __m128i     acc_b = _mm_setzero_si128();
+    // SSE2 has no byte shuffle: swap the bytes of each 16-bit half, then swap the halves of each 32-bit lane
+    const auto  swap  = [](__m128i value) {
+        value = _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+        return _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, 0xB1), 0xB1);
+    };
+    for (; at + 32 <= data.size(); at += 32) {
+        acc_a = _mm_add_epi32(acc_a, swap(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + at))));
+        acc_b = _mm_add_epi32(acc_b, swap(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + at + 16))));
+    }
+    alignas(16) std::uint32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), _mm_add_epi32(acc_a, acc_b));
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(INCFONTDISC_CHECKSUM_NEON)
+    const auto *bytes = reinterpret_cast<const std::uint8_t *>(data.data());
+    uint32x4_t  acc_a = vdupq_n_u32(0);
+    uint32x4_t  acc_b = vdupq_n_u32(0);
+    for (; at + 32 <= data.size(); at += 32) {
+        acc_a = vaddq_u32(acc_a, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(bytes + at))));
+        acc_b = vaddq_u32(acc_b, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(bytes + at + 16))));
+    }
+    const uint32x4_t acc = vaddq_u32(acc_a, acc_b);
+    sum = vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) + vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+#endif
+    for (; at + 4 <= data.size(); at += 4) { sum += read_u32(data, at); }
+    std::uint32_t tail = 0;
+    for (std::size_t shift = 24; at < data.size(); ++at, shift -= 8) {
+        tail |= std::to_integer<std::uint32_t>(data[at]) << shift;
+    }
+    return sum + tail;
+}
+
+std::span<const std::byte>
+FontFile::table(std::uint32_t tag) const {
+    const auto *found = record(tag);
+    if (! found || ! in_bounds(data, found->offset, found->length)) { return {}; }
+    return data.subspan(found->offset, found->length);
+}
+
+const TableRecord *
+FontFile::record(std::uint32_t tag) const {
+    auto it = std::lower_bound(tables.begin(), tables.end(), tag,
+                               [](const TableRecord &rec, std::uint32_t value) { return rec.tag < value; });
+    if (it == tables.end() || it->tag != tag) { return nullptr; }
+    return &*it;
+}
+
+std::expected<FontFile, Error>
+open_font(std::span<const std::byte> data, int face_index) {
+    if (! in_bounds(data, 0, 12)) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Font data too short"}); }
+
+    std::size_t directory = 0;
+    if (read_u32(data, 0) == tag_ttcf) {
+        const std::uint32_t count = read_u32(data, 8);
+        if (face_index < 0 || static_cast<std::uint32_t>(face_index) >= count ||
+            ! in_bounds(data, 12 + static_cast<std::size_t>(face_index) * 4, 4)) {
+            return std::unexpected(Error{ErrorCode::InvalidArgument, "Face index outside of the font collection"});
+        }
+        directory = read_u32(data, 12 + static_cast<std::size_t>(face_index) * 4);
+    }
+    if (! in_bounds(data, directory, 12)) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Truncated sfnt header"});
+    }
+
+    FontFile font{.data = data, .flavor = read_u32(data, directory)};
+    if (font.flavor != sfnt_version && font.flavor != tag_true && font.flavor != tag_otto) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Not an sfnt font"});
+    }
+
+    const std::uint16_t num_tables = read_u16(data, directory + 4);
+    if (! in_bounds(data, directory + 12, static_cast<std::size_t>(num_tables) * 16)) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Truncated sfnt table directory"});
+    }
+    font.tables.reserve(num_tables);
+    for (std::uint16_t i = 0; i < num_tables; ++i) {
+        const std::size_t entry = directory + 12 + static_cast<std::size_t>(i) * 16;
+        font.tables.push_back(TableRecord{.tag      = read_u32(data, entry),
+                                          .checksum = read_u32(data, entry + 4),
+                                          .offset   = read_u32(data, entry + 8),
+                                          .length   = read_u32(data, entry + 12)});
+    }
+    // The spec requires sorted directories but real files do not always comply
+    std::sort(font.tables.begin(), font.tables.end(),
+              [](const TableRecord &a, const TableRecord &b) { return a.tag < b.tag; });
+    return font;
+}
+
+ByteBuffer
+write_font(std::uint32_t flavor, std::vector<TableData> tables) {
+    std::sort(tables.begin(), tables.end(), [](const TableData &a, const TableData &b) { return a.tag < b.tag; });
+
+    const auto    count          = static_cast<std::uint16_t>(tables.size());
+    std::uint16_t entry_selector = 0;
+    while ((2u << entry_selector) <= count) { ++entry_selector; }
+    // Without tables there is nothing to search, a nonzero searchRange would make rangeShift underflow
+    const auto search_range = static_cast<std::uint16_t>(count == 0 ? 0 : 16u << entry_selector);
+
+    ByteBuffer out;
+    put_u32(out, flavor);
+    put_u16(out, count);
+    put_u16(out, search_range);
+    put_u16(out, entry_selector);
+    put_u16(out, static_cast<std::uint16_t>(count * 16 - search_range));
+    const std::size_t directory = out.size();
+    out.resize(directory + tables.size() * 16);
+
+    std::optional<std::size_t> head_offset;
+    for (std::size_t i = 0; i < tables.size(); ++i) {
+        const auto &[tag, data] = tables[i];
+        const std::size_t offset = out.size();
+        out.insert(out.end(), data.begin(), data.end());
+        // The head checksum is taken with checkSumAdjustment set to zero
+        if (tag == tag_head && data.size() >= 12) {
+            head_offset = offset;
+            patch_u32(out, offset + 8, 0);
+        }
+        while (out.size() % 4 != 0) { out.push_back(std::byte{0}); }
+
+        const std::size_t record = directory + i * 16;
+        patch_u32(out, record, tag);
+        patch_u32(out, record + 4, checksum(std::span<const std::byte>(out).subspan(offset, data.size())));
+        patch_u32(out, record + 8, static_cast<std::uint32_t>(offset));
+        patch_u32(out, record + 12, static_cast<std::uint32_t>(data.size()));
+    }
+    if (head_offset) { patch_u32(out, *head_offset + 8, checksum_magic - checksum(out)); }
+    return out;
+}
+
+ByteBuffer
+extract_face(const FontFile &font) {
+    std::vector<TableData> tables;
+    tables.reserve(font.tables.size());
+    for (const auto &record : font.tables) {
+        if (in_bounds(font.data, record.offset, record.length)) {
+            tables.push_back(TableData{record.tag, font.data.subspan(record.offset, record.length)});
+        }
+    }
+    return write_font(font.flavor, std::move(tables));
+}
+
+LayoutTags
+layout_tags(const FontFile &font) {
+    LayoutTags tags{};
+    for (const auto tag : {tag_gsub, tag_gpos}) {
+        const auto table = font.table(tag);
+        if (table.size() < 10) { continue; }
+        append_list_tags(table, read_u16(table, 4), tags.scripts);
+        append_list_tags(table, read_u16(table, 6), tags.features);
+    }
+    sort_unique(tags.scripts);
+    sort_unique(tags.features);
+    return tags;
+}
+
+std::optional<FontGenre>
+genre(const FontFile &font) {
+    if (const auto post = font.table(tag_post); in_bounds(post, 12, 4) && read_u32(post, 12) != 0) {
+        return FontGenre::Mono;
+    }
+    // PANOSE starts at offset 32 of OS/2, only the Latin Text kind (2) classifies serifs
+    const auto os2 = font.table(tag_os2);
+    if (! in_bounds(os2, 32, 10) || std::to_integer<int>(os2[32]) != 2) { return std::nullopt; }
+    if (std::to_integer<int>(os2[35]) == 9) { return FontGenre::Mono; }
+    const int serif = std::to_integer<int>(os2[33]);
+    if (serif >= 2 && serif <= 10) { return FontGenre::Serif; }
+    if (serif >= 11 && serif <= 15) { return FontGenre::Sans; }
+    return std::nullopt;
+}
+
+std::optional<int>
+weight_class(const FontFile &font) {
+    const auto os2 = font.table(tag_os2);
+    if (! in_bounds(os2, 4, 2)) { return std::nullopt; }
+    return read_u16(os2, 4);
+}
+
+std::optional<CharMap>
+CharMap::from_font(const FontFile &font) {
+    const auto cmap = font.table(tag_cmap);
+    if (! in_bounds(cmap, 0, 4)) { return std::nullopt; }
+
+    // Rank the Unicode subtables, full repertoire (format 12) wins over BMP only (format 4)
+    std::size_t best_offset = 0;
+    int         best_rank   = 0;
+    const auto  count       = read_u16(cmap, 2);
+    for (std::uint16_t i = 0; i < count; ++i) {
+        const std::size_t entry = 4 + static_cast<std::size_t>(i) * 8;
+        if (! in_bounds(cmap, entry, 8)) { break; }
+        const auto        platform = read_u16(cmap, entry);
+        const auto        encoding = read_u16(cmap, entry + 2);
+        const std::size_t offset   = read_u32(cmap, entry + 4);
+        if (! in_bounds(cmap, offset, 2)) { continue; }
+
+        const bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+        if (! unicode) { continue; }
+        const auto format = read_u16(cmap, offset);
+        const int  rank   = (format == 12) ? 2 : (format == 4) ? 1 : 0;
+        if (rank > best_rank) {
+            best_rank   = rank;
+            best_offset = offset;
+        }
+    }
+    if (best_rank == 0) { return std::nullopt; }
+
+    CharMap map;
+    if (best_rank == 2) {
+        if (! in_bounds(cmap, best_offset, 16)) { return std::nullopt; }
+        const std::size_t length = read_u32(cmap, best_offset + 4);
+        if (! in_bounds(cmap, best_offset, length)) { return std::nullopt; }
+        map.subtable_           = cmap.subspan(best_offset, length);
+        const std::uint32_t num = read_u32(map.subtable_, 12);
+        if (! in_bounds(map.subtable_, 16, static_cast<std::size_t>(num) * 12)) { return std::nullopt; }
+        for (std::uint32_t i = 0; i < num; ++i) {
+            const std::size_t   entry = 16 + static_cast<std::size_t>(i) * 12;
+            const std::uint32_t first = read_u32(map.subtable_, entry);
+            const std::uint32_t last  = std::min(read_u32(map.subtable_, entry + 4), max_unicode);
+            if (first > last) { continue; }
+            map.groups_.push_back(Group{.first = first, .last = last, .value = read_u32(map.subtable_, entry + 8)});
+        }
+    }
+    else {
+        if (! in_bounds(cmap, best_offset, 14)) { return std::nullopt; }
+        const std::size_t length = read_u16(cmap, best_offset + 2);
+        if (! in_bounds(cmap, best_offset, length)) { return std::nullopt; }
+        map.subtable_             = cmap.subspan(best_offset, length);
+        const std::size_t seg_x2  = read_u16(map.subtable_, 6);
+        const std::size_t ends    = 14;
+        const std::size_t starts  = ends + seg_x2 + 2;
+        const std::size_t deltas  = starts + seg_x2;
+        const std::size_t offsets = deltas + seg_x2;
+        if (! in_bounds(map.subtable_, offsets, seg_x2)) { return std::nullopt; }
+        for (std::size_t seg = 0; seg < seg_x2; seg += 2) {
+            const std::uint32_t first        = read_u16(map.subtable_, starts + seg);
+            const std::uint32_t last         = read_u16(map.subtable_, ends + seg);
+            const std::uint16_t delta        = read_u16(map.subtable_, deltas + seg);
+            const std::uint16_t range_offset = read_u16(map.subtable_, offsets + seg);
+            if (first > last || first == 0xFFFF) { continue; }
+            if (range_offset == 0) {
+                map.groups_.push_back(Group{.first = first, .last = last, .id_delta = delta, .kind = GroupKind::Delta});
+            }
+            else {
+                map.groups_.push_back(Group{.first    = first,
+                                            .last     = last,
+                                            .value    = static_cast<std::uint32_t>(offsets + seg + range_offset),
+                                            .id_delta = delta,
+                                            .kind     = GroupKind::Array});
+            }
+        }
+    }
+    std::sort(map.groups_.begin(), map.groups_.end(), [](const Group &a, const Group &b) { return a.first < b.first; });
+    return map;
+}
+
+std::uint32_t
+CharMap::resolve(const Group &group, std::uint32_t codepoint) const {
+    switch (group.kind) {
+        case GroupKind::Sequential: return group.value + (codepoint - group.first);
+        case GroupKind::Delta:      return (codepoint + group.id_delta) & 0xFFFFu;
+        case GroupKind::Array:      {
+            const std::size_t at = group.value + static_cast<std::size_t>(codepoint - group.first) * 2;
+            if (! in_bounds(subtable_, at, 2)) { return 0; }
+            const std::uint16_t glyph = read_u16(subtable_, at);
+            return glyph == 0 ? 0 : (glyph + group.id_delta) & 0xFFFFu;
+        }
+    }
+    return 0;
+}
+
+std::uint32_t
+CharMap::glyph_for(char32_t codepoint) const {
+    const auto cp = static_cast<std::uint32_t>(codepoint);
+    auto       it = std::upper_bound(groups_.begin(), groups_.end(), cp,
+                                     [](std::uint32_t value, const Group &group) { return value < group.first; });
+    if (it == groups_.begin()) { return 0; }
+    --it;
+    if (cp > it->last) { return 0; }
+    return resolve(*it, cp);
+}
+
+} // namespace incfontdisc::detail::sfnt
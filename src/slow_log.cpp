@@ -0,0 +1,43 @@
+#include <incfontdisc_private/slow_log.hpp>
+
+namespace incfontdisc::detail {
+
+void
+SlowLog::configure(SlowLogOptions options) {
+    std::lock_guard lock(mutex_);
+    options_ = std::move(options);
+    while (entries_.size() > options_.capacity) { entries_.pop_front(); }
+    threshold_ns_.store(options_.threshold.count(), std::memory_order_relaxed);
+    enabled_.store(options_.enabled, std::memory_order_relaxed);
+}
+
+void
+SlowLog::submit(SlowOperation operation) {
+    std::function<void(const SlowOperation &)> callback;
+    {
+        std::lock_guard lock(mutex_);
+        callback = options_.callback;
+        if (options_.capacity > 0) {
+            if (entries_.size() == options_.capacity) { entries_.pop_front(); }
+            entries_.push_back(operation);
+        }
+    }
+    if (callback) { callback(operation); }
+}
+
+std::vector<SlowOperation>
+SlowLog::drain() {
+    std::lock_guard            lock(mutex_);
+    std::vector<SlowOperation> drained(std::make_move_iterator(entries_.begin()),
+                                       std::make_move_iterator(entries_.end()));
+    entries_.clear();
+    return drained;
+}
+
+SlowLog &
+slow_log() {
+    static SlowLog log{};
+    return log;
+}
+
+} // namespace incfontdisc::detail
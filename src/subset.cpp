@@ -0,0 +1,907 @@
+#include <incfontdisc_private/catalog.hpp>
+#include <incfontdisc_private/file_hash.hpp>
+#include <incfontdisc_private/hash.hpp>
+#include <incfontdisc_private/memory.hpp>
+#include <incfontdisc_private/subset.hpp>
+
+#include <algorithm>
+#include <map>
+#include <optional>
+
+namespace incfontdisc::detail {
+
+namespace sfnt {
+
+namespace {
+
+constexpr std::uint32_t tag_cff  = make_tag('C', 'F', 'F', ' ');
+constexpr std::uint32_t tag_cff2 = make_tag('C', 'F', 'F', '2');
+constexpr std::uint32_t tag_cmap = make_tag('c', 'm', 'a', 'p');
+constexpr std::uint32_t tag_cvt  = make_tag('c', 'v', 't', ' ');
+constexpr std::uint32_t tag_fpgm = make_tag('f', 'p', 'g', 'm');
+constexpr std::uint32_t tag_gasp = make_tag('g', 'a', 's', 'p');
+constexpr std::uint32_t tag_glyf = make_tag('g', 'l', 'y', 'f');
+constexpr std::uint32_t tag_head = make_tag('h', 'e', 'a', 'd');
+constexpr std::uint32_t tag_hhea = make_tag('h', 'h', 'e', 'a');
+constexpr std::uint32_t tag_hmtx = make_tag('h', 'm', 't', 'x');
+constexpr std::uint32_t tag_loca = make_tag('l', 'o', 'c', 'a');
+constexpr std::uint32_t tag_maxp = make_tag('m', 'a', 'x', 'p');
+constexpr std::uint32_t tag_name = make_tag('n', 'a', 'm', 'e');
+constexpr std::uint32_t tag_os2  = make_tag('O', 'S', '/', '2');
+constexpr std::uint32_t tag_post = make_tag('p', 'o', 's', 't');
+constexpr std::uint32_t tag_prep = make_tag('p', 'r', 'e', 'p');
+
+constexpr std::uint32_t flavor_truetype = 0x00010000;
+constexpr std::uint32_t flavor_cff      = make_tag('O', 'T', 'T', 'O');
+
+// Composite glyph flags
+constexpr std::uint16_t arg_words       = 0x0001;
+constexpr std::uint16_t have_scale      = 0x0008;
+constexpr std::uint16_t more_components = 0x0020;
+constexpr std::uint16_t have_xy_scale   = 0x0040;
+constexpr std::uint16_t have_2x2        = 0x0080;
+
+ByteBuffer
+copy_table(std::span<const std::byte> table) {
+    return ByteBuffer(table.begin(), table.end());
+}
+
+// Glyph outlines addressed through loca
+class GlyphTable final {
+public:
+    static std::expected<GlyphTable, Error>
+    from_font(const FontFile &font) {
+        const auto head = font.table(tag_head);
+        const auto maxp = font.table(tag_maxp);
+        GlyphTable table;
+        table.glyf_ = font.table(tag_glyf);
+        table.loca_ = font.table(tag_loca);
+        if (head.size() < 54 || maxp.size() < 6 || table.glyf_.empty() || table.loca_.empty()) {
+            return std::unexpected(Error{ErrorCode::InvalidArgument, "Font lacks the head, maxp, loca or glyf table"});
+        }
+        table.long_offsets_ = read_u16(head, 50) != 0;
+        table.num_glyphs_   = read_u16(maxp, 4);
+        const std::size_t entry = table.long_offsets_ ? 4 : 2;
+        if (table.loca_.size() < (static_cast<std::size_t>(table.num_glyphs_) + 1) * entry) {
+            return std::unexpected(Error{ErrorCode::InvalidArgument, "Truncated loca table"});
+        }
+        return table;
+    }
+
+    std::uint16_t
+    num_glyphs() const {
+        return num_glyphs_;
+    }
+
+    // Empty for glyphs without outline (space) and for entries pointing outside of glyf
+    std::span<const std::byte>
+    glyph(std::uint16_t id) const {
+        const std::size_t begin = offset(id);
+        const std::size_t end   = offset(id + 1);
+        if (begin >= end || end > glyf_.size()) { return {}; }
+        return glyf_.subspan(begin, end - begin);
+    }
+
+private:
+    std::size_t
+    offset(std::size_t id) const {
+        return long_offsets_ ? read_u32(loca_, id * 4) : static_cast<std::size_t>(read_u16(loca_, id * 2)) * 2;
+    }
+
+    std::span<const std::byte> glyf_{};
+    std::span<const std::byte> loca_{};
+    bool                       long_offsets_ = false;
+    std::uint16_t              num_glyphs_   = 0;
+};
+
+// Calls fn(offset of the glyph index field) for every component of a composite glyph
+template <typename Fn>
+void
+for_each_component(std::span<const std::byte> glyph, Fn &&fn) {
+    if (glyph.size() < 10 || static_cast<std::int16_t>(read_u16(glyph, 0)) >= 0) { return; }
+    std::size_t   at    = 10;
+    std::uint16_t flags = 0;
+    do {
+        if (at + 4 > glyph.size()) { return; }
+        flags = read_u16(glyph, at);
+        fn(at + 2);
+        at += 4 + ((flags & arg_words) ? 4 : 2);
+        if (flags & have_scale) { at += 2; }
+        else if (flags & have_xy_scale) { at += 4; }
+        else if (flags & have_2x2) { at += 8; }
+    } while (flags & more_components);
+}
+
+// CFF DICT operators the subset rewrites, escaped operators are 1200 + their second byte
+constexpr std::uint16_t cff_charset       = 15;
+constexpr std::uint16_t cff_encoding      = 16;
+constexpr std::uint16_t cff_char_strings  = 17;
+constexpr std::uint16_t cff_private       = 18;
+constexpr std::uint16_t cff_subrs         = 19;
+constexpr std::uint16_t cff_ros           = 1230;
+constexpr std::uint16_t cff_fd_array      = 1236;
+constexpr std::uint16_t cff_fd_select     = 1237;
+constexpr std::uint16_t cff_escape        = 12;
+constexpr std::uint8_t  cff_int32_operand = 29;
+
+Error
+malformed_cff(const std::string &what) {
+    return Error{ErrorCode::InvalidArgument, "Malformed CFF table: " + what};
+}
+
+// CFF INDEX: count, offset size, count + 1 offsets (1-based) and the object data
+class CffIndex final {
+public:
+    static std::optional<CffIndex>
+    parse(std::span<const std::byte> data, std::size_t at) {
+        CffIndex index;
+        index.data_  = data;
+        index.begin_ = at;
+        if (at + 2 > data.size()) { return std::nullopt; }
+        const std::size_t count = read_u16(data, at);
+        if (count == 0) {
+            index.end_ = at + 2;
+            return index;
+        }
+        if (at + 3 > data.size()) { return std::nullopt; }
+        const std::size_t offset_size = std::to_integer<std::size_t>(data[at + 2]);
+        const std::size_t offsets     = at + 3;
+        if (offset_size < 1 || offset_size > 4 || offsets + (count + 1) * offset_size > data.size()) {
+            return std::nullopt;
+        }
+        auto read_offset = [&](std::size_t i) {
+            std::size_t value = 0;
+            for (std::size_t b = 0; b < offset_size; ++b) {
+                value = (value << 8) | std::to_integer<std::size_t>(data[offsets + i * offset_size + b]);
+            }
+            return value;
+        };
+        // Offsets count from the byte before the object data
+        const std::size_t base     = offsets + (count + 1) * offset_size - 1;
+        std::size_t       previous = read_offset(0);
+        if (previous != 1) { return std::nullopt; }
+        index.objects_.reserve(count);
+        for (std::size_t i = 1; i <= count; ++i) {
+            const std::size_t next = read_offset(i);
+            if (next < previous || base + next > data.size()) { return std::nullopt; }
+            index.objects_.push_back(data.subspan(base + previous, next - previous));
+            previous = next;
+        }
+        index.end_ = base + previous;
+        return index;
+    }
+
+    std::size_t
+    size() const {
+        return objects_.size();
+    }
+    std::span<const std::byte>
+    operator[](std::size_t i) const {
+        return objects_[i];
+    }
+    std::size_t
+    end() const {
+        return end_;
+    }
+    // The INDEX as it is stored, for copying it unchanged
+    std::span<const std::byte>
+    raw() const {
+        return data_.subspan(begin_, end_ - begin_);
+    }
+
+private:
+    std::span<const std::byte>              data_{};
+    std::vector<std::span<const std::byte>> objects_{};
+    std::size_t                             begin_ = 0;
+    std::size_t                             end_   = 0;
+};
+
+void
+write_cff_index(ByteBuffer &out, const std::vector<std::span<const std::byte>> &objects) {
+    put_u16(out, static_cast<std::uint16_t>(objects.size()));
+    if (objects.empty()) { return; }
+    std::size_t last = 1;
+    for (const auto &object : objects) { last += object.size(); }
+    const std::size_t offset_size = last <= 0xFF ? 1 : last <= 0xFFFF ? 2 : last <= 0xFFFFFF ? 3 : 4;
+    out.push_back(static_cast<std::byte>(offset_size));
+    auto put_offset = [&](std::size_t value) {
+        for (std::size_t b = offset_size; b-- > 0;) { out.push_back(static_cast<std::byte>(value >> (b * 8))); }
+    };
+    std::size_t offset = 1;
+    put_offset(offset);
+    for (const auto &object : objects) {
+        offset += object.size();
+        put_offset(offset);
+    }
+    for (const auto &object : objects) { out.insert(out.end(), object.begin(), object.end()); }
+}
+
+// One DICT entry, the operands are kept as stored and their integer values decoded (reals count as 0)
+struct CffEntry {
+    std::uint16_t              op = 0;
+    std::span<const std::byte> operands{};
+    std::vector<std::int32_t>  values{};
+};
+
+std::optional<std::vector<CffEntry>>
+parse_cff_dict(std::span<const std::byte> dict) {
+    std::vector<CffEntry>     entries;
+    std::vector<std::int32_t> values;
+    std::size_t               start = 0;
+    std::size_t               at    = 0;
+    auto                      byte  = [&](std::size_t i) { return std::to_integer<std::int32_t>(dict[i]); };
+    while (at < dict.size()) {
+        const std::int32_t b0 = byte(at);
+        if (b0 <= 21) {
+            const std::size_t operands = at;
+            std::uint16_t     op       = static_cast<std::uint16_t>(b0);
+            if (b0 == cff_escape) {
+                if (at + 1 >= dict.size()) { return std::nullopt; }
+                op = static_cast<std::uint16_t>(1200 + byte(at + 1));
+                ++at;
+            }
+            ++at;
+            entries.push_back(CffEntry{op, dict.subspan(start, operands - start), std::move(values)});
+            values.clear();
+            start = at;
+        }
+        else if (b0 == 28 && at + 3 <= dict.size()) {
+            values.push_back(static_cast<std::int16_t>(read_u16(dict, at + 1)));
+            at += 3;
+        }
+        else if (b0 == cff_int32_operand && at + 5 <= dict.size()) {
+            values.push_back(static_cast<std::int32_t>(read_u32(dict, at + 1)));
+            at += 5;
+        }
+        else if (b0 == 30) {
+            // A real runs until the nibble 0xf
+            for (++at;; ++at) {
+                if (at >= dict.size()) { return std::nullopt; }
+                if ((byte(at) & 0x0F) == 0x0F || (byte(at) >> 4) == 0x0F) { break; }
+            }
+            ++at;
+            values.push_back(0);
+        }
+        else if (b0 >= 32 && b0 <= 246) {
+            values.push_back(b0 - 139);
+            at += 1;
+        }
+        else if (b0 >= 247 && b0 <= 250 && at + 2 <= dict.size()) {
+            values.push_back((b0 - 247) * 256 + byte(at + 1) + 108);
+            at += 2;
+        }
+        else if (b0 >= 251 && b0 <= 254 && at + 2 <= dict.size()) {
+            values.push_back(-(b0 - 251) * 256 - byte(at + 1) - 108);
+            at += 2;
+        }
+        else { return std::nullopt; }
+    }
+    return entries;
+}
+
+const CffEntry *
+find_entry(const std::vector<CffEntry> &entries, std::uint16_t op, std::size_t values) {
+    for (const auto &entry : entries) {
+        if (entry.op == op) { return entry.values.size() >= values ? &entry : nullptr; }
+    }
+    return nullptr;
+}
+
+// Operators listed in 'offsets' are written with those values as 5 byte integers, so the size of the DICT does not
+// depend on where the data it points at ends up
+ByteBuffer
+write_cff_dict(const std::vector<CffEntry>                                &entries,
+               const std::map<std::uint16_t, std::vector<std::int32_t>> &offsets) {
+    ByteBuffer out;
+    for (const auto &entry : entries) {
+        if (auto replaced = offsets.find(entry.op); replaced != offsets.end()) {
+            for (const auto value : replaced->second) {
+                out.push_back(std::byte{cff_int32_operand});
+                put_u32(out, static_cast<std::uint32_t>(value));
+            }
+        }
+        else { out.insert(out.end(), entry.operands.begin(), entry.operands.end()); }
+        if (entry.op >= 1200) {
+            out.push_back(std::byte{cff_escape});
+            out.push_back(static_cast<std::byte>(entry.op - 1200));
+        }
+        else { out.push_back(static_cast<std::byte>(entry.op)); }
+    }
+    return out;
+}
+
+// A Private DICT followed by its local Subrs, which the DICT then points at
+struct CffPrivate {
+    ByteBuffer   data;
+    std::int32_t dict_size; // the Top/Font DICT records only the DICT, not the Subrs after it
+};
+
+std::expected<CffPrivate, Error>
+copy_private(std::span<const std::byte> cff, const CffEntry &reference) {
+    const auto size   = static_cast<std::size_t>(reference.values[0]);
+    const auto offset = static_cast<std::size_t>(reference.values[1]);
+    if (reference.values[0] < 0 || reference.values[1] < 0 || offset > cff.size() || size > cff.size() - offset) {
+        return std::unexpected(malformed_cff("Private DICT out of bounds"));
+    }
+    auto entries = parse_cff_dict(cff.subspan(offset, size));
+    if (! entries) { return std::unexpected(malformed_cff("Private DICT")); }
+    const auto *subrs = find_entry(*entries, cff_subrs, 1);
+    if (! subrs) {
+        auto out = write_cff_dict(*entries, {});
+        return CffPrivate{out, static_cast<std::int32_t>(out.size())};
+    }
+
+    const auto local = CffIndex::parse(cff, offset + static_cast<std::size_t>(subrs->values[0]));
+    if (subrs->values[0] < 0 || ! local) { return std::unexpected(malformed_cff("local Subrs")); }
+    const auto dict_size = write_cff_dict(*entries, {{cff_subrs, {0}}}).size();
+    auto       out       = write_cff_dict(*entries, {{cff_subrs, {static_cast<std::int32_t>(dict_size)}}});
+    out.insert(out.end(), local->raw().begin(), local->raw().end());
+    return CffPrivate{std::move(out), static_cast<std::int32_t>(dict_size)};
+}
+
+// The SID (CID for CID-keyed fonts) of every glyph
+std::expected<std::vector<std::uint16_t>, Error>
+read_charset(std::span<const std::byte> cff, const std::vector<CffEntry> &top, std::size_t glyphs) {
+    std::vector<std::uint16_t> ids(glyphs, 0);
+    const auto                *charset = find_entry(top, cff_charset, 1);
+    if (! charset || charset->values[0] == 0) {
+        // ISOAdobe, glyph i has SID i
+        for (std::size_t i = 0; i < glyphs; ++i) { ids[i] = static_cast<std::uint16_t>(i); }
+        return ids;
+    }
+    if (charset->values[0] <= 2) {
+        return std::unexpected(
+            Error{ErrorCode::NotImplemented, "Subsetting CFF with an Expert charset is not supported"});
+    }
+    std::size_t at = static_cast<std::size_t>(charset->values[0]);
+    if (at >= cff.size()) { return std::unexpected(malformed_cff("charset out of bounds")); }
+    const auto format = std::to_integer<unsigned>(cff[at++]);
+    for (std::size_t glyph = 1; glyph < glyphs;) {
+        if (format == 0) {
+            if (at + 2 > cff.size()) { return std::unexpected(malformed_cff("truncated charset")); }
+            ids[glyph++] = read_u16(cff, at);
+            at += 2;
+            continue;
+        }
+        const std::size_t range = format == 1 ? 3 : 4;
+        if ((format != 1 && format != 2) || at + range > cff.size()) {
+            return std::unexpected(malformed_cff("charset"));
+        }
+        const std::size_t first = read_u16(cff, at);
+        const std::size_t left  = format == 1 ? std::to_integer<std::size_t>(cff[at + 2]) : read_u16(cff, at + 2);
+        at += range;
+        for (std::size_t i = 0; i <= left && glyph < glyphs; ++i) {
+            ids[glyph++] = static_cast<std::uint16_t>(first + i);
+        }
+    }
+    return ids;
+}
+
+// The Font DICT of every glyph of a CID-keyed font
+std::expected<std::vector<std::uint8_t>, Error>
+read_fd_select(std::span<const std::byte> cff, std::size_t at, std::size_t glyphs) {
+    std::vector<std::uint8_t> fds(glyphs, 0);
+    if (at >= cff.size()) { return std::unexpected(malformed_cff("FDSelect out of bounds")); }
+    const auto format = std::to_integer<unsigned>(cff[at++]);
+    if (format == 0) {
+        if (at + glyphs > cff.size()) { return std::unexpected(malformed_cff("truncated FDSelect")); }
+        for (std::size_t i = 0; i < glyphs; ++i) { fds[i] = std::to_integer<std::uint8_t>(cff[at + i]); }
+        return fds;
+    }
+    if (format != 3 || at + 2 > cff.size()) { return std::unexpected(malformed_cff("FDSelect")); }
+    const std::size_t ranges = read_u16(cff, at);
+    at += 2;
+    if (at + ranges * 3 + 2 > cff.size()) { return std::unexpected(malformed_cff("truncated FDSelect")); }
+    for (std::size_t r = 0; r < ranges; ++r) {
+        const std::size_t first = read_u16(cff, at + r * 3);
+        const std::size_t last  = read_u16(cff, at + r * 3 + 3); // the next range or the sentinel
+        const auto        fd    = std::to_integer<std::uint8_t>(cff[at + r * 3 + 2]);
+        for (std::size_t glyph = first; glyph < last && glyph < glyphs; ++glyph) { fds[glyph] = fd; }
+    }
+    return fds;
+}
+
+// CFF table holding only 'glyphs' (renumbered in order, .notdef first). Subroutines are kept whole, so every kept
+// charstring still finds the subroutines it calls. seac accent composites are not followed.
+std::expected<ByteBuffer, Error>
+subset_cff(std::span<const std::byte> cff, std::span<const std::uint16_t> glyphs) {
+    if (cff.size() < 4 || std::to_integer<unsigned>(cff[0]) != 1) {
+        return std::unexpected(malformed_cff("unsupported header"));
+    }
+    const auto names = CffIndex::parse(cff, std::to_integer<std::size_t>(cff[2]));
+    const auto tops  = names ? CffIndex::parse(cff, names->end()) : std::nullopt;
+    const auto strs  = tops ? CffIndex::parse(cff, tops->end()) : std::nullopt;
+    const auto gsubr = strs ? CffIndex::parse(cff, strs->end()) : std::nullopt;
+    if (! gsubr || tops->size() != 1) { return std::unexpected(malformed_cff("header INDEXes")); }
+    auto top = parse_cff_dict((*tops)[0]);
+    if (! top) { return std::unexpected(malformed_cff("Top DICT")); }
+
+    const auto *char_strings_entry = find_entry(*top, cff_char_strings, 1);
+    const auto  char_strings =
+        char_strings_entry && char_strings_entry->values[0] > 0
+            ? CffIndex::parse(cff, static_cast<std::size_t>(char_strings_entry->values[0]))
+            : std::nullopt;
+    if (! char_strings) { return std::unexpected(malformed_cff("CharStrings")); }
+    for (const auto glyph : glyphs) {
+        if (glyph >= char_strings->size()) { return std::unexpected(malformed_cff("glyph outside of CharStrings")); }
+    }
+    auto ids = read_charset(cff, *top, char_strings->size());
+    if (! ids) { return std::unexpected(ids.error()); }
+
+    ByteBuffer charset{std::byte{0}};
+    for (const auto glyph : glyphs.subspan(1)) { put_u16(charset, (*ids)[glyph]); }
+    std::vector<std::span<const std::byte>> kept;
+    kept.reserve(glyphs.size());
+    for (const auto glyph : glyphs) { kept.push_back((*char_strings)[glyph]); }
+
+    // CID-keyed fonts carry one Private DICT per Font DICT, the others a single one
+    const bool                         cid = find_entry(*top, cff_ros, 3) != nullptr;
+    ByteBuffer                         fd_select;
+    std::vector<std::vector<CffEntry>> font_dicts;
+    std::vector<CffPrivate>            privates;
+    if (cid) {
+        const auto *fd_array_entry  = find_entry(*top, cff_fd_array, 1);
+        const auto *fd_select_entry = find_entry(*top, cff_fd_select, 1);
+        const auto  fd_array        = fd_array_entry && fd_array_entry->values[0] > 0
+                                          ? CffIndex::parse(cff, static_cast<std::size_t>(fd_array_entry->values[0]))
+                                          : std::nullopt;
+        if (! fd_array || ! fd_select_entry || fd_select_entry->values[0] <= 0) {
+            return std::unexpected(malformed_cff("FDArray or FDSelect"));
+        }
+        auto fds = read_fd_select(cff, static_cast<std::size_t>(fd_select_entry->values[0]), char_strings->size());
+        if (! fds) { return std::unexpected(fds.error()); }
+        fd_select.push_back(std::byte{0});
+        for (const auto glyph : glyphs) {
+            if ((*fds)[glyph] >= fd_array->size()) { return std::unexpected(malformed_cff("FDSelect")); }
+            fd_select.push_back(static_cast<std::byte>((*fds)[glyph]));
+        }
+        for (std::size_t i = 0; i < fd_array->size(); ++i) {
+            auto dict = parse_cff_dict((*fd_array)[i]);
+            if (! dict) { return std::unexpected(malformed_cff("Font DICT")); }
+            const auto *reference = find_entry(*dict, cff_private, 2);
+            if (! reference) { return std::unexpected(malformed_cff("Font DICT without Private")); }
+            auto copied = copy_private(cff, *reference);
+            if (! copied) { return std::unexpected(copied.error()); }
+            privates.push_back(std::move(*copied));
+            font_dicts.push_back(std::move(*dict));
+        }
+    }
+    else {
+        const auto *reference = find_entry(*top, cff_private, 2);
+        if (! reference) { return std::unexpected(malformed_cff("Top DICT without Private")); }
+        auto copied = copy_private(cff, *reference);
+        if (! copied) { return std::unexpected(copied.error()); }
+        privates.push_back(std::move(*copied));
+    }
+    // The cmap maps characters inside an OpenType font, a custom Encoding would point at glyphs that are gone. A
+    // CID-keyed font reads its Private DICTs from the FDArray, a stray Top DICT one would point into the old layout
+    std::erase_if(*top, [&](const CffEntry &entry) {
+        return entry.op == cff_encoding || (cid && entry.op == cff_private);
+    });
+
+    // Every offset is written with a fixed size, so laying out with placeholder offsets tells where things go and a
+    // second pass fills them in
+    struct Layout {
+        std::int32_t              charset      = 0;
+        std::int32_t              fd_select    = 0;
+        std::int32_t              char_strings = 0;
+        std::int32_t              fd_array     = 0;
+        std::vector<std::int32_t> privates{};
+
+        bool
+        operator==(const Layout &) const = default;
+    };
+    auto write = [&](const Layout &offsets, Layout &placed) {
+        placed.privates.resize(privates.size());
+        auto size_of = [&](std::size_t i) { return privates[i].dict_size; };
+
+        std::map<std::uint16_t, std::vector<std::int32_t>> top_offsets{{cff_charset, {offsets.charset}},
+                                                                      {cff_char_strings, {offsets.char_strings}}};
+        if (cid) {
+            top_offsets[cff_fd_array]  = {offsets.fd_array};
+            top_offsets[cff_fd_select] = {offsets.fd_select};
+        }
+        else { top_offsets[cff_private] = {size_of(0), offsets.privates[0]}; }
+        const auto top_dict = write_cff_dict(*top, top_offsets);
+
+        ByteBuffer out{std::byte{1}, std::byte{0}, std::byte{4}, std::byte{4}};
+        out.insert(out.end(), names->raw().begin(), names->raw().end());
+        write_cff_index(out, {std::span<const std::byte>(top_dict)});
+        out.insert(out.end(), strs->raw().begin(), strs->raw().end());
+        out.insert(out.end(), gsubr->raw().begin(), gsubr->raw().end());
+        placed.charset = static_cast<std::int32_t>(out.size());
+        out.insert(out.end(), charset.begin(), charset.end());
+        if (cid) {
+            placed.fd_select = static_cast<std::int32_t>(out.size());
+            out.insert(out.end(), fd_select.begin(), fd_select.end());
+        }
+        placed.char_strings = static_cast<std::int32_t>(out.size());
+        write_cff_index(out, kept);
+        if (cid) {
+            std::vector<ByteBuffer> dicts;
+            for (std::size_t i = 0; i < font_dicts.size(); ++i) {
+                dicts.push_back(write_cff_dict(font_dicts[i], {{cff_private, {size_of(i), offsets.privates[i]}}}));
+            }
+            placed.fd_array = static_cast<std::int32_t>(out.size());
+            write_cff_index(out, std::vector<std::span<const std::byte>>(dicts.begin(), dicts.end()));
+        }
+        for (std::size_t i = 0; i < privates.size(); ++i) {
+            placed.privates[i] = static_cast<std::int32_t>(out.size());
+            out.insert(out.end(), privates[i].data.begin(), privates[i].data.end());
+        }
+        return out;
+    };
+    Layout placed{}, confirmed{};
+    write(Layout{.privates = std::vector<std::int32_t>(privates.size(), 0)}, placed);
+    auto out = write(placed, confirmed);
+    if (confirmed != placed) { return std::unexpected(malformed_cff("layout did not settle")); }
+    return out;
+}
+
+ByteBuffer
+build_cmap(const std::vector<std::pair<std::uint32_t, std::uint16_t>> &mappings) {
+    // One group per run of consecutive codepoints mapping to consecutive glyphs
+    struct Run {
+        std::uint32_t first = 0;
+        std::uint32_t last  = 0;
+        std::uint16_t glyph = 0;
+    };
+    std::vector<Run> runs;
+    for (const auto &[cp, glyph] : mappings) {
+        if (! runs.empty() && runs.back().last + 1 == cp &&
+            runs.back().glyph + (cp - runs.back().first) == glyph) {
+            runs.back().last = cp;
+        }
+        else { runs.push_back(Run{cp, cp, glyph}); }
+    }
+
+    // Format 4 for the BMP when it fits, format 12 for supplementary planes
+    std::vector<Run> bmp;
+    bool             supplementary = false;
+    for (auto run : runs) {
+        if (run.first > 0xFFFF) {
+            supplementary = true;
+            continue;
+        }
+        if (run.last > 0xFFFE) {
+            supplementary = true;
+            run.last      = 0xFFFE;
+        }
+        bmp.push_back(run);
+    }
+    const std::size_t segments    = bmp.size() + 1;
+    const bool        with_format4 = 16 + segments * 8 <= 0xFFFF;
+    const bool        with_format12 = supplementary || ! with_format4;
+
+    ByteBuffer out;
+    put_u16(out, 0);
+    put_u16(out, static_cast<std::uint16_t>(with_format4 + with_format12));
+    const std::size_t records = out.size();
+    if (with_format4) {
+        put_u16(out, 3);
+        put_u16(out, 1);
+        put_u32(out, 0);
+    }
+    if (with_format12) {
+        put_u16(out, 3);
+        put_u16(out, 10);
+        put_u32(out, 0);
+    }
+
+    if (with_format4) {
+        patch_u32(out, records + 4, static_cast<std::uint32_t>(out.size()));
+        std::uint16_t entry_selector = 0;
+        while ((std::size_t{2} << entry_selector) <= segments) { ++entry_selector; }
+        const auto search_range = static_cast<std::uint16_t>(std::size_t{1} << (entry_selector + 1));
+        put_u16(out, 4);
+        put_u16(out, static_cast<std::uint16_t>(16 + segments * 8));
+        put_u16(out, 0);
+        put_u16(out, static_cast<std::uint16_t>(segments * 2));
+        put_u16(out, search_range);
+        put_u16(out, entry_selector);
+        put_u16(out, static_cast<std::uint16_t>(segments * 2 - search_range));
+        for (const auto &run : bmp) { put_u16(out, static_cast<std::uint16_t>(run.last)); }
+        put_u16(out, 0xFFFF);
+        put_u16(out, 0);
+        for (const auto &run : bmp) { put_u16(out, static_cast<std::uint16_t>(run.first)); }
+        put_u16(out, 0xFFFF);
+        for (const auto &run : bmp) { put_u16(out, static_cast<std::uint16_t>(run.glyph - run.first)); }
+        put_u16(out, 1);
+        for (std::size_t i = 0; i < segments; ++i) { put_u16(out, 0); }
+    }
+    if (with_format12) {
+        patch_u32(out, records + (with_format4 ? 12 : 4), static_cast<std::uint32_t>(out.size()));
+        put_u16(out, 12);
+        put_u16(out, 0);
+        put_u32(out, static_cast<std::uint32_t>(16 + runs.size() * 12));
+        put_u32(out, 0);
+        put_u32(out, static_cast<std::uint32_t>(runs.size()));
+        for (const auto &run : runs) {
+            put_u32(out, run.first);
+            put_u32(out, run.last);
+            put_u32(out, run.glyph);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+std::expected<std::vector<std::uint16_t>, Error>
+plan_subset(const FontFile &font, const CharMap &cmap, std::u32string_view codepoints) {
+    if (! font.table(tag_cff2).empty()) {
+        return std::unexpected(Error{ErrorCode::NotImplemented, "Subsetting CFF2 outlines is not supported"});
+    }
+    // CFF glyphs have no components to follow, TrueType composites pull in the glyphs they are built from
+    std::optional<GlyphTable> outlines;
+    std::size_t               num_glyphs = 0;
+    if (font.table(tag_cff).empty()) {
+        auto table = GlyphTable::from_font(font);
+        if (! table) { return std::unexpected(table.error()); }
+        num_glyphs = table->num_glyphs();
+        outlines   = std::move(*table);
+    }
+    else if (const auto maxp = font.table(tag_maxp); maxp.size() >= 6) { num_glyphs = read_u16(maxp, 4); }
+    if (num_glyphs == 0) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Font has no glyphs"}); }
+
+    std::vector<bool>          keep(num_glyphs, false);
+    std::vector<std::uint16_t> pending{0};
+    for (char32_t cp : codepoints) {
+        const auto glyph = cmap.glyph_for(cp);
+        if (glyph != 0 && glyph < num_glyphs) { pending.push_back(static_cast<std::uint16_t>(glyph)); }
+    }
+    while (! pending.empty()) {
+        const auto glyph = pending.back();
+        pending.pop_back();
+        if (glyph >= keep.size() || keep[glyph]) { continue; }
+        keep[glyph] = true;
+        if (! outlines) { continue; }
+        const auto outline = outlines->glyph(glyph);
+        for_each_component(outline, [&](std::size_t at) { pending.push_back(read_u16(outline, at)); });
+    }
+
+    std::vector<std::uint16_t> planned;
+    for (std::size_t glyph = 0; glyph < keep.size(); ++glyph) {
+        if (keep[glyph]) { planned.push_back(static_cast<std::uint16_t>(glyph)); }
+    }
+    return planned;
+}
+
+std::expected<ByteBuffer, Error>
+build_subset(const FontFile &font, const CharMap &cmap, std::span<const std::uint16_t> glyphs) {
+    if (glyphs.empty() || glyphs.front() != 0) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "A subset needs at least the .notdef glyph"});
+    }
+    const auto cff  = font.table(tag_cff);
+    const auto maxp = font.table(tag_maxp);
+    if (maxp.size() < 6) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Font lacks the maxp table"}); }
+    const auto hhea = font.table(tag_hhea);
+    const auto hmtx = font.table(tag_hmtx);
+    if (hhea.size() < 36) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Font lacks the hhea table"}); }
+    const std::size_t metrics = read_u16(hhea, 34);
+    if (metrics == 0 || hmtx.size() < metrics * 4) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Truncated hmtx table"});
+    }
+
+    std::vector<std::int32_t> new_id(read_u16(maxp, 4), -1);
+    for (std::size_t i = 0; i < glyphs.size(); ++i) {
+        if (glyphs[i] >= new_id.size()) {
+            return std::unexpected(Error{ErrorCode::InvalidArgument, "Glyph outside of the font"});
+        }
+        new_id[glyphs[i]] = static_cast<std::int32_t>(i);
+    }
+
+    std::vector<std::pair<std::uint32_t, ByteBuffer>> tables;
+    if (! cff.empty()) {
+        auto outlines = subset_cff(cff, glyphs);
+        if (! outlines) { return std::unexpected(outlines.error()); }
+        tables.emplace_back(tag_cff, std::move(*outlines));
+    }
+    else {
+        auto outlines = GlyphTable::from_font(font);
+        if (! outlines) { return std::unexpected(outlines.error()); }
+        // glyf and loca, component references are rewritten to the new glyph ids
+        ByteBuffer glyf, loca;
+        for (const auto glyph : glyphs) {
+            put_u32(loca, static_cast<std::uint32_t>(glyf.size()));
+            const auto outline = outlines->glyph(glyph);
+            const auto start   = glyf.size();
+            glyf.insert(glyf.end(), outline.begin(), outline.end());
+            for_each_component(outline, [&](std::size_t at) {
+                const auto component = read_u16(outline, at);
+                patch_u16(glyf, start + at,
+                          static_cast<std::uint16_t>(
+                              component < new_id.size() && new_id[component] >= 0 ? new_id[component] : 0));
+            });
+            while (glyf.size() % 4 != 0) { glyf.push_back(std::byte{0}); }
+        }
+        put_u32(loca, static_cast<std::uint32_t>(glyf.size()));
+        tables.emplace_back(tag_glyf, std::move(glyf));
+        tables.emplace_back(tag_loca, std::move(loca));
+    }
+
+    ByteBuffer metrics_out;
+    for (const auto glyph : glyphs) {
+        const std::size_t advance_at = std::min<std::size_t>(glyph, metrics - 1) * 4;
+        const std::size_t lsb_at     = glyph < metrics ? glyph * 4 + 2 : metrics * 4 + (glyph - metrics) * 2;
+        put_u16(metrics_out, read_u16(hmtx, advance_at));
+        put_u16(metrics_out, lsb_at + 2 <= hmtx.size() ? read_u16(hmtx, lsb_at) : 0);
+    }
+
+    std::vector<std::pair<std::uint32_t, std::uint16_t>> mappings;
+    cmap.for_each([&](char32_t cp, std::uint32_t glyph) {
+        if (glyph < new_id.size() && new_id[glyph] > 0) {
+            mappings.emplace_back(static_cast<std::uint32_t>(cp), static_cast<std::uint16_t>(new_id[glyph]));
+        }
+    });
+
+    tables.emplace_back(tag_cmap, build_cmap(mappings));
+    tables.emplace_back(tag_hmtx, std::move(metrics_out));
+
+    auto head = copy_table(font.table(tag_head));
+    if (cff.empty()) { patch_u16(head, 50, 1); }
+    tables.emplace_back(tag_head, std::move(head));
+
+    auto hhea_out = copy_table(hhea);
+    patch_u16(hhea_out, 34, static_cast<std::uint16_t>(glyphs.size()));
+    tables.emplace_back(tag_hhea, std::move(hhea_out));
+
+    auto maxp_out = copy_table(maxp);
+    patch_u16(maxp_out, 4, static_cast<std::uint16_t>(glyphs.size()));
+    tables.emplace_back(tag_maxp, std::move(maxp_out));
+
+    // post without glyph names
+    if (const auto post = font.table(tag_post); post.size() >= 32) {
+        auto post_out = copy_table(post.first(32));
+        patch_u32(post_out, 0, 0x00030000);
+        tables.emplace_back(tag_post, std::move(post_out));
+    }
+    if (const auto os2 = font.table(tag_os2); os2.size() >= 68) {
+        auto os2_out = copy_table(os2);
+        if (! mappings.empty()) {
+            patch_u16(os2_out, 64, static_cast<std::uint16_t>(std::min<std::uint32_t>(mappings.front().first, 0xFFFF)));
+            patch_u16(os2_out, 66, static_cast<std::uint16_t>(std::min<std::uint32_t>(mappings.back().first, 0xFFFF)));
+        }
+        tables.emplace_back(tag_os2, std::move(os2_out));
+    }
+    // Hinting programs are referenced from the glyph instructions and copied as they are
+    for (const auto tag : {tag_name, tag_cvt, tag_fpgm, tag_prep, tag_gasp}) {
+        if (! cff.empty() && tag != tag_name) { continue; }
+        if (const auto table = font.table(tag); ! table.empty()) { tables.emplace_back(tag, copy_table(table)); }
+    }
+    std::vector<TableData> directory;
+    directory.reserve(tables.size());
+    for (const auto &[tag, data] : tables) { directory.push_back(TableData{tag, data}); }
+    return write_font(cff.empty() ? flavor_truetype : flavor_cff, std::move(directory));
+}
+
+} // namespace sfnt
+
+namespace {
+
+// Maximum size of the cache when no global memory budget is configured
+constexpr std::size_t default_capacity   = 64u << 20;
+constexpr std::size_t max_glyph_sets     = 4096;
+constexpr int         subset_evict_cost  = 1;
+
+std::uint64_t
+codepoints_hash(std::u32string_view codepoints) {
+    std::u32string sorted(codepoints);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    return hash_values(std::span<const char32_t>(sorted));
+}
+
+} // namespace
+
+std::size_t
+SubsetCache::KeyHash::operator()(const Key &key) const {
+    return static_cast<std::size_t>(hash_combine(key.face, key.glyphs));
+}
+
+SubsetCache::SubsetCache() {
+    budget_handle_ = memory_budget().add_cache(MemoryBudget::Cache{
+        .cost  = subset_evict_cost,
+        .usage = [this] { return usage(); },
+        .evict = [this](std::size_t bytes) { return evict(bytes); },
+    });
+}
+
+SubsetCache::~SubsetCache() {
+    memory_budget().remove_cache(budget_handle_);
+}
+
+std::optional<ByteBuffer>
+SubsetCache::find(const FontId &id, std::u32string_view codepoints) {
+    const auto [path, face_index] = split_font_id(id);
+    const auto content            = file_hashes().find(path);
+    if (! content) { return std::nullopt; }
+    const auto face = hash_combine(*content, static_cast<std::uint64_t>(face_index));
+
+    std::lock_guard lock(mutex_);
+    auto            set = glyph_sets_.find(Key{face, codepoints_hash(codepoints)});
+    if (set == glyph_sets_.end()) { return std::nullopt; }
+    auto entry = entries_.find(Key{face, set->second});
+    if (entry == entries_.end()) { return std::nullopt; }
+    lru_.splice(lru_.begin(), lru_, entry->second);
+    return entry->second->data;
+}
+
+std::expected<ByteBuffer, Error>
+SubsetCache::build(const FontId &id, const ByteBuffer &data, std::u32string_view codepoints) {
+    const auto [path, face_index] = split_font_id(id);
+    const auto content            = file_hashes().remember(path, data);
+    const auto face               = hash_combine(content, static_cast<std::uint64_t>(face_index));
+
+    auto font = sfnt::open_font(data, face_index);
+    if (! font) { return std::unexpected(font.error()); }
+    auto cmap = sfnt::CharMap::from_font(*font);
+    if (! cmap) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Font has no usable Unicode cmap"}); }
+    auto glyphs = sfnt::plan_subset(*font, *cmap, codepoints);
+    if (! glyphs) { return std::unexpected(glyphs.error()); }
+    const Key key{face, hash_values(std::span<const std::uint16_t>(*glyphs))};
+
+    {
+        std::lock_guard lock(mutex_);
+        if (glyph_sets_.size() >= max_glyph_sets) { glyph_sets_.clear(); }
+        glyph_sets_[Key{face, codepoints_hash(codepoints)}] = key.glyphs;
+        if (auto entry = entries_.find(key); entry != entries_.end()) {
+            lru_.splice(lru_.begin(), lru_, entry->second);
+            return entry->second->data;
+        }
+    }
+
+    auto subset = sfnt::build_subset(*font, *cmap, *glyphs);
+    if (! subset) { return std::unexpected(subset.error()); }
+    {
+        std::lock_guard lock(mutex_);
+        insert_locked(key, *subset);
+    }
+    memory_budget().charged();
+    return subset;
+}
+
+void
+SubsetCache::insert_locked(Key key, ByteBuffer data) {
+    if (entries_.contains(key) || data.size() > default_capacity) { return; }
+    bytes_ += data.size();
+    memory_counters().add(MemoryCategory::ByteCaches, data.size());
+    lru_.push_front(Entry{key, std::move(data)});
+    entries_.emplace(key, lru_.begin());
+
+    if (bytes_ > default_capacity) { evict_locked(bytes_ - default_capacity); }
+}
+
+std::size_t
+SubsetCache::usage() const {
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
+
+std::size_t
+SubsetCache::evict(std::size_t bytes) {
+    std::lock_guard lock(mutex_);
+    return evict_locked(bytes);
+}
+
+std::size_t
+SubsetCache::evict_locked(std::size_t bytes) {
+    std::size_t freed = 0;
+    while (freed < bytes && ! lru_.empty()) {
+        const auto &oldest = lru_.back();
+        freed             += oldest.data.size();
+        entries_.erase(oldest.key);
+        lru_.pop_back();
+    }
+    bytes_ -= freed;
+    memory_counters().release(MemoryCategory::ByteCaches, freed);
+    return freed;
+}
+
+SubsetCache &
+subset_cache() {
+    static SubsetCache cache{};
+    return cache;
+}
+
+} // namespace incfontdisc::detail
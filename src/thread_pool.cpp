@@ -0,0 +1,193 @@
+#include <incfontdisc_private/thread_pool.hpp>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace incfontdisc::detail {
+
+namespace {
+
+thread_local const ThreadPool *tl_pool         = nullptr;
+thread_local std::size_t       tl_worker_index = 0;
+
+void
+pin_current_thread(int cpu) {
+    if (cpu < 0) { return; }
+#if defined(_WIN32)
+    if (cpu < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << cpu);
+    }
+#elif defined(__linux__)
+    if (cpu < CPU_SETSIZE) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#endif
+}
+
+std::size_t
+default_thread_count() {
+    const unsigned hw = std::thread::hardware_concurrency();
+    return hw == 0 ? std::size_t{1} : static_cast<std::size_t>(hw);
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t thread_count, std::vector<int> cpu_affinity) {
+    if (thread_count == 0) { thread_count = default_thread_count(); }
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) { workers_.push_back(std::make_unique<Worker>()); }
+
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        const int cpu = cpu_affinity.empty() ? -1 : cpu_affinity[i % cpu_affinity.size()];
+        threads_.emplace_back([this, i, cpu] {
+            pin_current_thread(cpu);
+            run(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_) {
+        if (thread.joinable()) { thread.join(); }
+    }
+}
+
+bool
+ThreadPool::owns_current_thread() const {
+    return tl_pool == this;
+}
+
+void
+ThreadPool::submit(Task task) {
+    // Work submitted from inside a worker stays local to it, everything else is spread round-robin
+    const std::size_t target =
+        (tl_pool == this) ? tl_worker_index : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    {
+        std::lock_guard lock(wake_mutex_);
+        pending_.fetch_add(1, std::memory_order_release);
+    }
+    {
+        std::lock_guard lock(workers_[target]->mutex);
+        workers_[target]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+bool
+ThreadPool::try_pop(std::size_t index, Task &out) {
+    auto           &worker = *workers_[index];
+    std::lock_guard lock(worker.mutex);
+    if (worker.tasks.empty()) { return false; }
+    out = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool
+ThreadPool::try_steal(std::size_t thief, Task &out) {
+    const std::size_t count = workers_.size();
+    for (size_t offset = 1; offset < count; ++offset) {
+        auto           &victim = *workers_[(thief + offset) % count];
+        std::lock_guard lock(victim.mutex);
+        if (victim.tasks.empty()) { continue; }
+        out = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void
+ThreadPool::run(std::size_t index) {
+    tl_pool         = this;
+    tl_worker_index = index;
+
+    for (;;) {
+        Task task;
+        if (try_pop(index, task) || try_steal(index, task)) {
+            pending_.fetch_sub(1, std::memory_order_acq_rel);
+            task();
+            continue;
+        }
+
+        std::unique_lock lock(wake_mutex_);
+        // Pending work is always drained before stopping so that nobody waits on a task that never runs
+        wake_.wait(lock, [this] { return stopping_ || pending_.load(std::memory_order_acquire) > 0; });
+        if (stopping_ && pending_.load(std::memory_order_acquire) == 0) { return; }
+    }
+}
+
+void
+Executor::configure(ExecutorOptions options) {
+    std::shared_ptr<ThreadPool> retired;
+    {
+        std::lock_guard lock(mutex_);
+        options_ = std::move(options);
+        retired  = std::move(pool_);
+    }
+    // Joining happens outside the lock, queued work of the old pool still completes
+    retired.reset();
+}
+
+std::shared_ptr<ThreadPool>
+Executor::pool_locked() {
+    if (! pool_) {
+        // The last reference can go away on one of the pool's own workers (a task that reconfigures the executor or
+        // outlives a configure), the pool is then torn down on a thread of its own instead of joining itself
+        pool_ = std::shared_ptr<ThreadPool>(new ThreadPool(options_.thread_count, options_.cpu_affinity),
+                                            [](ThreadPool *pool) {
+                                                if (pool->owns_current_thread()) {
+                                                    std::thread([pool] { delete pool; }).detach();
+                                                }
+                                                else { delete pool; }
+                                            });
+    }
+    return pool_;
+}
+
+void
+Executor::submit(ThreadPool::Task task) {
+    std::shared_ptr<ThreadPool>                 pool;
+    std::function<void(std::function<void()>)> custom;
+    {
+        std::lock_guard lock(mutex_);
+        if (options_.executor) { custom = options_.executor; }
+        else { pool = pool_locked(); }
+    }
+    if (custom) { custom(std::move(task)); }
+    else { pool->submit(std::move(task)); }
+}
+
+std::size_t
+Executor::concurrency() {
+    std::lock_guard lock(mutex_);
+    if (options_.thread_count != 0) { return options_.thread_count; }
+    if (options_.executor) { return default_thread_count(); }
+    return pool_locked()->size();
+}
+
+Executor &
+executor_instance() {
+    static Executor executor{};
+    return executor;
+}
+
+bool
+on_pool_thread() {
+    return tl_pool != nullptr;
+}
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,283 @@
+#include <incfontdisc_private/trace.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+
+namespace incfontdisc::detail {
+
+namespace {
+
+constexpr char          trace_magic[8]     = {'I', 'F', 'D', 'T', 'R', 'A', 'C', 'E'};
+// Version 2 added the layout tag lists, version 1 files are still read
+constexpr std::uint32_t trace_version      = 2;
+constexpr std::size_t   max_dictionary     = 1u << 16;
+constexpr std::size_t   record_buffer_size = 1u << 16;
+
+enum MatchField : std::uint8_t {
+    HasFamily  = 1u << 0,
+    HasStyle   = 1u << 1,
+    HasWeight  = 1u << 2,
+    HasStretch = 1u << 3,
+    HasItalic  = 1u << 4,
+    IsItalic   = 1u << 5,
+    HasLayout  = 1u << 6, // feature and script tag lists follow the other fields
+};
+
+std::uint64_t
+zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t
+unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+// Reads from a buffer the caller keeps alive
+class TraceReader final {
+public:
+    explicit TraceReader(std::string_view data) : data_(data) {}
+
+    bool
+    at_end() const {
+        return pos_ >= data_.size();
+    }
+    bool
+    raw(void *out, std::size_t size) {
+        if (data_.size() - pos_ < size) { return false; }
+        std::memcpy(out, data_.data() + pos_, size);
+        pos_ += size;
+        return true;
+    }
+    bool
+    varint(std::uint64_t &out) {
+        out = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos_ >= data_.size()) { return false; }
+            const auto byte  = static_cast<unsigned char>(data_[pos_++]);
+            out             |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) { return true; }
+        }
+        return false;
+    }
+    bool
+    string(std::string &out) {
+        std::uint64_t ref = 0;
+        if (! varint(ref)) { return false; }
+        if (ref != 0) {
+            if (ref > dictionary_.size()) { return false; }
+            out = dictionary_[ref - 1];
+            return true;
+        }
+        std::uint64_t size = 0;
+        if (! varint(size) || data_.size() - pos_ < size) { return false; }
+        out.assign(data_.data() + pos_, static_cast<std::size_t>(size));
+        pos_ += static_cast<std::size_t>(size);
+        if (dictionary_.size() < max_dictionary) { dictionary_.push_back(out); }
+        return true;
+    }
+
+private:
+    std::string_view         data_;
+    std::size_t              pos_ = 0;
+    std::vector<std::string> dictionary_{};
+};
+
+} // namespace
+
+TraceRecorder::~TraceRecorder() {
+    if (file_) { std::fclose(file_); }
+}
+
+void
+TraceRecorder::start_from_environment() {
+    std::call_once(env_once_, [this] {
+        const char *path = std::getenv("INCFONTDISC_TRACE");
+        if (path && *path && ! active_.load()) { (void)start(path); }
+    });
+}
+
+std::expected<void, Error>
+TraceRecorder::start(const std::string &path) {
+    std::lock_guard lock(mutex_);
+    if (file_) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Trace recording is already running"}); }
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (! file_) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to create trace file " + path}); }
+    std::setvbuf(file_, nullptr, _IOFBF, record_buffer_size);
+    std::fwrite(trace_magic, 1, sizeof(trace_magic), file_);
+    std::fwrite(&trace_version, sizeof(trace_version), 1, file_);
+
+    dictionary_.clear();
+    last_ = std::chrono::steady_clock::now();
+    active_.store(true, std::memory_order_relaxed);
+    return {};
+}
+
+std::expected<void, Error>
+TraceRecorder::stop() {
+    std::lock_guard lock(mutex_);
+    if (! file_) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Trace recording is not running"}); }
+    active_.store(false, std::memory_order_relaxed);
+    const bool ok = std::fclose(file_) == 0;
+    file_         = nullptr;
+    if (! ok) { return std::unexpected(Error{ErrorCode::SystemError, "Failed to finish trace file"}); }
+    return {};
+}
+
+void
+TraceRecorder::put_varint(std::uint64_t value) {
+    while (value >= 0x80) {
+        record_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    record_.push_back(static_cast<char>(value));
+}
+
+void
+TraceRecorder::put_string(const std::string &value) {
+    if (auto it = dictionary_.find(value); it != dictionary_.end()) {
+        put_varint(std::uint64_t{it->second} + 1);
+        return;
+    }
+    put_varint(0);
+    put_varint(value.size());
+    record_.append(value);
+    if (dictionary_.size() < max_dictionary) {
+        dictionary_.emplace(value, static_cast<std::uint32_t>(dictionary_.size()));
+    }
+}
+
+// Records are assembled in 'record_' first and written with a single call
+void
+TraceRecorder::begin_record_locked(TraceEventKind kind) {
+    const auto now   = std::chrono::steady_clock::now();
+    const auto delta = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count();
+    last_            = now;
+    record_.clear();
+    record_.push_back(static_cast<char>(kind));
+    put_varint(static_cast<std::uint64_t>(std::max<std::int64_t>(delta, 0)));
+}
+
+void
+TraceRecorder::flush_record_locked() {
+    std::fwrite(record_.data(), 1, record_.size(), file_);
+}
+
+void
+TraceRecorder::write_match(const FontQuery &query) {
+    std::lock_guard lock(mutex_);
+    if (! file_) { return; }
+    begin_record_locked(TraceEventKind::Match);
+
+    std::uint8_t mask = 0;
+    if (query.family) { mask |= HasFamily; }
+    if (query.style) { mask |= HasStyle; }
+    if (query.weight) { mask |= HasWeight; }
+    if (query.stretch) { mask |= HasStretch; }
+    if (query.italic) { mask |= HasItalic | (*query.italic ? IsItalic : 0); }
+    if (! query.features.empty() || ! query.scripts.empty()) { mask |= HasLayout; }
+    record_.push_back(static_cast<char>(mask));
+    if (query.family) { put_string(*query.family); }
+    if (query.style) { put_string(*query.style); }
+    if (query.weight) { put_varint(zigzag(*query.weight)); }
+    if (query.stretch) { put_varint(zigzag(*query.stretch)); }
+    if (mask & HasLayout) {
+        for (const auto *tags : {&query.features, &query.scripts}) {
+            put_varint(tags->size());
+            for (const auto &tag : *tags) { put_string(tag); }
+        }
+    }
+    flush_record_locked();
+}
+
+void
+TraceRecorder::write_load(const FontId &id) {
+    std::lock_guard lock(mutex_);
+    if (! file_) { return; }
+    begin_record_locked(TraceEventKind::Load);
+    put_string(id.value);
+    flush_record_locked();
+}
+
+TraceRecorder &
+trace_recorder() {
+    static TraceRecorder recorder{};
+    return recorder;
+}
+
+std::expected<std::vector<TraceEvent>, Error>
+read_trace_file(const std::string &path) {
+    std::ifstream stream(path, std::ios::binary);
+    if (! stream) { return std::unexpected(Error{ErrorCode::InvalidArgument, "Failed to open trace file " + path}); }
+    const std::string contents{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+    TraceReader       reader(contents);
+
+    char          magic[sizeof(trace_magic)]{};
+    std::uint32_t version = 0;
+    if (! reader.raw(magic, sizeof(magic)) || std::memcmp(magic, trace_magic, sizeof(magic)) != 0 ||
+        ! reader.raw(&version, sizeof(version)) || version < 1 || version > trace_version) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "Not an incfontdisc trace file"});
+    }
+
+    std::vector<TraceEvent>  events;
+    std::chrono::nanoseconds clock{};
+    // A truncated tail (recording process killed) is dropped, everything before it is still usable
+    while (! reader.at_end()) {
+        std::uint8_t  kind  = 0;
+        std::uint64_t delta = 0;
+        if (! reader.raw(&kind, 1) || ! reader.varint(delta)) { break; }
+        clock += std::chrono::nanoseconds(static_cast<std::int64_t>(delta));
+
+        TraceEvent event{.kind = static_cast<TraceEventKind>(kind), .timestamp = clock};
+        if (event.kind == TraceEventKind::Match) {
+            std::uint8_t mask = 0;
+            if (! reader.raw(&mask, 1)) { break; }
+            if (version < 2 && (mask & HasLayout)) {
+                return std::unexpected(Error{ErrorCode::InvalidArgument, "Corrupt trace record"});
+            }
+            std::string   text;
+            std::uint64_t number = 0;
+            if (mask & HasFamily) {
+                if (! reader.string(text)) { break; }
+                event.query.family = text;
+            }
+            if (mask & HasStyle) {
+                if (! reader.string(text)) { break; }
+                event.query.style = text;
+            }
+            if (mask & HasWeight) {
+                if (! reader.varint(number)) { break; }
+                event.query.weight = static_cast<int>(unzigzag(number));
+            }
+            if (mask & HasStretch) {
+                if (! reader.varint(number)) { break; }
+                event.query.stretch = static_cast<int>(unzigzag(number));
+            }
+            if (mask & HasItalic) { event.query.italic = (mask & IsItalic) != 0; }
+            if (mask & HasLayout) {
+                bool complete = true;
+                for (auto *tags : {&event.query.features, &event.query.scripts}) {
+                    std::uint64_t count = 0;
+                    complete            = complete && reader.varint(count);
+                    for (std::uint64_t i = 0; complete && i < count; ++i) {
+                        complete = reader.string(text);
+                        if (complete) { tags->push_back(text); }
+                    }
+                }
+                if (! complete) { break; }
+            }
+        }
+        else if (event.kind == TraceEventKind::Load) {
+            if (! reader.string(event.id.value)) { break; }
+        }
+        else { return std::unexpected(Error{ErrorCode::InvalidArgument, "Corrupt trace record"}); }
+        events.push_back(std::move(event));
+    }
+    return events;
+}
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,306 @@
+#include <incfontdisc_private/catalog.hpp>
+#include <incfontdisc_private/file_hash.hpp>
+#include <incfontdisc_private/hash.hpp>
+#include <incfontdisc_private/sfnt.hpp>
+#include <incfontdisc_private/validate.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace incfontdisc::detail {
+
+namespace sfnt {
+
+namespace {
+
+constexpr std::uint32_t tag_ttcf = make_tag('t', 't', 'c', 'f');
+constexpr std::uint32_t tag_otto = make_tag('O', 'T', 'T', 'O');
+constexpr std::uint32_t tag_cff  = make_tag('C', 'F', 'F', ' ');
+constexpr std::uint32_t tag_cff2 = make_tag('C', 'F', 'F', '2');
+constexpr std::uint32_t tag_cmap = make_tag('c', 'm', 'a', 'p');
+constexpr std::uint32_t tag_glyf = make_tag('g', 'l', 'y', 'f');
+constexpr std::uint32_t tag_head = make_tag('h', 'e', 'a', 'd');
+constexpr std::uint32_t tag_hhea = make_tag('h', 'h', 'e', 'a');
+constexpr std::uint32_t tag_hmtx = make_tag('h', 'm', 't', 'x');
+constexpr std::uint32_t tag_loca = make_tag('l', 'o', 'c', 'a');
+constexpr std::uint32_t tag_maxp = make_tag('m', 'a', 'x', 'p');
+
+constexpr std::uint32_t head_magic = 0x5F0F3CF5;
+
+std::unexpected<Error>
+invalid(std::string message) {
+    return std::unexpected(Error{ErrorCode::InvalidArgument, std::move(message)});
+}
+
+std::string
+tag_name(std::uint32_t tag) {
+    std::string name(4, ' ');
+    for (int i = 0; i < 4; ++i) {
+        const auto ch = static_cast<char>((tag >> (24 - i * 8)) & 0xFF);
+        name[i]       = (ch >= 0x20 && ch < 0x7F) ? ch : '?';
+    }
+    return name;
+}
+
+std::expected<void, Error>
+validate_face(std::span<const std::byte> data, int face_index, ValidationLevel level) {
+    auto font = open_font(data, face_index);
+    if (! font) { return std::unexpected(font.error()); }
+    if (font->tables.empty()) { return invalid("Font has no tables"); }
+
+    for (std::size_t i = 0; i < font->tables.size(); ++i) {
+        const auto &record = font->tables[i];
+        if (i > 0 && font->tables[i - 1].tag == record.tag) {
+            return invalid("Table '" + tag_name(record.tag) + "' appears twice");
+        }
+        if (record.offset > data.size() || record.length > data.size() - record.offset) {
+            return invalid("Table '" + tag_name(record.tag) + "' points outside of the file");
+        }
+    }
+
+    const auto head = font->table(tag_head);
+    const auto maxp = font->table(tag_maxp);
+    const auto hhea = font->table(tag_hhea);
+    if (head.size() < 54 || read_u32(head, 12) != head_magic) { return invalid("Missing or malformed head table"); }
+    if (maxp.size() < 6) { return invalid("Missing or malformed maxp table"); }
+    if (hhea.size() < 36) { return invalid("Missing or malformed hhea table"); }
+    if (font->table(tag_cmap).size() < 4) { return invalid("Missing or malformed cmap table"); }
+
+    const std::size_t num_glyphs = read_u16(maxp, 4);
+    const std::size_t metrics    = read_u16(hhea, 34);
+    if (metrics == 0 || metrics > num_glyphs || font->table(tag_hmtx).size() < metrics * 4 + (num_glyphs - metrics) * 2) {
+        return invalid("hmtx table does not cover every glyph");
+    }
+
+    if (font->flavor == tag_otto) {
+        if (font->table(tag_cff).empty() && font->table(tag_cff2).empty()) {
+            return invalid("OpenType font without CFF or CFF2 outlines");
+        }
+    }
+    else {
+        const auto glyf = font->table(tag_glyf);
+        const auto loca = font->table(tag_loca);
+        if (glyf.empty() || loca.empty()) { return invalid("TrueType font without glyf or loca table"); }
+        const bool        long_offsets = read_u16(head, 50) != 0;
+        const std::size_t entry        = long_offsets ? 4 : 2;
+        if (loca.size() < (num_glyphs + 1) * entry) { return invalid("loca table does not cover every glyph"); }
+        std::size_t previous = 0;
+        for (std::size_t glyph = 0; glyph <= num_glyphs; ++glyph) {
+            const std::size_t offset =
+                long_offsets ? read_u32(loca, glyph * 4) : static_cast<std::size_t>(read_u16(loca, glyph * 2)) * 2;
+            if (offset < previous || offset > glyf.size()) { return invalid("loca offsets are out of order or range"); }
+            previous = offset;
+        }
+    }
+
+    if (level == ValidationLevel::Checksums) {
+        for (const auto &record : font->tables) {
+            auto sum = checksum(data.subspan(record.offset, record.length));
+            // The head checksum is defined with checkSumAdjustment taken as zero
+            if (record.tag == tag_head) { sum -= read_u32(head, 8); }
+            if (sum != record.checksum) { return invalid("Checksum mismatch in table '" + tag_name(record.tag) + "'"); }
+        }
+    }
+    return {};
+}
+
+} // namespace
+
+std::expected<void, Error>
+validate(std::span<const std::byte> data, ValidationLevel level) {
+    if (level == ValidationLevel::None) { return {}; }
+    if (data.size() < 12) { return invalid("Font data too short"); }
+
+    if (read_u32(data, 0) != tag_ttcf) { return validate_face(data, 0, level); }
+    const std::uint32_t faces = read_u32(data, 8);
+    if (faces == 0 || faces > (data.size() - 12) / 4) { return invalid("Malformed font collection header"); }
+    for (std::uint32_t face = 0; face < faces; ++face) {
+        if (auto valid = validate_face(data, static_cast<int>(face), level); ! valid) { return valid; }
+    }
+    return {};
+}
+
+} // namespace sfnt
+
+namespace {
+
+// Verdict log: an 8 byte signature followed by fixed size records in host byte order, appended to by every process
+constexpr std::array<char, 8> log_signature = {'I', 'F', 'D', 'V', 'R', 'D', '0', '1'};
+
+struct LogRecord {
+    std::uint64_t path   = 0;
+    std::uint64_t size   = 0;
+    std::int64_t  mtime  = 0;
+    std::uint8_t  level  = 0;
+    std::uint8_t  status = 0;
+    std::uint8_t  padding[6]{};
+};
+static_assert(sizeof(LogRecord) == 32);
+
+// What has to be appended to a log of 'size' bytes: the signature when the file is new, and the length it is cut
+// back to first when a crashed writer left a torn record behind
+std::uintmax_t
+complete_length(std::uintmax_t size) {
+    if (size < log_signature.size()) { return 0; }
+    return size - (size - log_signature.size()) % sizeof(LogRecord);
+}
+
+std::string
+log_append(std::uintmax_t kept, const LogRecord &record) {
+    std::string bytes;
+    if (kept == 0) { bytes.assign(log_signature.data(), log_signature.size()); }
+    bytes.append(reinterpret_cast<const char *>(&record), sizeof(record));
+    return bytes;
+}
+
+// Every process appends under an exclusive lock on the file, so only one of them stamps a new log and each record
+// goes out in a single write
+#if defined(_WIN32)
+
+void
+append_record(const std::filesystem::path &path, const LogRecord &record) {
+    HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return; }
+    OVERLAPPED whole{};
+    if (! ::LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &whole)) {
+        ::CloseHandle(file);
+        return;
+    }
+    LARGE_INTEGER size{};
+    if (::GetFileSizeEx(file, &size)) {
+        const auto    kept = complete_length(static_cast<std::uintmax_t>(size.QuadPart));
+        LARGE_INTEGER end{};
+        end.QuadPart = static_cast<LONGLONG>(kept);
+        if (::SetFilePointerEx(file, end, nullptr, FILE_BEGIN) && ::SetEndOfFile(file)) {
+            const auto bytes   = log_append(kept, record);
+            DWORD      written = 0;
+            ::WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written, nullptr);
+        }
+    }
+    ::UnlockFileEx(file, 0, MAXDWORD, MAXDWORD, &whole);
+    ::CloseHandle(file);
+}
+
+#else
+
+void
+append_record(const std::filesystem::path &path, const LogRecord &record) {
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) { return; }
+    if (::flock(fd, LOCK_EX) != 0) {
+        ::close(fd);
+        return;
+    }
+    struct stat info{};
+    if (::fstat(fd, &info) == 0) {
+        const auto kept = complete_length(static_cast<std::uintmax_t>(info.st_size));
+        if (kept == static_cast<std::uintmax_t>(info.st_size) || ::ftruncate(fd, static_cast<off_t>(kept)) == 0) {
+            const auto            bytes   = log_append(kept, record);
+            [[maybe_unused]] auto written = ::write(fd, bytes.data(), bytes.size());
+        }
+    }
+    ::flock(fd, LOCK_UN);
+    ::close(fd);
+}
+
+#endif
+
+} // namespace
+
+void
+ValidationCache::load_locked() {
+    if (loaded_) { return; }
+    loaded_ = true;
+    if (auto directory = cache_directory("validation")) { log_ = *directory / "verdicts"; }
+    if (! log_) { return; }
+
+    std::ifstream stream(*log_, std::ios::binary);
+    if (! stream) { return; }
+    std::string raw{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+    if (raw.size() < log_signature.size() || std::memcmp(raw.data(), log_signature.data(), log_signature.size()) != 0) {
+        return;
+    }
+    // Later records win, a torn record at the end is ignored
+    for (std::size_t at = log_signature.size(); at + sizeof(LogRecord) <= raw.size(); at += sizeof(LogRecord)) {
+        LogRecord record;
+        std::memcpy(&record, raw.data() + at, sizeof(record));
+        verdicts_[record.path] = Verdict{record.size, record.mtime, static_cast<ValidationLevel>(record.level),
+                                         record.status};
+    }
+}
+
+std::optional<std::expected<void, Error>>
+ValidationCache::lookup_locked(std::uint64_t path, std::uintmax_t size, std::int64_t mtime,
+                               ValidationLevel level) const {
+    auto it = verdicts_.find(path);
+    if (it == verdicts_.end() || it->second.size != size || it->second.mtime != mtime) { return std::nullopt; }
+
+    // Passing a stricter level covers a weaker request, failing a weaker level fails a stricter one too
+    const auto &verdict = it->second;
+    if (verdict.status == 0 && verdict.level >= level) { return std::expected<void, Error>{}; }
+    if (verdict.status != 0 && verdict.level <= level) {
+        return std::unexpected(
+            Error{static_cast<ErrorCode>(verdict.status - 1), "Font failed validation (cached verdict)"});
+    }
+    return std::nullopt;
+}
+
+void
+ValidationCache::store_locked(std::uint64_t path, const Verdict &verdict) {
+    verdicts_[path] = verdict;
+    if (! log_) { return; }
+
+    append_record(*log_, LogRecord{.path   = path,
+                                   .size   = verdict.size,
+                                   .mtime  = verdict.mtime,
+                                   .level  = static_cast<std::uint8_t>(verdict.level),
+                                   .status = verdict.status});
+}
+
+std::expected<void, Error>
+ValidationCache::check(const FontId &id, std::span<const std::byte> data) {
+    const auto level = this->level();
+    if (level == ValidationLevel::None) { return {}; }
+
+    const auto path        = split_font_id(id).first;
+    const auto fingerprint = file_fingerprint(path);
+    // Without a matching fingerprint the verdict could not be attributed to this data, validate without caching
+    if (! fingerprint || fingerprint->size != data.size()) { return sfnt::validate(data, level); }
+
+    const auto path_hash = hash_bytes(std::as_bytes(std::span(path.data(), path.size())));
+    {
+        std::lock_guard lock(mutex_);
+        load_locked();
+        if (auto cached = lookup_locked(path_hash, fingerprint->size, fingerprint->mtime, level)) { return *cached; }
+    }
+
+    auto verdict = sfnt::validate(data, level);
+    {
+        std::lock_guard lock(mutex_);
+        store_locked(path_hash, Verdict{fingerprint->size, fingerprint->mtime, level,
+                                        static_cast<std::uint8_t>(verdict ? 0 : static_cast<int>(verdict.error().code) + 1)});
+    }
+    return verdict;
+}
+
+ValidationCache &
+validation_cache() {
+    static ValidationCache cache{};
+    return cache;
+}
+
+} // namespace incfontdisc::detail
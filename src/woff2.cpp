@@ -0,0 +1,235 @@
+#include <incfontdisc_private/catalog.hpp>
+#include <incfontdisc_private/file_hash.hpp>
+#include <incfontdisc_private/hash.hpp>
+#include <incfontdisc_private/memory.hpp>
+#include <incfontdisc_private/sfnt.hpp>
+#include <incfontdisc_private/woff2.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(INCFONTDISC_WOFF2)
+#include <woff2/encode.h>
+#endif
+
+namespace incfontdisc::detail {
+
+namespace {
+
+// Maximum size of the in-memory part when no global memory budget is configured
+constexpr std::size_t    default_capacity   = 64u << 20;
+// Size of the cache directory, a write past it removes the least recently used files down to the low mark
+constexpr std::uintmax_t disk_capacity      = 256u << 20;
+constexpr std::uintmax_t disk_low_mark      = disk_capacity / 4 * 3;
+// Temporary files this old belong to a writer that died before renaming them
+constexpr auto           stale_temp_age     = std::chrono::hours(1);
+// Encoding is expensive but the disk copy makes a refill cheap, so these go after subsets
+constexpr int            encoded_evict_cost = 2;
+constexpr std::uint32_t  woff2_signature    = sfnt::make_tag('w', 'O', 'F', '2');
+
+std::string
+cache_file_name(std::uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.woff2", static_cast<unsigned long long>(key));
+    return name;
+}
+
+// Keeps the directory within disk_capacity. The modification time of a file is its last use, hits refresh it.
+// Other processes prune the same directory, files they removed first are skipped.
+void
+prune_directory(const std::filesystem::path &directory) {
+    struct CachedFile {
+        std::filesystem::path           path{};
+        std::uintmax_t                  size = 0;
+        std::filesystem::file_time_type used{};
+    };
+    std::vector<CachedFile> files;
+    std::uintmax_t          total = 0;
+    const auto              now   = std::filesystem::file_time_type::clock::now();
+    std::error_code         ec;
+    for (std::filesystem::directory_iterator it(directory, ec), end; ! ec && it != end; it.increment(ec)) {
+        std::error_code entry_ec;
+        if (! it->is_regular_file(entry_ec)) { continue; }
+        const auto used = it->last_write_time(entry_ec);
+        if (entry_ec) { continue; }
+        const auto extension = it->path().extension();
+        if (extension == ".tmp") {
+            if (now - used > stale_temp_age) { std::filesystem::remove(it->path(), entry_ec); }
+            continue;
+        }
+        if (extension != ".woff2") { continue; }
+        const auto size = it->file_size(entry_ec);
+        if (entry_ec) { continue; }
+        total += size;
+        files.push_back(CachedFile{.path = it->path(), .size = size, .used = used});
+    }
+    if (total <= disk_capacity) { return; }
+
+    std::ranges::sort(files, {}, &CachedFile::used);
+    for (const auto &file : files) {
+        if (total <= disk_low_mark) { break; }
+        std::error_code remove_ec;
+        std::filesystem::remove(file.path, remove_ec);
+        total -= file.size;
+    }
+}
+
+std::expected<ByteBuffer, Error>
+encode_woff2([[maybe_unused]] std::span<const std::byte> font) {
+#if defined(INCFONTDISC_WOFF2)
+    const auto *bytes  = reinterpret_cast<const std::uint8_t *>(font.data());
+    std::size_t length = woff2::MaxWOFF2CompressedSize(bytes, font.size());
+    ByteBuffer  out(length);
+    if (! woff2::ConvertTTFToWOFF2(bytes, font.size(), reinterpret_cast<std::uint8_t *>(out.data()), &length)) {
+        return std::unexpected(Error{ErrorCode::InvalidArgument, "WOFF2 encoding of the font failed"});
+    }
+    out.resize(length);
+    return out;
+#else
+    return std::unexpected(Error{ErrorCode::NotImplemented, "incfontdisc was built without WOFF2 support"});
+#endif
+}
+
+} // namespace
+
+bool
+woff2_available() {
+#if defined(INCFONTDISC_WOFF2)
+    return true;
+#else
+    return false;
+#endif
+}
+
+EncodedCache::EncodedCache()
+    : directory_(cache_directory("woff2")) {
+    budget_handle_ = memory_budget().add_cache(MemoryBudget::Cache{
+        .cost  = encoded_evict_cost,
+        .usage = [this] { return usage(); },
+        .evict = [this](std::size_t bytes) { return evict(bytes); },
+    });
+}
+
+EncodedCache::~EncodedCache() {
+    memory_budget().remove_cache(budget_handle_);
+}
+
+std::optional<ByteBuffer>
+EncodedCache::find(const FontId &id) {
+    const auto [path, face_index] = split_font_id(id);
+    const auto content            = file_hashes().find(path);
+    if (! content) { return std::nullopt; }
+    return find_key(hash_combine(*content, static_cast<std::uint64_t>(face_index)));
+}
+
+std::optional<ByteBuffer>
+EncodedCache::find_key(std::uint64_t key) {
+    {
+        std::lock_guard lock(mutex_);
+        if (auto entry = entries_.find(key); entry != entries_.end()) {
+            lru_.splice(lru_.begin(), lru_, entry->second);
+            return entry->second->data;
+        }
+    }
+    if (! directory_) { return std::nullopt; }
+
+    const auto    file = *directory_ / cache_file_name(key);
+    std::ifstream stream(file, std::ios::binary);
+    if (! stream) { return std::nullopt; }
+    std::string raw{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+    ByteBuffer  data(reinterpret_cast<const std::byte *>(raw.data()),
+                     reinterpret_cast<const std::byte *>(raw.data() + raw.size()));
+    // Partially written or foreign files are ignored and get overwritten by the next encode
+    if (data.size() < 48 || sfnt::read_u32(data, 0) != woff2_signature || sfnt::read_u32(data, 8) != data.size()) {
+        return std::nullopt;
+    }
+    // A hit marks the file as recently used for prune_directory
+    std::error_code ec;
+    std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now(), ec);
+    insert(key, data);
+    return data;
+}
+
+std::expected<ByteBuffer, Error>
+EncodedCache::encode(const FontId &id, const ByteBuffer &data) {
+    const auto [path, face_index] = split_font_id(id);
+    const auto key = hash_combine(file_hashes().remember(path, data), static_cast<std::uint64_t>(face_index));
+    if (auto cached = find_key(key)) { return std::move(*cached); }
+
+    auto font = sfnt::open_font(data, face_index);
+    if (! font) { return std::unexpected(font.error()); }
+    // Browsers cannot pick a face out of a collection, so collection members are encoded as standalone fonts
+    const bool collection = font->data.size() >= 4 && sfnt::read_u32(font->data, 0) == sfnt::make_tag('t', 't', 'c', 'f');
+    auto       encoded    = collection ? encode_woff2(sfnt::extract_face(*font)) : encode_woff2(data);
+    if (! encoded) { return std::unexpected(encoded.error()); }
+
+    if (directory_) {
+        // Written under a unique name and renamed so concurrent readers never see a partial file
+        const auto      target = *directory_ / cache_file_name(key);
+        auto            temp   = target;
+        std::error_code ec;
+        temp += "." + std::to_string(std::random_device{}()) + ".tmp";
+        {
+            std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+            stream.write(reinterpret_cast<const char *>(encoded->data()), static_cast<std::streamsize>(encoded->size()));
+            if (! stream) { ec = std::make_error_code(std::errc::io_error); }
+        }
+        if (! ec) { std::filesystem::rename(temp, target, ec); }
+        if (ec) { std::filesystem::remove(temp, ec); }
+        else { prune_directory(*directory_); }
+    }
+    insert(key, *encoded);
+    memory_budget().charged();
+    return encoded;
+}
+
+void
+EncodedCache::insert(std::uint64_t key, const ByteBuffer &data) {
+    std::lock_guard lock(mutex_);
+    if (entries_.contains(key) || data.size() > default_capacity) { return; }
+    bytes_ += data.size();
+    memory_counters().add(MemoryCategory::ByteCaches, data.size());
+    lru_.push_front(Entry{key, data});
+    entries_.emplace(key, lru_.begin());
+    if (bytes_ > default_capacity) { evict_locked(bytes_ - default_capacity); }
+}
+
+std::size_t
+EncodedCache::usage() const {
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
+
+std::size_t
+EncodedCache::evict(std::size_t bytes) {
+    std::lock_guard lock(mutex_);
+    return evict_locked(bytes);
+}
+
+std::size_t
+EncodedCache::evict_locked(std::size_t bytes) {
+    std::size_t freed = 0;
+    while (freed < bytes && ! lru_.empty()) {
+        const auto &oldest = lru_.back();
+        freed             += oldest.data.size();
+        entries_.erase(oldest.key);
+        lru_.pop_back();
+    }
+    bytes_ -= freed;
+    memory_counters().release(MemoryCategory::ByteCaches, freed);
+    return freed;
+}
+
+EncodedCache &
+encoded_cache() {
+    static EncodedCache cache{};
+    return cache;
+}
+
+} // namespace incfontdisc::detail
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Minimal test harness: TEST_CASE registers a case, CHECK records a failure and goes on, REQUIRE ends the case.
+// Every test executable links tests/main.cpp, which runs the registered cases and exits non-zero on any failure.
+namespace incfontdisc::test {
+
+struct Case {
+    const char           *name = nullptr;
+    std::function<void()> body{};
+};
+
+inline std::vector<Case> &
+cases() {
+    static std::vector<Case> registered{};
+    return registered;
+}
+
+inline int &
+failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Register {
+    Register(const char *name, std::function<void()> body) {
+        cases().push_back(Case{name, std::move(body)});
+    }
+};
+
+// Thrown by REQUIRE to leave the current case
+struct Abort {};
+
+inline bool
+report(bool passed, const char *expression, const char *file, int line) {
+    if (! passed) {
+        ++failures();
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+    }
+    return passed;
+}
+
+// Directory holding the font fixtures, see tests/data/make_fixtures.py
+inline std::filesystem::path
+data_path(const std::string &name) {
+    return std::filesystem::path(INCFONTDISC_TEST_DATA) / name;
+}
+
+inline ByteBuffer
+read_file(const std::filesystem::path &path) {
+    std::ifstream stream(path, std::ios::binary);
+    std::string   raw{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+    return ByteBuffer(reinterpret_cast<const std::byte *>(raw.data()),
+                      reinterpret_cast<const std::byte *>(raw.data() + raw.size()));
+}
+
+// A fresh directory per test executable, removed by the next run
+inline std::filesystem::path
+scratch_directory(const std::string &name) {
+    auto            path = std::filesystem::temp_directory_path() / ("incfontdisc-test-" + name);
+    std::error_code ec;
+    std::filesystem::remove_all(path, ec);
+    std::filesystem::create_directories(path);
+    return path;
+}
+
+} // namespace incfontdisc::test
+
+#define INCFONTDISC_TEST_CONCAT_(a, b) a##b
+#define INCFONTDISC_TEST_CONCAT(a, b)  INCFONTDISC_TEST_CONCAT_(a, b)
+
+#define TEST_CASE(name)                                                                                                \
+    static void INCFONTDISC_TEST_CONCAT(test_case_, __LINE__)();                                                       \
+    static const incfontdisc::test::Register INCFONTDISC_TEST_CONCAT(test_register_, __LINE__)(                        \
+        name, INCFONTDISC_TEST_CONCAT(test_case_, __LINE__));                                                          \
+    static void INCFONTDISC_TEST_CONCAT(test_case_, __LINE__)()
+
+#define CHECK(expression) incfontdisc::test::report(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
+
+#define REQUIRE(expression)                                                                                            \
+    do {                                                                                                               \
+        if (! CHECK(expression)) { throw incfontdisc::test::Abort{}; }                                                 \
+    } while (false)
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+# Regenerates the font fixtures of the tests, needs fontTools. The output is committed, building the tests does not
+# run this script.
+import os
+
+from fontTools.feaLib.builder import addOpenTypeFeaturesFromString
+from fontTools.fontBuilder import FontBuilder
+from fontTools.misc.psCharStrings import T2CharString
+from fontTools.pens.t2CharStringPen import T2CharStringPen
+from fontTools.pens.ttGlyphPen import TTGlyphPen
+from fontTools.cffLib import SubrsIndex
+from fontTools.ttLib import TTCollection, TTFont
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+GLYPHS = [".notdef", "A", "B", "acutecomb", "Aacute", "f", "i", "f_i"]
+CMAP = {0x41: "A", 0x42: "B", 0x301: "acutecomb", 0xC1: "Aacute", 0x66: "f", 0x69: "i"}
+ADVANCES = {".notdef": 500, "A": 600, "B": 610, "acutecomb": 0, "Aacute": 600, "f": 320, "i": 280, "f_i": 590}
+FEATURES = """
+languagesystem DFLT dflt;
+languagesystem latn dflt;
+feature liga { sub f i by f_i; } liga;
+"""
+
+
+def box(pen, x0, y0, x1, y1):
+    pen.moveTo((x0, y0))
+    pen.lineTo((x0, y1))
+    pen.lineTo((x1, y1))
+    pen.lineTo((x1, y0))
+    pen.closePath()
+
+
+def finish(fb, family, style, weight):
+    fb.setupHorizontalMetrics({name: (ADVANCES[name], 0) for name in GLYPHS})
+    fb.setupHorizontalHeader(ascent=800, descent=-200)
+    fb.setupNameTable({"familyName": family, "styleName": style, "psName": (family + "-" + style).replace(" ", "")})
+    fb.setupOS2(usWeightClass=weight, sTypoAscender=800, sTypoDescender=-200, usWinAscent=800, usWinDescent=200)
+    fb.setupPost()
+    addOpenTypeFeaturesFromString(fb.font, FEATURES)
+
+
+def truetype(family, style, weight):
+    fb = FontBuilder(1000, isTTF=True)
+    fb.setupGlyphOrder(GLYPHS)
+    fb.setupCharacterMap(CMAP)
+    glyphs = {}
+    for index, name in enumerate(GLYPHS):
+        pen = TTGlyphPen(glyphs)
+        if name == "Aacute":
+            # A composite, subsetting it has to pull in both components
+            pen.addComponent("A", (1, 0, 0, 1, 0, 0))
+            pen.addComponent("acutecomb", (1, 0, 0, 1, 250, 0))
+        else:
+            box(pen, 50, 0, 50 + 40 * (index + 1), 700)
+        glyphs[name] = pen.glyph()
+    fb.setupGlyf(glyphs)
+    fb.setupMaxp()
+    finish(fb, family, style, weight)
+    return fb.font
+
+
+def cff(family, style, weight):
+    fb = FontBuilder(1000, isTTF=False)
+    fb.setupGlyphOrder(GLYPHS)
+    fb.setupCharacterMap(CMAP)
+    charstrings = {}
+    for index, name in enumerate(GLYPHS):
+        pen = T2CharStringPen(ADVANCES[name], None)
+        box(pen, 50, 0, 50 + 40 * (index + 1), 700)
+        charstrings[name] = pen.getCharString()
+    fb.setupCFF((family + "-" + style).replace(" ", ""), {"FullName": family + " " + style}, charstrings, {})
+    # Every glyph draws through a local subroutine, so a subset has to keep the Subrs its Private DICT points at
+    top = fb.font["CFF "].cff.topDictIndex[0]
+    private = top.Private
+    subrs = SubrsIndex()
+    subrs.append(T2CharString(program=[0, 0, "rmoveto", 100, 0, "rlineto", "return"]))
+    private.Subrs = subrs
+    for name in GLYPHS:
+        charstring = top.CharStrings[name]
+        charstring.decompile()
+        program = charstring.program
+        # Bias is 107 for fewer than 1240 subrs, so index 0 is called as -107
+        charstring.program = [program[0], -107, "callsubr"] + program[1:]
+    fb.setupMaxp()
+    finish(fb, family, style, weight)
+    return fb.font
+
+
+def save(font, name):
+    path = os.path.join(HERE, name)
+    font.save(path)
+    return TTFont(path)
+
+
+def main():
+    save(truetype("Tiny Sans", "Regular", 400), "tiny.ttf")
+    save(cff("Tiny Serif", "Regular", 400), "tiny.otf")
+    collection = TTCollection()
+    collection.fonts = [truetype("Tiny Sans", "Regular", 400), truetype("Tiny Sans", "Bold", 700)]
+    collection.save(os.path.join(HERE, "tiny.ttc"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,23 @@
+#include "check.hpp"
+
+#include <exception>
+
+int
+main() {
+    using namespace incfontdisc::test;
+    for (const auto &entry : cases()) {
+        const int before = failures();
+        try {
+            entry.body();
+        }
+        catch (const Abort &) {
+        }
+        catch (const std::exception &error) {
+            ++failures();
+            std::fprintf(stderr, "%s: unexpected exception: %s\n", entry.name, error.what());
+        }
+        std::printf("%s %s\n", failures() == before ? "pass" : "FAIL", entry.name);
+    }
+    std::printf("%zu cases, %d failed checks\n", cases().size(), failures());
+    return failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+#include "check.hpp"
+
+#include <incfontdisc_private/catalog.hpp>
+
+#include <algorithm>
+
+using namespace incfontdisc;
+using namespace incfontdisc::detail;
+
+namespace {
+
+FontId
+fixture_id(const std::string &name, int face = 0) {
+    return FontId{test::data_path(name).string() + "#" + std::to_string(face)};
+}
+
+FontDescriptor
+descriptor(const FontId &id, const std::string &family, int weight = 400) {
+    return FontDescriptor{
+        .id = id, .family = family, .style = "Regular", .weight = weight, .stretch = 100, .italic = false};
+}
+
+// The same face installed three times: a variable TrueType file, a smaller CFF file and a larger static collection
+std::vector<FaceRecord>
+installed_three_times() {
+    return {
+        FaceRecord{.descriptor      = descriptor(fixture_id("tiny.ttf"), "Tiny Sans"),
+                   .postscript_name = "TinySans-Regular",
+                   .version         = 0x10000,
+                   .variable        = true},
+        FaceRecord{.descriptor      = descriptor(fixture_id("tiny.otf"), "Tiny Sans"),
+                   .postscript_name = "TinySans-Regular",
+                   .version         = 0x10000,
+                   .cff             = true},
+        FaceRecord{.descriptor      = descriptor(fixture_id("tiny.ttc"), "Tiny Sans"),
+                   .postscript_name = "TinySans-Regular",
+                   .version         = 0x10000},
+    };
+}
+
+std::shared_ptr<Catalog>
+build(std::vector<FaceRecord> records, DuplicatePolicy policy) {
+    auto catalog = build_catalog(std::move(records), CatalogOptions{.duplicates = policy});
+    REQUIRE(catalog);
+    return *catalog;
+}
+
+std::vector<std::uint64_t>
+handles(const std::vector<FaceChange> &changes) {
+    std::vector<std::uint64_t> out;
+    for (const auto &change : changes) { out.push_back(change.handle.value); }
+    std::ranges::sort(out);
+    return out;
+}
+
+const bool configured = [] {
+    (void)configure_daemon_client(DaemonClientOptions{.enabled = false});
+    return true;
+}();
+
+} // namespace
+
+TEST_CASE("duplicate policies pick the same face in any enumeration order") {
+    const std::pair<DuplicatePolicy, std::string> expected[] = {
+        {DuplicatePolicy::PreferVariable, "tiny.ttf"},
+        {DuplicatePolicy::PreferCff, "tiny.otf"},
+        {DuplicatePolicy::PreferSmallest, "tiny.otf"},
+    };
+    for (const auto &[policy, kept] : expected) {
+        auto records = installed_three_times();
+        for (int order = 0; order < 2; ++order) {
+            const auto catalog = build(records, policy);
+            REQUIRE(catalog->faces.size() == 1);
+            CHECK(catalog->duplicates == 2);
+            CHECK(catalog->faces[0].descriptor.id.value == fixture_id(kept).value);
+            std::ranges::reverse(records);
+        }
+    }
+    CHECK(build(installed_three_times(), DuplicatePolicy::KeepAll)->faces.size() == 3);
+}
+
+TEST_CASE("ids and handles of dropped duplicates resolve to the kept face") {
+    const auto catalog = build(installed_three_times(), DuplicatePolicy::PreferVariable);
+    for (const auto &name : {"tiny.ttf", "tiny.otf", "tiny.ttc"}) {
+        CHECK(catalog->find_face(fixture_id(name)) == std::optional<std::uint32_t>{0});
+        CHECK(catalog->find_face(handle_of(fixture_id(name))) == std::optional<std::uint32_t>{0});
+    }
+    CHECK(! catalog->find_face(fixture_id("tiny.ttc", 1)));
+
+    auto matched = match_in_catalog(*catalog, FontQuery{.family = "Tiny Sans"});
+    REQUIRE(matched);
+    CHECK(matched->font.id.value == fixture_id("tiny.ttf").value);
+}
+
+TEST_CASE("faces differing in version or lacking a PostScript name are not duplicates") {
+    auto records               = installed_three_times();
+    records[1].version         = 0x20000;
+    records[2].postscript_name = {};
+    const auto catalog         = build(records, DuplicatePolicy::PreferSmallest);
+    CHECK(catalog->faces.size() == 3);
+    CHECK(catalog->duplicates == 0);
+
+    // Family names compare normalized, so spelling variants still collapse
+    records                      = installed_three_times();
+    records[1].descriptor.family = "tiny  sans";
+    CHECK(build(records, DuplicatePolicy::PreferSmallest)->faces.size() == 1);
+}
+
+TEST_CASE("generation diffs report added, removed and modified faces") {
+    const auto a = fixture_id("tiny.ttf");
+    const auto b = fixture_id("tiny.otf");
+    const auto c = fixture_id("tiny.ttc");
+    REQUIRE(register_fonts({descriptor(a, "Tiny Sans"), descriptor(b, "Tiny Serif")}));
+    const auto first = catalog_generation();
+    REQUIRE(first);
+    REQUIRE(register_fonts({descriptor(a, "Tiny Sans", 700), descriptor(c, "Tiny Sans")}));
+    const auto second = catalog_generation();
+    REQUIRE(second);
+    CHECK(*second > *first);
+
+    const auto forward = diff_generations(*first, *second);
+    REQUIRE(forward);
+    CHECK(forward->from == *first);
+    CHECK(forward->to == *second);
+    CHECK(handles(forward->added) == std::vector<std::uint64_t>{font_handle(c).value});
+    CHECK(handles(forward->removed) == std::vector<std::uint64_t>{font_handle(b).value});
+    CHECK(handles(forward->modified) == std::vector<std::uint64_t>{font_handle(a).value});
+
+    const auto backward = diff_generations(*second, *first);
+    REQUIRE(backward);
+    CHECK(handles(backward->added) == std::vector<std::uint64_t>{font_handle(b).value});
+    CHECK(handles(backward->removed) == std::vector<std::uint64_t>{font_handle(c).value});
+    CHECK(backward->modified.size() == 1);
+
+    const auto same = diff_generations(*second, *second);
+    REQUIRE(same);
+    CHECK(same->added.empty() && same->removed.empty() && same->modified.empty());
+
+    // An unchanged rebuild is a new generation without changes
+    REQUIRE(refresh_fonts());
+    const auto unchanged = diff_generations(*second, *catalog_generation());
+    REQUIRE(unchanged);
+    CHECK(unchanged->added.empty() && unchanged->removed.empty() && unchanged->modified.empty());
+}
+
+TEST_CASE("only the most recent generations are retained") {
+    REQUIRE(register_fonts({descriptor(fixture_id("tiny.ttf"), "Tiny Sans")}));
+    const auto oldest = catalog_generation();
+    REQUIRE(oldest);
+    for (int i = 0; i < 16; ++i) { REQUIRE(refresh_fonts()); }
+    const auto diff = diff_generations(*oldest, *catalog_generation());
+    REQUIRE(! diff);
+    CHECK(diff.error().code == ErrorCode::InvalidArgument);
+    CHECK(! diff_generations(*catalog_generation() + 1, *catalog_generation()));
+}
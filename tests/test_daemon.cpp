@@ -0,0 +1,242 @@
+#include "check.hpp"
+
+#include <incfontdisc_private/catalog.hpp>
+#include <incfontdisc_private/daemon.hpp>
+
+#include <cstring>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace incfontdisc;
+using namespace incfontdisc::detail;
+using namespace std::chrono_literals;
+
+namespace {
+
+FontDescriptor
+descriptor(const std::string &file, const std::string &family) {
+    return FontDescriptor{.id      = FontId{test::data_path(file).string() + "#0"},
+                          .family  = family,
+                          .style   = "Regular",
+                          .weight  = 400,
+                          .stretch = 100,
+                          .italic  = false};
+}
+
+// A daemon serving the fixtures on a private socket for the lifetime of the test executable
+class Daemon final {
+public:
+    Daemon() {
+        (void)catalog_store().register_faces({FaceRecord{.descriptor = descriptor("tiny.ttf", "Tiny Sans")},
+                                               FaceRecord{.descriptor = descriptor("tiny.otf", "Tiny Serif")}});
+        server_ = std::jthread([this](std::stop_token stop) {
+            result_ = serve_daemon(DaemonOptions{.socket_path = path_, .stop_token = std::move(stop)});
+        });
+        for (int i = 0; i < 500 && ! std::filesystem::exists(path_); ++i) { std::this_thread::sleep_for(10ms); }
+        client_.configure(DaemonClientOptions{.enabled = true, .socket_path = path_});
+    }
+
+    DaemonClient &
+    client() {
+        return client_;
+    }
+    const std::string &
+    path() const {
+        return path_;
+    }
+    // Stops the daemon and returns what serve_daemon reported
+    std::expected<void, Error>
+    stop() {
+        server_.request_stop();
+        server_.join();
+        return result_;
+    }
+
+private:
+    std::string                path_ = (test::scratch_directory("daemon") / "daemon.sock").string();
+    DaemonClient               client_{};
+    std::expected<void, Error> result_{};
+    std::jthread               server_{};
+};
+
+Daemon &
+daemon() {
+    static Daemon instance{};
+    return instance;
+}
+
+// A raw connection for sending frames the client would never produce
+class Connection final {
+public:
+    explicit Connection(const std::string &path) {
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        if (::connect(fd_, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        timeval timeout{.tv_sec = 5, .tv_usec = 0};
+        ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+    ~Connection() {
+        if (fd_ >= 0) { ::close(fd_); }
+    }
+
+    bool
+    connected() const {
+        return fd_ >= 0;
+    }
+    void
+    send(const std::string &bytes) {
+        CHECK(::send(fd_, bytes.data(), bytes.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(bytes.size()));
+    }
+    // Header and payload of the next frame, nullopt when the daemon closed the connection
+    std::optional<std::pair<protocol::FrameHeader, std::string>>
+    receive() {
+        protocol::FrameHeader header{};
+        if (! read_exact(&header, sizeof(header))) { return std::nullopt; }
+        std::string payload(header.size, '\0');
+        if (! read_exact(payload.data(), payload.size())) { return std::nullopt; }
+        return std::pair{header, std::move(payload)};
+    }
+
+private:
+    bool
+    read_exact(void *out, std::size_t size) {
+        for (std::size_t done = 0; done < size;) {
+            const auto got = ::recv(fd_, static_cast<char *>(out) + done, size - done, 0);
+            if (got <= 0) { return false; }
+            done += static_cast<std::size_t>(got);
+        }
+        return true;
+    }
+
+    int fd_ = -1;
+};
+
+std::string
+frame(protocol::Op op, const std::string &payload, std::uint16_t version = protocol::version) {
+    protocol::FrameHeader header{.size    = static_cast<std::uint32_t>(payload.size()),
+                                 .version = version,
+                                 .op      = static_cast<std::uint8_t>(op)};
+    return std::string(reinterpret_cast<const char *>(&header), sizeof(header)) + payload;
+}
+
+std::string
+id_payload(const FontId &id) {
+    protocol::Writer writer;
+    writer.str(id.value);
+    return writer.data();
+}
+
+} // namespace
+
+TEST_CASE("the client lists, matches and describes through the daemon") {
+    auto &client = daemon().client();
+    auto  listed = client.list_fonts();
+    REQUIRE(listed && *listed);
+    CHECK((*listed)->size() == 2);
+
+    auto matched = client.match_fonts(FontQuery{.family = "Tiny Serif"});
+    REQUIRE(matched && *matched);
+    CHECK((*matched)->font.id.value == descriptor("tiny.otf", "Tiny Serif").id.value);
+    CHECK((*matched)->family_score > 0.0f);
+
+    auto described = client.describe_font(descriptor("tiny.ttf", "Tiny Sans").id);
+    REQUIRE(described && *described);
+    CHECK((*described)->family == "Tiny Sans");
+
+    // Errors travel as status and message
+    auto unknown = client.describe_font(FontId{"/not/in/catalog.ttf#0"});
+    REQUIRE(unknown && ! *unknown);
+    CHECK(unknown->error().code == ErrorCode::InvalidArgument);
+    CHECK(unknown->error().message == "FontId is not part of the catalog");
+}
+
+TEST_CASE("loads pass the font file as a descriptor") {
+    auto      &client   = daemon().client();
+    const auto id       = descriptor("tiny.otf", "Tiny Serif").id;
+    const auto expected = test::read_file(test::data_path("tiny.otf"));
+
+    auto loaded = client.load_font_data(id);
+    REQUIRE(loaded && *loaded);
+    CHECK(**loaded == expected);
+
+    auto mapped = client.map_font_data(id, Deadline::clock::now() + 5s);
+    REQUIRE(mapped && *mapped);
+    CHECK(std::ranges::equal((**mapped)->bytes(), expected));
+}
+
+TEST_CASE("frames split across writes are reassembled") {
+    Connection connection(daemon().path());
+    REQUIRE(connection.connected());
+    const auto request = frame(protocol::Op::Describe, id_payload(descriptor("tiny.ttf", "Tiny Sans").id));
+    connection.send(request.substr(0, 5));
+    std::this_thread::sleep_for(50ms);
+    connection.send(request.substr(5, 9));
+    std::this_thread::sleep_for(50ms);
+    connection.send(request.substr(14));
+
+    auto response = connection.receive();
+    REQUIRE(response);
+    CHECK(response->first.op == static_cast<std::uint8_t>(protocol::Op::Describe));
+    CHECK(response->first.status == 0);
+    protocol::Reader reader(response->second);
+    CHECK(reader.descriptor().family == "Tiny Sans");
+    CHECK(reader.at_end());
+
+    // The connection stays usable for the next request
+    connection.send(frame(protocol::Op::List, {}));
+    response = connection.receive();
+    REQUIRE(response);
+    CHECK(response->first.status == 0);
+}
+
+TEST_CASE("malformed frames are answered or dropped without harming other clients") {
+    {
+        Connection connection(daemon().path());
+        REQUIRE(connection.connected());
+        connection.send(frame(static_cast<protocol::Op>(77), {}));
+        const auto response = connection.receive();
+        REQUIRE(response);
+        CHECK(response->first.status == static_cast<std::uint8_t>(ErrorCode::NotImplemented) + 1);
+
+        // A request with trailing bytes is rejected as malformed
+        connection.send(frame(protocol::Op::Describe, id_payload(FontId{"x"}) + "junk"));
+        const auto malformed = connection.receive();
+        REQUIRE(malformed);
+        CHECK(malformed->first.status == static_cast<std::uint8_t>(ErrorCode::InvalidArgument) + 1);
+    }
+    {
+        Connection connection(daemon().path());
+        REQUIRE(connection.connected());
+        connection.send(frame(protocol::Op::List, {}, protocol::version + 1));
+        CHECK(! connection.receive());
+    }
+    {
+        Connection connection(daemon().path());
+        REQUIRE(connection.connected());
+        auto oversized = frame(protocol::Op::List, {});
+        std::uint32_t size = protocol::max_frame_size + 1;
+        std::memcpy(oversized.data(), &size, sizeof(size));
+        connection.send(oversized);
+        CHECK(! connection.receive());
+    }
+    auto listed = daemon().client().list_fonts();
+    REQUIRE(listed && *listed);
+    CHECK((*listed)->size() == 2);
+}
+
+TEST_CASE("a stopped daemon removes its socket and clients fall back") {
+    CHECK(daemon().stop().has_value());
+    CHECK(! std::filesystem::exists(daemon().path()));
+
+    DaemonClient client;
+    client.configure(DaemonClientOptions{.enabled = true, .socket_path = daemon().path()});
+    CHECK(! client.list_fonts());
+}
@@ -0,0 +1,208 @@
+#include "check.hpp"
+
+#include <incfontdisc_private/catalog.hpp>
+#include <incfontdisc_private/deadline.hpp>
+#include <incfontdisc_private/thread_pool.hpp>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+
+using namespace incfontdisc;
+using namespace incfontdisc::detail;
+using namespace std::chrono_literals;
+
+namespace {
+
+using Ran = std::shared_ptr<std::atomic<bool>>;
+
+// Counts as done once 'ran' is set, the work itself owns a copy of the flag as run_until requires
+std::expected<int, Error>
+mark(const Ran &ran) {
+    ran->store(true);
+    return 1;
+}
+
+bool
+eventually(const Ran &ran) {
+    for (int i = 0; i < 200 && ! ran->load(); ++i) { std::this_thread::sleep_for(10ms); }
+    return ran->load();
+}
+
+// Occupies the only worker of the pool until released
+class Blocker final {
+public:
+    Blocker() {
+        executor_instance().submit([opened = opened_] { opened->wait(); });
+        // The worker has to have picked the blocker up before anything else is queued behind it
+        std::this_thread::sleep_for(50ms);
+    }
+    ~Blocker() {
+        release();
+    }
+    void
+    release() {
+        if (released_) { return; }
+        released_ = true;
+        promise_.set_value();
+    }
+
+private:
+    std::promise<void>                       promise_{};
+    std::shared_ptr<std::shared_future<void>> opened_ =
+        std::make_shared<std::shared_future<void>>(promise_.get_future().share());
+    bool released_ = false;
+};
+
+FontDescriptor
+tiny(const std::string &family) {
+    return FontDescriptor{.id      = FontId{test::data_path("tiny.ttf").string() + "#0"},
+                          .family  = family,
+                          .style   = "Regular",
+                          .weight  = 400,
+                          .stretch = 100,
+                          .italic  = false};
+}
+
+const bool configured = [] {
+    (void)configure_daemon_client(DaemonClientOptions{.enabled = false});
+    executor_instance().configure(ExecutorOptions{.thread_count = 1});
+    return true;
+}();
+
+} // namespace
+
+TEST_CASE("unbounded deadlines run on the calling thread") {
+    const auto caller = std::this_thread::get_id();
+    const auto probe  = [](Deadline deadline) -> std::expected<std::thread::id, Error> {
+        if (bounded(deadline)) { return std::unexpected(timeout_error("Probe")); }
+        return std::this_thread::get_id();
+    };
+    auto result = run_until(Deadline::max(), "Probe", probe);
+    REQUIRE(result);
+    CHECK(*result == caller);
+}
+
+TEST_CASE("an expired deadline drops work before it starts") {
+    auto ran    = std::make_shared<std::atomic<bool>>(false);
+    auto result = run_until(Deadline::clock::now() - 1ms, "Probe", [ran](Deadline) { return mark(ran); });
+    REQUIRE(! result);
+    CHECK(result.error().code == ErrorCode::Timeout);
+    std::this_thread::sleep_for(50ms);
+    CHECK(! ran->load());
+}
+
+TEST_CASE("work overrunning its deadline reports Timeout and finishes on its worker") {
+    auto       ran     = std::make_shared<std::atomic<bool>>(false);
+    const auto started = Deadline::clock::now();
+    auto       result  = run_until(started + 30ms, "Probe", [ran](Deadline) {
+        std::this_thread::sleep_for(200ms);
+        return mark(ran);
+    });
+    REQUIRE(! result);
+    CHECK(result.error().code == ErrorCode::Timeout);
+    CHECK(Deadline::clock::now() - started < 180ms);
+    CHECK(eventually(ran));
+}
+
+TEST_CASE("work queued past its deadline is dropped or completed by its LateWork policy") {
+    auto dropped   = std::make_shared<std::atomic<bool>>(false);
+    auto completed = std::make_shared<std::atomic<bool>>(false);
+    {
+        Blocker blocker;
+        auto    drop = run_until(Deadline::clock::now() + 30ms, "Probe", [dropped](Deadline) { return mark(dropped); });
+        auto    complete = run_until(
+            Deadline::clock::now() + 30ms, "Probe", [completed](Deadline) { return mark(completed); },
+            LateWork::Complete);
+        CHECK(! drop);
+        CHECK(! complete);
+        CHECK(complete.error().code == ErrorCode::Timeout);
+    }
+    CHECK(eventually(completed));
+    CHECK(! dropped->load());
+}
+
+TEST_CASE("calls from a pool worker run inline and still report their deadline") {
+    struct Seen {
+        bool expired_ran   = false;
+        bool expired_error = false;
+        bool inline_thread = false;
+        bool late_ran      = false;
+        bool late_error    = false;
+    };
+    std::promise<Seen> promise;
+    auto               seen = promise.get_future();
+    executor_instance().submit([&promise] {
+        Seen       out{};
+        const auto worker = std::this_thread::get_id();
+        auto       flag   = std::make_shared<std::atomic<bool>>(false);
+        out.expired_error = ! run_until(Deadline::clock::now() - 1ms, "Probe", [flag](Deadline) { return mark(flag); });
+        out.expired_ran   = flag->load();
+
+        const auto probe = [](Deadline) -> std::expected<std::thread::id, Error> { return std::this_thread::get_id(); };
+        auto       here  = run_until(Deadline::clock::now() + 1s, "Probe", probe);
+        out.inline_thread = here && *here == worker;
+
+        auto late = std::make_shared<std::atomic<bool>>(false);
+        auto result = run_until(
+            Deadline::clock::now() - 1ms, "Probe", [late](Deadline) { return mark(late); }, LateWork::Complete);
+        out.late_error = ! result && result.error().code == ErrorCode::Timeout;
+        out.late_ran   = late->load();
+        promise.set_value(out);
+    });
+    REQUIRE(seen.wait_for(5s) == std::future_status::ready);
+    const auto out = seen.get();
+    CHECK(out.expired_error);
+    CHECK(! out.expired_ran);
+    CHECK(out.inline_thread);
+    CHECK(out.late_error);
+    CHECK(out.late_ran);
+}
+
+TEST_CASE("a stopped catalog build is cancelled") {
+    std::stop_source stop;
+    stop.request_stop();
+    BuildControl            control(stop.get_token(), {});
+    std::vector<FaceRecord> records{FaceRecord{.descriptor = tiny("Tiny Sans")}};
+    auto                    built = build_catalog(records, CatalogOptions{}, &control);
+    REQUIRE(! built);
+    CHECK(built.error().code == ErrorCode::Cancelled);
+}
+
+TEST_CASE("a cancelled refresh keeps the installed catalog") {
+    REQUIRE(register_fonts({tiny("Tiny Sans")}));
+    const auto before = catalog_generation();
+    REQUIRE(before);
+
+    std::stop_source stop;
+    stop.request_stop();
+    const auto refreshed = refresh_fonts(RefreshOptions{.stop_token = stop.get_token()});
+    REQUIRE(! refreshed);
+    CHECK(refreshed.error().code == ErrorCode::Cancelled);
+    CHECK(*catalog_generation() == *before);
+
+    REQUIRE(refresh_fonts(RefreshOptions{.deadline = Deadline::clock::now() + 5s}));
+    CHECK(*catalog_generation() > *before);
+}
+
+TEST_CASE("loads and match_and_load time out on an expired deadline") {
+    REQUIRE(register_fonts({tiny("Tiny Sans")}));
+    const FontQuery query{.family = "Tiny Sans"};
+    const auto      id = tiny("Tiny Sans").id;
+
+    const auto late_load = load_font_data(id, Deadline::clock::now() - 1ms);
+    REQUIRE(! late_load);
+    CHECK(late_load.error().code == ErrorCode::Timeout);
+    const auto late_match = match_and_load(query, Deadline::clock::now() - 1ms);
+    REQUIRE(! late_match);
+    CHECK(late_match.error().code == ErrorCode::Timeout);
+
+    const auto load = load_font_data(id, Deadline::clock::now() + 5s);
+    REQUIRE(load);
+    CHECK(*load == test::read_file(test::data_path("tiny.ttf")));
+    const auto loaded = match_and_load(query, Deadline::clock::now() + 5s);
+    REQUIRE(loaded);
+    CHECK(loaded->match.font.id.value == id.value);
+    CHECK(std::ranges::equal(loaded->data, *load));
+}
@@ -0,0 +1,157 @@
+#include "check.hpp"
+
+#include <incfontdisc_private/file_hash.hpp>
+#include <incfontdisc_private/match_cache.hpp>
+
+#include <atomic>
+#include <thread>
+
+using namespace incfontdisc;
+using namespace incfontdisc::detail;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::shared_ptr<Catalog>
+catalog_of(std::size_t families) {
+    std::vector<FaceRecord> records;
+    for (std::size_t k = 0; k < families; ++k) {
+        const auto     name = std::to_string(k);
+        FontDescriptor descriptor{.id      = FontId{"/missing/family" + name + ".ttf#0"},
+                                  .family  = "Family " + name,
+                                  .style   = "Regular",
+                                  .weight  = 400,
+                                  .stretch = 100,
+                                  .italic  = false};
+        records.push_back(FaceRecord{.descriptor = std::move(descriptor)});
+    }
+    auto catalog = build_catalog(std::move(records), CatalogOptions{});
+    REQUIRE(catalog);
+    return *catalog;
+}
+
+FontQuery
+query_for(std::size_t family) {
+    return FontQuery{.family = "Family " + std::to_string(family)};
+}
+
+FaceMatch
+match_for(const Catalog &catalog, std::size_t family) {
+    const auto face = catalog.find_face(FontId{"/missing/family" + std::to_string(family) + ".ttf#0"});
+    REQUIRE(face);
+    return FaceMatch{
+        .face = *face, .family_score = static_cast<float>(family), .face_score = -static_cast<float>(family)};
+}
+
+bool
+same(const std::optional<FaceMatch> &found, const FaceMatch &expected) {
+    return found && found->face == expected.face && found->family_score == expected.family_score &&
+           found->face_score == expected.face_score;
+}
+
+// Every run starts from empty tables, the ones a previous run left behind are removed
+const bool fresh = [] {
+    if (auto directory = cache_directory("matches")) {
+        std::error_code ec;
+        std::filesystem::remove_all(*directory, ec);
+    }
+    return true;
+}();
+
+} // namespace
+
+TEST_CASE("entries written through one mapping are read through another") {
+    // Two caches on the same table file stand in for two processes
+    MatchCache writer;
+    MatchCache reader;
+    writer.configure(MatchCacheOptions{.persistent = true, .slots = 64});
+    reader.configure(MatchCacheOptions{.persistent = true, .slots = 64});
+
+    const auto catalog = catalog_of(8);
+    const auto match   = match_for(*catalog, 3);
+    CHECK(! reader.find(*catalog, query_for(3)));
+    writer.insert(*catalog, query_for(3), match);
+    CHECK(same(reader.find(*catalog, query_for(3)), match));
+    CHECK(! reader.find(*catalog, query_for(4)));
+}
+
+TEST_CASE("queries matching treats alike share an entry") {
+    MatchCache cache;
+    cache.configure(MatchCacheOptions{.persistent = true, .slots = 64});
+    const auto catalog = catalog_of(8);
+    const auto match   = match_for(*catalog, 5);
+
+    FontQuery stored = query_for(5);
+    stored.features  = {"liga", "kern"};
+    cache.insert(*catalog, stored, match);
+
+    FontQuery alike = stored;
+    alike.family    = "family 5";
+    alike.style     = "regular";
+    alike.features  = {"kern", "liga", "kern"};
+    CHECK(same(cache.find(*catalog, alike), match));
+
+    FontQuery weighted = stored;
+    weighted.weight    = 400;
+    CHECK(! cache.find(*catalog, weighted));
+    FontQuery upper = stored;
+    upper.features  = {"LIGA", "kern"};
+    CHECK(! cache.find(*catalog, upper));
+    FontQuery invalid = stored;
+    invalid.features  = {"toolong"};
+    CHECK(! cache.find(*catalog, invalid));
+}
+
+TEST_CASE("entries are keyed by catalog") {
+    MatchCache cache;
+    cache.configure(MatchCacheOptions{.persistent = true, .slots = 64});
+    const auto catalog = catalog_of(8);
+    const auto other   = catalog_of(9);
+    CHECK(catalog->fingerprint != other->fingerprint);
+    CHECK(catalog->fingerprint == catalog_of(8)->fingerprint);
+
+    cache.insert(*catalog, query_for(2), match_for(*catalog, 2));
+    CHECK(! cache.find(*other, query_for(2)));
+    CHECK(same(cache.find(*catalog_of(8), query_for(2)), match_for(*catalog, 2)));
+}
+
+TEST_CASE("a cache that is not persistent never hits") {
+    MatchCache cache;
+    cache.configure(MatchCacheOptions{.persistent = false});
+    const auto catalog = catalog_of(4);
+    cache.insert(*catalog, query_for(1), match_for(*catalog, 1));
+    CHECK(! cache.find(*catalog, query_for(1)));
+}
+
+TEST_CASE("concurrent writers never expose a torn entry") {
+    // Two buckets for forty queries, so writers keep overwriting each other's slots while readers look
+    constexpr std::size_t families = 40;
+    MatchCache            cache;
+    cache.configure(MatchCacheOptions{.persistent = true, .slots = 8});
+    const auto catalog = catalog_of(families);
+
+    std::atomic<bool>        stop{false};
+    std::atomic<std::size_t> hits{0};
+    std::atomic<std::size_t> torn{0};
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 3; ++t) {
+        threads.emplace_back([&, t] {
+            for (std::size_t k = t; ! stop.load(); k = (k + 7) % families) {
+                cache.insert(*catalog, query_for(k), match_for(*catalog, k));
+            }
+        });
+        threads.emplace_back([&, t] {
+            for (std::size_t k = t; ! stop.load(); k = (k + 3) % families) {
+                const auto found = cache.find(*catalog, query_for(k));
+                if (! found) { continue; }
+                hits.fetch_add(1);
+                if (! same(found, match_for(*catalog, k))) { torn.fetch_add(1); }
+            }
+        });
+    }
+    std::this_thread::sleep_for(300ms);
+    stop.store(true);
+    for (auto &thread : threads) { thread.join(); }
+    CHECK(hits.load() > 0);
+    CHECK(torn.load() == 0);
+}
@@ -0,0 +1,122 @@
+#include "check.hpp"
+
+#include <incfontdisc_private/daemon_protocol.hpp>
+
+#include <limits>
+
+using namespace incfontdisc;
+using namespace incfontdisc::detail;
+
+namespace {
+
+FontQuery
+full_query() {
+    FontQuery query{};
+    query.family   = "Tiny Sans";
+    query.style    = "Bold Italic";
+    query.weight   = 700;
+    query.stretch  = 75;
+    query.italic   = false;
+    query.features = {"liga", "kern"};
+    query.scripts  = {"latn"};
+    return query;
+}
+
+bool
+same_query(const FontQuery &a, const FontQuery &b) {
+    return a.family == b.family && a.style == b.style && a.weight == b.weight && a.stretch == b.stretch &&
+           a.italic == b.italic && a.features == b.features && a.scripts == b.scripts;
+}
+
+} // namespace
+
+TEST_CASE("queries survive a round trip with every field set or unset") {
+    for (const auto &query : {full_query(), FontQuery{}, FontQuery{.family = std::string{}}}) {
+        protocol::Writer writer;
+        writer.query(query);
+        protocol::Reader reader(writer.data());
+        const auto       read = reader.query();
+        CHECK(reader.at_end());
+        CHECK(same_query(read, query));
+    }
+}
+
+TEST_CASE("descriptors and scalars survive a round trip") {
+    const FontDescriptor font{.id      = FontId{"/fonts/tiny.ttc#1"},
+                              .family  = "Tiny Sans",
+                              .style   = "Bold",
+                              .weight  = 700,
+                              .stretch = 100,
+                              .italic  = true};
+    protocol::Writer     writer;
+    writer.descriptor(font);
+    writer.f32(0.625f);
+    writer.u64(std::numeric_limits<std::uint64_t>::max());
+    writer.i32(-5);
+    writer.str(std::string("with\0nul", 8));
+
+    protocol::Reader reader(writer.data());
+    const auto       read = reader.descriptor();
+    CHECK(read.id.value == font.id.value);
+    CHECK(read.family == font.family);
+    CHECK(read.style == font.style);
+    CHECK(read.weight == 700);
+    CHECK(read.stretch == 100);
+    CHECK(read.italic);
+    CHECK(reader.f32() == 0.625f);
+    CHECK(reader.u64() == std::numeric_limits<std::uint64_t>::max());
+    CHECK(reader.i32() == -5);
+    CHECK(reader.str() == std::string("with\0nul", 8));
+    CHECK(reader.at_end());
+}
+
+TEST_CASE("every truncation of a payload is detected") {
+    protocol::Writer writer;
+    writer.query(full_query());
+    const auto &data = writer.data();
+    for (std::size_t size = 0; size < data.size(); ++size) {
+        protocol::Reader reader(std::span(data.data(), size));
+        (void)reader.query();
+        CHECK(! reader.at_end());
+    }
+}
+
+TEST_CASE("a failed read poisons the reader") {
+    protocol::Writer writer;
+    writer.i32(1000); // a string length far past the payload
+    writer.str("abc");
+    protocol::Reader reader(writer.data());
+    CHECK(reader.str().empty());
+    CHECK(! reader.ok());
+    // Later reads fail too instead of resynchronizing on garbage
+    CHECK(reader.i32() == 0);
+    CHECK(! reader.ok());
+    CHECK(! reader.at_end());
+}
+
+TEST_CASE("string list counts are bounded by the payload") {
+    for (const std::int32_t count : {-1, 2, std::numeric_limits<std::int32_t>::max()}) {
+        protocol::Writer writer;
+        writer.i32(count);
+        writer.str("x");
+        protocol::Reader reader(writer.data());
+        const auto       values = reader.strings();
+        CHECK(! reader.ok());
+        CHECK(values.size() <= 1);
+    }
+    protocol::Writer writer;
+    writer.strings({"a", "", "c"});
+    protocol::Reader reader(writer.data());
+    CHECK(reader.strings() == (std::vector<std::string>{"a", "", "c"}));
+    CHECK(reader.at_end());
+}
+
+TEST_CASE("trailing bytes are not mistaken for the end of a request") {
+    protocol::Writer writer;
+    writer.str("/fonts/tiny.ttf#0");
+    writer.u8(0);
+    protocol::Reader reader(writer.data());
+    CHECK(reader.str() == "/fonts/tiny.ttf#0");
+    CHECK(reader.ok());
+    CHECK(! reader.at_end());
+}
@@ -0,0 +1,135 @@
+#include "check.hpp"
+
+#include <incfontdisc_private/sfnt.hpp>
+#include <incfontdisc_private/validate.hpp>
+
+#include <algorithm>
+
+using namespace incfontdisc;
+using namespace incfontdisc::detail;
+
+namespace {
+
+constexpr std::uint32_t tag_glyf = sfnt::make_tag('g', 'l', 'y', 'f');
+constexpr std::uint32_t tag_head = sfnt::make_tag('h', 'e', 'a', 'd');
+
+bool
+contains(const std::vector<std::uint32_t> &tags, std::uint32_t tag) {
+    return std::ranges::find(tags, tag) != tags.end();
+}
+
+} // namespace
+
+TEST_CASE("open_font reads the table directory of a TrueType font") {
+    const auto data = test::read_file(test::data_path("tiny.ttf"));
+    auto       font = sfnt::open_font(data, 0);
+    REQUIRE(font);
+    CHECK(font->flavor == 0x00010000u);
+    CHECK(! font->table(tag_glyf).empty());
+    REQUIRE(font->record(tag_head));
+    CHECK(font->record(tag_head)->length == 54);
+    CHECK(font->table(sfnt::make_tag('C', 'F', 'F', ' ')).empty());
+    CHECK(sfnt::weight_class(*font) == 400);
+}
+
+TEST_CASE("open_font resolves collection members and rejects missing ones") {
+    const auto data = test::read_file(test::data_path("tiny.ttc"));
+    auto       bold = sfnt::open_font(data, 1);
+    REQUIRE(bold);
+    CHECK(sfnt::weight_class(*bold) == 700);
+    CHECK(sfnt::weight_class(*sfnt::open_font(data, 0)) == 400);
+    CHECK(! sfnt::open_font(data, 2));
+    CHECK(! sfnt::open_font(data, -1));
+
+    // The extracted face stands alone and keeps its tables
+    const auto standalone = sfnt::extract_face(*bold);
+    auto       reopened   = sfnt::open_font(standalone, 0);
+    REQUIRE(reopened);
+    CHECK(sfnt::weight_class(*reopened) == 700);
+    CHECK(sfnt::validate(standalone, ValidationLevel::Checksums).has_value());
+}
+
+TEST_CASE("open_font rejects truncated and foreign data") {
+    const auto data = test::read_file(test::data_path("tiny.ttf"));
+    for (std::size_t size : {std::size_t{0}, std::size_t{4}, std::size_t{12}, std::size_t{20}}) {
+        CHECK(! sfnt::open_font(std::span(data).first(size), 0));
+    }
+    ByteBuffer foreign = data;
+    foreign[0]         = std::byte{'w'};
+    CHECK(! sfnt::open_font(foreign, 0));
+
+    // A table reaching past the end of the file is reported missing instead of read out of bounds
+    ByteBuffer oversized = data;
+    const auto tables    = sfnt::read_u16(data, 4);
+    for (std::size_t record = 12; record < 12 + 16u * tables; record += 16) {
+        if (sfnt::read_u32(data, record) == tag_glyf) { sfnt::patch_u32(oversized, record + 12, 0x7FFFFFFF); }
+    }
+    auto font = sfnt::open_font(oversized, 0);
+    if (font) { CHECK(font->table(tag_glyf).empty()); }
+    CHECK(! sfnt::validate(oversized, ValidationLevel::Structure));
+}
+
+TEST_CASE("CharMap maps codepoints and enumerates them in order") {
+    const auto data = test::read_file(test::data_path("tiny.ttf"));
+    auto       font = sfnt::open_font(data, 0);
+    REQUIRE(font);
+    auto cmap = sfnt::CharMap::from_font(*font);
+    REQUIRE(cmap);
+    CHECK(cmap->glyph_for(U'A') == 1);
+    CHECK(cmap->glyph_for(U'B') == 2);
+    CHECK(cmap->glyph_for(U'́') == 3);
+    CHECK(cmap->glyph_for(U'Á') == 4);
+    CHECK(cmap->glyph_for(U'Z') == 0);
+    CHECK(cmap->glyph_for(U'\U0001F600') == 0);
+
+    std::vector<char32_t> seen;
+    cmap->for_each([&](char32_t codepoint, std::uint32_t) { seen.push_back(codepoint); });
+    CHECK(seen == (std::vector<char32_t>{U'A', U'B', U'f', U'i', U'Á', U'́'}));
+}
+
+TEST_CASE("layout_tags collects GSUB scripts and features") {
+    const auto data = test::read_file(test::data_path("tiny.ttf"));
+    auto       font = sfnt::open_font(data, 0);
+    REQUIRE(font);
+    const auto tags = sfnt::layout_tags(*font);
+    CHECK(contains(tags.features, sfnt::make_tag('l', 'i', 'g', 'a')));
+    CHECK(contains(tags.scripts, sfnt::make_tag('l', 'a', 't', 'n')));
+    CHECK(contains(tags.scripts, sfnt::make_tag('D', 'F', 'L', 'T')));
+    CHECK(std::ranges::is_sorted(tags.features));
+    CHECK(std::ranges::is_sorted(tags.scripts));
+}
+
+TEST_CASE("validate tells structure from checksum damage") {
+    const auto data = test::read_file(test::data_path("tiny.ttf"));
+    CHECK(sfnt::validate(data, ValidationLevel::Checksums).has_value());
+    CHECK(sfnt::validate(test::read_file(test::data_path("tiny.otf")), ValidationLevel::Checksums).has_value());
+    CHECK(sfnt::validate(test::read_file(test::data_path("tiny.ttc")), ValidationLevel::Checksums).has_value());
+
+    auto font = sfnt::open_font(data, 0);
+    REQUIRE(font);
+    ByteBuffer damaged = data;
+    damaged[font->record(tag_glyf)->offset + 2] ^= std::byte{0x5A};
+    CHECK(sfnt::validate(damaged, ValidationLevel::Structure).has_value());
+    const auto checked = sfnt::validate(damaged, ValidationLevel::Checksums);
+    REQUIRE(! checked);
+    CHECK(checked.error().code == ErrorCode::InvalidArgument);
+
+    CHECK(! sfnt::validate(std::span(data).first(40), ValidationLevel::Structure));
+}
+
+TEST_CASE("write_font produces a font that passes checksum validation") {
+    const auto data = test::read_file(test::data_path("tiny.ttf"));
+    auto       font = sfnt::open_font(data, 0);
+    REQUIRE(font);
+    std::vector<sfnt::TableData> tables;
+    // Reversed on purpose, the writer sorts the directory
+    for (auto it = font->tables.rbegin(); it != font->tables.rend(); ++it) {
+        tables.push_back(sfnt::TableData{it->tag, font->table(it->tag)});
+    }
+    const auto written = sfnt::write_font(font->flavor, tables);
+    CHECK(sfnt::validate(written, ValidationLevel::Checksums).has_value());
+    auto reopened = sfnt::open_font(written, 0);
+    REQUIRE(reopened);
+    CHECK(reopened->tables.size() == font->tables.size());
+    CHECK(std::ranges::equal(reopened->table(tag_glyf), font->table(tag_glyf)));
+}
@@ -0,0 +1,246 @@
+#include "check.hpp"
+
+#include <incfontdisc_private/sfnt.hpp>
+#include <incfontdisc_private/subset.hpp>
+#include <incfontdisc_private/validate.hpp>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+using namespace incfontdisc;
+using namespace incfontdisc::detail;
+
+namespace {
+
+constexpr std::uint32_t tag_cff  = sfnt::make_tag('C', 'F', 'F', ' ');
+constexpr std::uint32_t tag_glyf = sfnt::make_tag('g', 'l', 'y', 'f');
+constexpr std::uint32_t tag_gsub = sfnt::make_tag('G', 'S', 'U', 'B');
+constexpr std::uint32_t tag_head = sfnt::make_tag('h', 'e', 'a', 'd');
+constexpr std::uint32_t tag_hhea = sfnt::make_tag('h', 'h', 'e', 'a');
+constexpr std::uint32_t tag_hmtx = sfnt::make_tag('h', 'm', 't', 'x');
+constexpr std::uint32_t tag_loca = sfnt::make_tag('l', 'o', 'c', 'a');
+constexpr std::uint32_t tag_maxp = sfnt::make_tag('m', 'a', 'x', 'p');
+
+struct Subset {
+    ByteBuffer                 original{};
+    ByteBuffer                 data{};
+    std::vector<std::uint16_t> glyphs{};
+};
+
+Subset
+subset_of(const std::string &fixture, std::u32string_view codepoints) {
+    Subset result{.original = test::read_file(test::data_path(fixture))};
+    auto   font = sfnt::open_font(result.original, 0);
+    REQUIRE(font);
+    auto cmap = sfnt::CharMap::from_font(*font);
+    REQUIRE(cmap);
+    auto glyphs = sfnt::plan_subset(*font, *cmap, codepoints);
+    REQUIRE(glyphs);
+    result.glyphs = *glyphs;
+    auto built    = sfnt::build_subset(*font, *cmap, result.glyphs);
+    REQUIRE(built);
+    result.data = std::move(*built);
+    return result;
+}
+
+std::uint16_t
+advance_of(const sfnt::FontFile &font, std::uint16_t glyph) {
+    const auto metrics = sfnt::read_u16(font.table(tag_hhea), 34);
+    return sfnt::read_u16(font.table(tag_hmtx), 4u * std::min<std::uint16_t>(glyph, metrics - 1));
+}
+
+// Glyph ids a composite glyf entry refers to, empty for simple glyphs
+std::vector<std::uint16_t>
+components_of(const sfnt::FontFile &font, std::uint16_t glyph) {
+    const bool long_loca = sfnt::read_u16(font.table(tag_head), 50) != 0;
+    const auto loca      = font.table(tag_loca);
+    const auto start     = long_loca ? sfnt::read_u32(loca, 4u * glyph) : 2u * sfnt::read_u16(loca, 2u * glyph);
+    const auto entry     = font.table(tag_glyf).subspan(start);
+    std::vector<std::uint16_t> components;
+    if (static_cast<std::int16_t>(sfnt::read_u16(entry, 0)) >= 0) { return components; }
+    for (std::size_t at = 10;;) {
+        const auto flags = sfnt::read_u16(entry, at);
+        components.push_back(sfnt::read_u16(entry, at + 2));
+        at += 4 + ((flags & 0x0001) ? 4 : 2);
+        at += (flags & 0x0008) ? 2 : (flags & 0x0040) ? 4 : (flags & 0x0080) ? 8 : 0;
+        if ((flags & 0x0020) == 0) { return components; }
+    }
+}
+
+// Just enough of CFF to look at the charstrings and the Private DICT with its Subrs
+struct CffIndex {
+    std::vector<std::span<const std::byte>> objects{};
+    std::size_t                             end = 0;
+};
+
+CffIndex
+read_index(std::span<const std::byte> cff, std::size_t at) {
+    CffIndex   index{};
+    const auto count = sfnt::read_u16(cff, at);
+    if (count == 0) {
+        index.end = at + 2;
+        return index;
+    }
+    const auto size   = std::to_integer<std::size_t>(cff[at + 2]);
+    auto       offset = [&](std::size_t i) {
+        std::size_t value = 0;
+        for (std::size_t b = 0; b < size; ++b) {
+            value = (value << 8) | std::to_integer<std::size_t>(cff[at + 3 + i * size + b]);
+        }
+        return value;
+    };
+    const auto base = at + 3 + (count + 1u) * size - 1;
+    for (std::size_t i = 0; i < count; ++i) {
+        index.objects.push_back(cff.subspan(base + offset(i), offset(i + 1) - offset(i)));
+    }
+    index.end = base + offset(count);
+    return index;
+}
+
+std::map<int, std::vector<std::int32_t>>
+read_dict(std::span<const std::byte> dict) {
+    std::map<int, std::vector<std::int32_t>> entries;
+    std::vector<std::int32_t>                operands;
+    for (std::size_t at = 0; at < dict.size();) {
+        const int b0 = std::to_integer<int>(dict[at++]);
+        if (b0 >= 32 && b0 <= 246) { operands.push_back(b0 - 139); }
+        else if (b0 >= 247 && b0 <= 250) {
+            operands.push_back((b0 - 247) * 256 + std::to_integer<int>(dict[at++]) + 108);
+        }
+        else if (b0 >= 251 && b0 <= 254) {
+            operands.push_back(-(b0 - 251) * 256 - std::to_integer<int>(dict[at++]) - 108);
+        }
+        else if (b0 == 28) {
+            operands.push_back(static_cast<std::int16_t>(sfnt::read_u16(dict, at)));
+            at += 2;
+        }
+        else if (b0 == 29) {
+            operands.push_back(static_cast<std::int32_t>(sfnt::read_u32(dict, at)));
+            at += 4;
+        }
+        else if (b0 == 30) {
+            // Real numbers are nibbles ending in 0xF, skipped as their value does not matter here
+            while ((std::to_integer<int>(dict[at]) & 0x0F) != 0x0F && (std::to_integer<int>(dict[at]) >> 4) != 0x0F) {
+                ++at;
+            }
+            ++at;
+            operands.push_back(0);
+        }
+        else {
+            const int op = b0 == 12 ? 1200 + std::to_integer<int>(dict[at++]) : b0;
+            entries[op]  = std::exchange(operands, {});
+        }
+    }
+    return entries;
+}
+
+struct CffFont {
+    CffIndex                   charstrings{};
+    std::span<const std::byte> private_dict{};
+    CffIndex                   subrs{};
+    std::int32_t               subrs_offset = 0;
+};
+
+CffFont
+read_cff(std::span<const std::byte> cff) {
+    const auto names   = read_index(cff, std::to_integer<std::size_t>(cff[2]));
+    const auto top     = read_index(cff, names.end);
+    const auto entries = read_dict(top.objects.at(0));
+    CffFont    font{};
+    font.charstrings     = read_index(cff, static_cast<std::size_t>(entries.at(17).at(0)));
+    const auto &priv     = entries.at(18);
+    font.private_dict    = cff.subspan(static_cast<std::size_t>(priv.at(1)), static_cast<std::size_t>(priv.at(0)));
+    const auto private_e = read_dict(font.private_dict);
+    if (private_e.contains(19)) {
+        font.subrs_offset = private_e.at(19).at(0);
+        font.subrs        = read_index(cff, static_cast<std::size_t>(priv.at(1) + font.subrs_offset));
+    }
+    return font;
+}
+
+} // namespace
+
+TEST_CASE("plan_subset adds .notdef and composite components") {
+    const auto subset = subset_of("tiny.ttf", U"Á");
+    CHECK(subset.glyphs == (std::vector<std::uint16_t>{0, 1, 3, 4}));
+    CHECK(subset_of("tiny.ttf", U"BBA").glyphs == (std::vector<std::uint16_t>{0, 1, 2}));
+    // Layout is dropped, a ligature the codepoints could form is not pulled in
+    CHECK(subset_of("tiny.ttf", U"fi").glyphs == (std::vector<std::uint16_t>{0, 5, 6}));
+    CHECK(subset_of("tiny.ttf", U"Zz").glyphs == (std::vector<std::uint16_t>{0}));
+}
+
+TEST_CASE("TrueType subsets renumber glyphs, composites and the cmap") {
+    const auto subset = subset_of("tiny.ttf", U"Á");
+    CHECK(sfnt::validate(subset.data, ValidationLevel::Checksums).has_value());
+    auto font = sfnt::open_font(subset.data, 0);
+    REQUIRE(font);
+    CHECK(font->flavor == 0x00010000u);
+    CHECK(sfnt::read_u16(font->table(tag_maxp), 4) == 4);
+    CHECK(font->table(tag_gsub).empty());
+
+    auto cmap = sfnt::CharMap::from_font(*font);
+    REQUIRE(cmap);
+    CHECK(cmap->glyph_for(U'A') == 1);
+    CHECK(cmap->glyph_for(U'́') == 2);
+    CHECK(cmap->glyph_for(U'Á') == 3);
+    CHECK(cmap->glyph_for(U'B') == 0);
+    CHECK(components_of(*font, 3) == (std::vector<std::uint16_t>{1, 2}));
+    CHECK(components_of(*font, 1).empty());
+    CHECK(advance_of(*font, 1) == 600);
+    CHECK(advance_of(*font, 3) == 600);
+}
+
+TEST_CASE("subsets depend on the glyph set alone") {
+    // 'A' is part of the set for 'Á' anyway, adding it changes nothing
+    CHECK(subset_of("tiny.ttf", U"Á").data == subset_of("tiny.ttf", U"AÁ").data);
+    CHECK(subset_of("tiny.otf", U"B").data == subset_of("tiny.otf", U"BB").data);
+    CHECK(subset_of("tiny.ttf", U"A").data != subset_of("tiny.ttf", U"B").data);
+}
+
+TEST_CASE("CFF subsets keep the charstrings and the Private DICT with its Subrs") {
+    const auto subset = subset_of("tiny.otf", U"B");
+    CHECK(subset.glyphs == (std::vector<std::uint16_t>{0, 2}));
+    CHECK(sfnt::validate(subset.data, ValidationLevel::Checksums).has_value());
+    auto font = sfnt::open_font(subset.data, 0);
+    REQUIRE(font);
+    CHECK(font->flavor == sfnt::make_tag('O', 'T', 'T', 'O'));
+    CHECK(font->table(tag_glyf).empty());
+    CHECK(sfnt::read_u16(font->table(tag_maxp), 4) == 2);
+    CHECK(advance_of(*font, 1) == 610);
+
+    auto original = sfnt::open_font(subset.original, 0);
+    REQUIRE(original);
+    const auto before = read_cff(original->table(tag_cff));
+    const auto after  = read_cff(font->table(tag_cff));
+    REQUIRE(after.charstrings.objects.size() == 2);
+    CHECK(std::ranges::equal(after.charstrings.objects[0], before.charstrings.objects[0]));
+    CHECK(std::ranges::equal(after.charstrings.objects[1], before.charstrings.objects[2]));
+
+    // The Private DICT size covers the DICT alone, the Subrs it points at follow right after it
+    REQUIRE(before.subrs.objects.size() == 1);
+    REQUIRE(after.subrs.objects.size() == 1);
+    CHECK(after.subrs_offset == static_cast<std::int32_t>(after.private_dict.size()));
+    CHECK(std::ranges::equal(after.subrs.objects[0], before.subrs.objects[0]));
+
+    auto cmap = sfnt::CharMap::from_font(*font);
+    REQUIRE(cmap);
+    CHECK(cmap->glyph_for(U'B') == 1);
+    CHECK(cmap->glyph_for(U'A') == 0);
+}
+
+TEST_CASE("collection members are subset as standalone fonts") {
+    const auto data = test::read_file(test::data_path("tiny.ttc"));
+    auto       bold = sfnt::open_font(data, 1);
+    REQUIRE(bold);
+    auto cmap = sfnt::CharMap::from_font(*bold);
+    REQUIRE(cmap);
+    auto glyphs = sfnt::plan_subset(*bold, *cmap, U"A");
+    REQUIRE(glyphs);
+    auto built = sfnt::build_subset(*bold, *cmap, *glyphs);
+    REQUIRE(built);
+    auto font = sfnt::open_font(*built, 0);
+    REQUIRE(font);
+    CHECK(sfnt::weight_class(*font) == 700);
+    CHECK(sfnt::read_u32(*built, 0) != sfnt::make_tag('t', 't', 'c', 'f'));
+}
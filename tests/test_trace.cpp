@@ -0,0 +1,148 @@
+#include "check.hpp"
+
+#include <incfontdisc_private/trace.hpp>
+
+#include <cstring>
+
+using namespace incfontdisc;
+using namespace incfontdisc::detail;
+
+namespace {
+
+const auto scratch = test::scratch_directory("trace");
+
+std::string
+slurp(const std::filesystem::path &path) {
+    const auto data = test::read_file(path);
+    return std::string(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+void
+spill(const std::filesystem::path &path, const std::string &contents) {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    stream.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+}
+
+// File header of the given version as the recorder writes it, the version in host byte order
+std::string
+header(std::uint32_t version) {
+    std::string out("IFDTRACE");
+    out.append(reinterpret_cast<const char *>(&version), sizeof(version));
+    return out;
+}
+
+std::string
+literal(const std::string &value) {
+    return std::string(1, '\0') + static_cast<char>(value.size()) + value;
+}
+
+std::filesystem::path
+record_sample() {
+    const auto    path = scratch / "sample.trace";
+    TraceRecorder recorder;
+    REQUIRE(recorder.start(path.string()));
+    CHECK(! recorder.start(path.string()));
+
+    FontQuery layout{};
+    layout.family   = "Tiny Sans";
+    layout.weight   = -20;
+    layout.italic   = true;
+    layout.features = {"liga", "kern"};
+    layout.scripts  = {"latn"};
+    recorder.record_match(layout);
+    recorder.record_load(FontId{"/fonts/tiny.ttf#0"});
+    FontQuery plain{};
+    plain.family  = "Tiny Sans";
+    plain.style   = "Bold";
+    plain.stretch = 125;
+    plain.italic  = false;
+    recorder.record_match(plain);
+    recorder.record_load(FontId{"/fonts/tiny.ttf#0"});
+    REQUIRE(recorder.stop());
+    return path;
+}
+
+} // namespace
+
+TEST_CASE("version 2 traces round trip every query field and tag list") {
+    const auto events = read_trace(record_sample().string());
+    REQUIRE(events);
+    REQUIRE(events->size() == 4);
+    const auto &layout = (*events)[0];
+    CHECK(layout.kind == TraceEventKind::Match);
+    CHECK(layout.query.family == "Tiny Sans");
+    CHECK(! layout.query.style);
+    CHECK(layout.query.weight == -20);
+    CHECK(! layout.query.stretch);
+    CHECK(layout.query.italic == true);
+    CHECK(layout.query.features == (std::vector<std::string>{"liga", "kern"}));
+    CHECK(layout.query.scripts == (std::vector<std::string>{"latn"}));
+
+    CHECK((*events)[1].kind == TraceEventKind::Load);
+    CHECK((*events)[1].id.value == "/fonts/tiny.ttf#0");
+    CHECK((*events)[3].id.value == "/fonts/tiny.ttf#0");
+
+    const auto &plain = (*events)[2];
+    CHECK(plain.query.style == "Bold");
+    CHECK(plain.query.stretch == 125);
+    CHECK(plain.query.italic == false);
+    CHECK(plain.query.features.empty());
+
+    for (std::size_t i = 1; i < events->size(); ++i) { CHECK((*events)[i].timestamp >= (*events)[i - 1].timestamp); }
+}
+
+TEST_CASE("version 1 traces without tag lists are still read") {
+    // Match with family and zigzag weight 400, then a Load that refers back to the family string by dictionary index
+    std::string file = header(1);
+    file += '\x01';
+    file += '\x05';
+    file += static_cast<char>(0x01 | 0x04);
+    file += literal("Tiny Sans");
+    file += "\xA0\x06"; // zigzag(400) = 800 as varint
+    file += '\x02';
+    file += '\x07';
+    file += '\x01';
+    spill(scratch / "v1.trace", file);
+
+    const auto events = read_trace((scratch / "v1.trace").string());
+    REQUIRE(events);
+    REQUIRE(events->size() == 2);
+    CHECK((*events)[0].query.family == "Tiny Sans");
+    CHECK((*events)[0].query.weight == 400);
+    CHECK((*events)[0].timestamp == std::chrono::nanoseconds(5));
+    CHECK((*events)[1].id.value == "Tiny Sans");
+    CHECK((*events)[1].timestamp == std::chrono::nanoseconds(12));
+
+    // Tag lists did not exist in version 1, a record claiming them is corrupt
+    const std::string layout = header(1) + std::string("\x01\x00", 2) + static_cast<char>(0x40);
+    spill(scratch / "v1-layout.trace", layout);
+    CHECK(! read_trace((scratch / "v1-layout.trace").string()));
+}
+
+TEST_CASE("a truncated tail drops only the record it cuts") {
+    const auto whole = slurp(record_sample());
+    for (std::size_t cut = 1; cut <= 3; ++cut) {
+        spill(scratch / "cut.trace", whole.substr(0, whole.size() - cut));
+        const auto events = read_trace((scratch / "cut.trace").string());
+        REQUIRE(events);
+        CHECK(events->size() == 3);
+    }
+    spill(scratch / "empty.trace", header(2));
+    const auto empty = read_trace((scratch / "empty.trace").string());
+    REQUIRE(empty);
+    CHECK(empty->empty());
+}
+
+TEST_CASE("foreign, future and corrupt files are rejected") {
+    spill(scratch / "foreign.trace", "NOTATRACE-------");
+    CHECK(! read_trace((scratch / "foreign.trace").string()));
+    spill(scratch / "future.trace", header(3));
+    CHECK(! read_trace((scratch / "future.trace").string()));
+    spill(scratch / "short.trace", "IFDTR");
+    CHECK(! read_trace((scratch / "short.trace").string()));
+    spill(scratch / "kind.trace", header(2) + std::string("\x09\x00", 2));
+    const auto kind = read_trace((scratch / "kind.trace").string());
+    REQUIRE(! kind);
+    CHECK(kind.error().code == ErrorCode::InvalidArgument);
+    CHECK(! read_trace((scratch / "missing.trace").string()));
+}
@@ -0,0 +1,708 @@
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::string_view usage_text =
+    R"(usage: incfontdisc [options] <command> [inputs...]
+
+commands:
+  list                      list all faces of the catalog
+  match <query>...          resolve queries to faces
+  describe <font-id>...     show the catalog entry of font ids
+  load <query>...           resolve queries and load the matched font files
+  coverage <query> <text>   check which characters of <text> the matched face covers
+  refresh                   rescan the installed fonts, showing the progress of every phase
+  replay <trace>            re-issue a recorded trace and report throughput and latency percentiles
+  memory                    build the catalog and print the library's memory breakdown
+  pin <query>...            pin the matched faces in memory and print the pinned totals
+  bench-scale [faces]       register a synthetic catalog (default 1000000 faces) and time builds and matches
+
+queries:    family[:style=<s>][:weight=<n>][:stretch=<n>][:italic=<0|1>][:features=<tag,...>][:scripts=<tag,...>]
+bulk input: -f <file> reads one input per line ('-' is stdin), coverage lines are <query><TAB><text>
+
+options:
+  -f <file>        read inputs from a file instead of the command line
+  -n <count>       repeat the whole input set <count> times (default 1)
+  -q               do not print results, only timings
+  -j <n>           replay the trace from <n> threads (default 1)
+  --threads <n>    size of the library's worker pool
+  --record <file>  record every match and load of this run to a trace file
+  --no-daemon      never forward requests to incfontdiscd
+  --timeout <ms>   deadline for every match, load and refresh call
+  --lock           pin: also lock the pinned files in RAM
+)";
+
+struct Options {
+    std::string              command{};
+    std::vector<std::string> inputs{};
+    std::optional<std::string> input_file{};
+    std::size_t              repeat  = 1;
+    bool                     quiet   = false;
+    std::size_t              threads = 0;
+    std::size_t              jobs    = 1;
+    std::optional<std::string> record{};
+    bool                     no_daemon = false;
+    bool                     lock      = false;
+    std::optional<std::chrono::milliseconds> timeout{};
+};
+
+// Every call gets the full timeout from the moment it is issued
+incfontdisc::Deadline
+deadline_of(const Options &options) {
+    return options.timeout ? Clock::now() + *options.timeout : incfontdisc::Deadline::max();
+}
+
+// Latency samples of one phase, reported as throughput plus percentiles
+class PhaseStats {
+public:
+    explicit PhaseStats(std::string name) : name_(std::move(name)) {}
+
+    void
+    add(Clock::duration elapsed) {
+        samples_.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+    void
+    add_bytes(std::size_t bytes) {
+        bytes_ += bytes;
+    }
+
+    void
+    merge(const PhaseStats &other) {
+        samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end());
+        bytes_ += other.bytes_;
+    }
+
+    void
+    report() {
+        if (samples_.empty()) { return; }
+        std::sort(samples_.begin(), samples_.end());
+        double total_us = 0.0;
+        for (double sample : samples_) { total_us += sample; }
+
+        auto pct = [&](double p) {
+            const auto at = static_cast<std::size_t>(p * static_cast<double>(samples_.size() - 1) + 0.5);
+            return samples_[std::min(at, samples_.size() - 1)];
+        };
+        std::fprintf(stderr,
+                     "%-10s n=%zu total=%.3fms ops/s=%.1f min=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus max=%.1fus",
+                     name_.c_str(), samples_.size(), total_us / 1000.0,
+                     total_us > 0.0 ? static_cast<double>(samples_.size()) * 1e6 / total_us : 0.0, samples_.front(),
+                     pct(0.50), pct(0.90), pct(0.99), samples_.back());
+        if (bytes_ > 0 && total_us > 0.0) {
+            std::fprintf(stderr, " bytes=%zu MB/s=%.1f", bytes_, static_cast<double>(bytes_) / total_us);
+        }
+        std::fputc('\n', stderr);
+    }
+
+private:
+    std::string         name_;
+    std::vector<double> samples_{};
+    std::size_t         bytes_ = 0;
+};
+
+template <typename Fn>
+auto
+timed(PhaseStats &stats, Fn &&fn) {
+    const auto start  = Clock::now();
+    auto       result = fn();
+    stats.add(Clock::now() - start);
+    return result;
+}
+
+std::optional<int>
+parse_int(std::string_view text) {
+    int value = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || ptr != text.data() + text.size()) { return std::nullopt; }
+    return value;
+}
+
+std::optional<incfontdisc::FontQuery>
+parse_query(std::string_view text) {
+    incfontdisc::FontQuery query{};
+    std::size_t            pos = text.find(':');
+    query.family               = std::string(text.substr(0, pos));
+    if (query.family->empty()) { return std::nullopt; }
+
+    while (pos != std::string_view::npos) {
+        const std::size_t next  = text.find(':', pos + 1);
+        const auto        field = text.substr(pos + 1, next == std::string_view::npos ? next : next - pos - 1);
+        pos                     = next;
+
+        const auto eq = field.find('=');
+        if (eq == std::string_view::npos) { return std::nullopt; }
+        const auto key   = field.substr(0, eq);
+        const auto value = field.substr(eq + 1);
+        if (key == "style") { query.style = std::string(value); }
+        else if (key == "features" || key == "scripts") {
+            auto &tags = key == "features" ? query.features : query.scripts;
+            for (std::size_t begin = 0; begin <= value.size();) {
+                const std::size_t comma = std::min(value.find(',', begin), value.size());
+                tags.emplace_back(value.substr(begin, comma - begin));
+                begin = comma + 1;
+            }
+        }
+        else if (key == "weight" || key == "stretch" || key == "italic") {
+            auto number = parse_int(value);
+            if (! number) { return std::nullopt; }
+            if (key == "weight") { query.weight = *number; }
+            else if (key == "stretch") { query.stretch = *number; }
+            else { query.italic = *number != 0; }
+        }
+        else { return std::nullopt; }
+    }
+    return query;
+}
+
+std::u32string
+decode_utf8(std::string_view text) {
+    std::u32string out;
+    for (std::size_t i = 0; i < text.size();) {
+        const auto lead   = static_cast<unsigned char>(text[i]);
+        const int  length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        if (length == 0 || i + static_cast<std::size_t>(length) > text.size()) {
+            out.push_back(U'�');
+            ++i;
+            continue;
+        }
+        char32_t cp = length == 1 ? lead : lead & (0x7F >> length);
+        for (int k = 1; k < length; ++k) { cp = (cp << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F); }
+        out.push_back(cp);
+        i += static_cast<std::size_t>(length);
+    }
+    return out;
+}
+
+void
+print_descriptor(const incfontdisc::FontDescriptor &font) {
+    std::printf("%s\t%s\tweight=%d\tstretch=%d\titalic=%d\t%s\n", font.family.c_str(), font.style.c_str(),
+                font.weight, font.stretch, font.italic ? 1 : 0, font.id.value.c_str());
+}
+
+void
+print_error(std::string_view input, const incfontdisc::Error &error) {
+    std::fprintf(stderr, "error: %.*s: %s\n", static_cast<int>(input.size()), input.data(), error.message.c_str());
+}
+
+bool
+gather_inputs(Options &options) {
+    if (! options.input_file) { return true; }
+
+    std::ifstream file;
+    std::istream *stream = &std::cin;
+    if (*options.input_file != "-") {
+        file.open(*options.input_file);
+        if (! file) {
+            std::fprintf(stderr, "error: cannot open %s\n", options.input_file->c_str());
+            return false;
+        }
+        stream = &file;
+    }
+    for (std::string line; std::getline(*stream, line);) {
+        if (! line.empty() && line.back() == '\r') { line.pop_back(); }
+        if (line.empty() || line.front() == '#') { continue; }
+        options.inputs.push_back(std::move(line));
+    }
+    return true;
+}
+
+int
+cmd_list(const Options &options) {
+    PhaseStats list("list");
+    for (std::size_t round = 0; round < options.repeat; ++round) {
+        auto fonts = timed(list, [] { return incfontdisc::list_fonts(); });
+        if (! fonts) {
+            print_error("list", fonts.error());
+            return 1;
+        }
+        if (! options.quiet && round == 0) {
+            for (const auto &font : *fonts) { print_descriptor(font); }
+        }
+    }
+    list.report();
+    return 0;
+}
+
+int
+cmd_memory() {
+    // Client mode keeps the catalog in the daemon, build it here so there is something to measure
+    if (auto fonts = incfontdisc::list_fonts(); ! fonts) {
+        print_error("memory", fonts.error());
+        return 1;
+    }
+    const auto usage = incfontdisc::memory_usage();
+    std::printf("%-16s %12zu\n", "descriptors", usage.descriptors);
+    std::printf("%-16s %12zu\n", "strings", usage.strings);
+    std::printf("%-16s %12zu\n", "family_index", usage.family_index);
+    std::printf("%-16s %12zu\n", "fuzzy_index", usage.fuzzy_index);
+    std::printf("%-16s %12zu\n", "id_index", usage.id_index);
+    std::printf("%-16s %12zu\n", "coverage_index", usage.coverage_index);
+    std::printf("%-16s %12zu\n", "advance_tables", usage.advance_tables);
+    std::printf("%-16s %12zu\n", "byte_caches", usage.byte_caches);
+    std::printf("%-16s %12zu\n", "mapped_resident", usage.mapped_resident);
+    std::printf("%-16s %12zu\n", "total", usage.total());
+    return 0;
+}
+
+int
+cmd_pin(const Options &options) {
+    incfontdisc::configure_pinning({.lock = options.lock});
+    PhaseStats  pin("pin");
+    std::size_t failures = 0;
+    for (const auto &input : options.inputs) {
+        auto query = parse_query(input);
+        if (! query) {
+            std::fprintf(stderr, "error: malformed query: %s\n", input.c_str());
+            return 2;
+        }
+        auto matched = incfontdisc::match_fonts(*query);
+        if (! matched) {
+            ++failures;
+            print_error(input, matched.error());
+            continue;
+        }
+        const auto face = incfontdisc::font_handle(matched->font.id);
+        if (auto pinned = timed(pin, [&] { return incfontdisc::pin_font(face); }); ! pinned) {
+            ++failures;
+            print_error(input, pinned.error());
+        }
+    }
+
+    const auto stats = incfontdisc::pin_stats();
+    std::printf("%-16s %12zu\n", "faces", stats.faces);
+    std::printf("%-16s %12zu\n", "files", stats.files);
+    std::printf("%-16s %12zu\n", "pinned_bytes", stats.pinned_bytes);
+    std::printf("%-16s %12zu\n", "locked_bytes", stats.locked_bytes);
+    pin.report();
+    return failures == 0 ? 0 : 1;
+}
+
+// Pronounceable and unique per index: two letters per base-80 digit, at least three digits
+std::string
+synthetic_family(std::size_t index) {
+    constexpr std::string_view consonants = "bcdfghklmnprstvz";
+    constexpr std::string_view vowels     = "aeiou";
+    constexpr std::string_view suffixes[] = {" Sans", " Serif", " Mono", " Display", " Text"};
+
+    std::string name;
+    std::size_t rest = index;
+    for (int digits = 0; digits < 3 || rest != 0; ++digits) {
+        const std::size_t syllable = rest % 80;
+        rest /= 80;
+        name.push_back(consonants[syllable / 5]);
+        name.push_back(vowels[syllable % 5]);
+    }
+    name[0] = static_cast<char>(name[0] - 'a' + 'A');
+    return name.append(suffixes[index % 5]);
+}
+
+// Stands in for a font hosting index: the catalog is registered, not enumerated, and no file exists behind it
+int
+cmd_bench_scale(const Options &options) {
+    std::size_t face_count = 1'000'000;
+    if (! options.inputs.empty()) {
+        auto count = parse_int(options.inputs.front());
+        if (! count || *count < 1) {
+            std::fputs(usage_text.data(), stderr);
+            return 2;
+        }
+        face_count = static_cast<std::size_t>(*count);
+    }
+    struct Style {
+        std::string_view name;
+        int              weight;
+        bool             italic;
+    };
+    constexpr Style styles[] = {{"Regular", 400, false}, {"Italic", 400, true},      {"Bold", 700, false},
+                                {"Bold Italic", 700, true}, {"Light", 300, false}, {"Black", 900, false}};
+    const std::size_t family_count = (face_count + std::size(styles) - 1) / std::size(styles);
+
+    std::vector<incfontdisc::FontDescriptor> fonts;
+    fonts.reserve(face_count);
+    for (std::size_t i = 0; i < face_count; ++i) {
+        const auto &style = styles[i % std::size(styles)];
+        fonts.push_back(incfontdisc::FontDescriptor{
+            .id      = incfontdisc::FontId{"/srv/fonts/" + std::to_string(i) + ".ttf#0"},
+            .family  = synthetic_family(i / std::size(styles)),
+            .style   = std::string(style.name),
+            .weight  = style.weight,
+            .italic  = style.italic,
+        });
+    }
+
+    // The daemon and the file backed indices would all look at files that do not exist, shared match results
+    // from earlier runs would hide the matcher
+    incfontdisc::configure_daemon_client({.enabled = false});
+    incfontdisc::configure_match_cache({.persistent = false});
+    if (auto configured = incfontdisc::configure_catalog({.layout_index = false, .fallback_index = false});
+        ! configured) {
+        print_error("bench-scale", configured.error());
+        return 1;
+    }
+    PhaseStats build("build");
+    if (auto registered = timed(build, [&] { return incfontdisc::register_fonts(std::move(fonts)); }); ! registered) {
+        print_error("bench-scale", registered.error());
+        return 1;
+    }
+    const auto usage = incfontdisc::memory_usage();
+    std::printf("faces=%zu families=%zu catalog=%zu bytes (%.1f per face)\n", face_count, family_count,
+                usage.total(), static_cast<double>(usage.total()) / static_cast<double>(face_count));
+
+    PhaseStats  exact("exact"), fuzzy("fuzzy");
+    std::size_t failures = 0;
+    std::uint64_t state  = 0x9e3779b97f4a7c15u;
+    auto          next   = [&] {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    for (std::size_t round = 0; round < options.repeat * 10'000; ++round) {
+        const auto &style = styles[next() % std::size(styles)];
+        incfontdisc::FontQuery query{.family = synthetic_family(next() % family_count), .weight = style.weight,
+                                     .italic = style.italic};
+        if (! timed(exact, [&] { return incfontdisc::match_fonts(query); })) { ++failures; }
+    }
+    for (std::size_t round = 0; round < options.repeat * 50; ++round) {
+        // A transposed pair of letters leaves no exact match, so the query goes through the fuzzy family pass
+        std::string family = synthetic_family(next() % family_count);
+        std::swap(family[1], family[2]);
+        if (! timed(fuzzy, [&] { return incfontdisc::match_fonts(incfontdisc::FontQuery{.family = family}); })) {
+            ++failures;
+        }
+    }
+    build.report();
+    exact.report();
+    fuzzy.report();
+    return failures == 0 ? 0 : 1;
+}
+
+int
+cmd_refresh(const Options &options) {
+    PhaseStats refresh("refresh");
+    for (std::size_t round = 0; round < options.repeat; ++round) {
+        incfontdisc::RefreshOptions refresh_options{.deadline = deadline_of(options)};
+        if (! options.quiet) {
+            refresh_options.progress = [](const incfontdisc::RefreshProgress &progress) {
+                constexpr const char *phases[] = {"enumerate", "scan", "index"};
+                std::fprintf(stderr, "\r%-10s %zu/%zu", phases[static_cast<int>(progress.phase)], progress.done,
+                             progress.total);
+            };
+        }
+        auto refreshed = timed(refresh, [&] { return incfontdisc::refresh_fonts(std::move(refresh_options)); });
+        if (! options.quiet) { std::fputc('\n', stderr); }
+        if (! refreshed) {
+            print_error("refresh", refreshed.error());
+            return 1;
+        }
+    }
+    refresh.report();
+    return 0;
+}
+
+// match and load share the loop, the first request is reported separately because it pays for the catalog build
+int
+cmd_match(const Options &options, bool load) {
+    PhaseStats cold("cold"), match("match"), read("load"), pipelined("pipelined");
+    std::size_t failures = 0;
+    bool        first    = true;
+
+    const auto start = Clock::now();
+    for (std::size_t round = 0; round < options.repeat; ++round) {
+        for (const auto &input : options.inputs) {
+            auto query = parse_query(input);
+            if (! query) {
+                std::fprintf(stderr, "error: malformed query: %s\n", input.c_str());
+                return 2;
+            }
+
+            // Without a deadline loads go through the pipelined call. Its match and read overlap, so it is timed as a
+            // phase of its own rather than under "match" or "load".
+            if (load && ! options.timeout) {
+                auto &phase  = first ? cold : pipelined;
+                auto  loaded = timed(phase, [&] { return incfontdisc::match_and_load(*query); });
+                first        = false;
+                if (! loaded) {
+                    ++failures;
+                    print_error(input, loaded.error());
+                    continue;
+                }
+                phase.add_bytes(loaded->data.size());
+                if (! options.quiet && round == 0) {
+                    std::printf("%s\t->\t%zu bytes\tfamily_score=%.3f\tface_score=%.3f\t", input.c_str(),
+                                loaded->data.size(), loaded->match.family_score, loaded->match.face_score);
+                    print_descriptor(loaded->match.font);
+                }
+                continue;
+            }
+
+            auto matched =
+                timed(first ? cold : match, [&] { return incfontdisc::match_fonts(*query, deadline_of(options)); });
+            first        = false;
+            if (! matched) {
+                ++failures;
+                print_error(input, matched.error());
+                continue;
+            }
+
+            std::size_t bytes = 0;
+            if (load) {
+                auto data =
+                    timed(read, [&] { return incfontdisc::load_font_data(matched->font.id, deadline_of(options)); });
+                if (! data) {
+                    ++failures;
+                    print_error(input, data.error());
+                    continue;
+                }
+                bytes = data->size();
+                read.add_bytes(bytes);
+            }
+
+            if (! options.quiet && round == 0) {
+                std::printf("%s\t->\t", input.c_str());
+                if (load) { std::printf("%zu bytes\t", bytes); }
+                std::printf("family_score=%.3f\tface_score=%.3f\t", matched->family_score, matched->face_score);
+                print_descriptor(matched->font);
+            }
+        }
+    }
+    const double wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    cold.report();
+    match.report();
+    read.report();
+    pipelined.report();
+    std::fprintf(stderr, "%-10s %.3fms for %zu requests, %zu failed\n", "wall", wall_ms,
+                 options.inputs.size() * options.repeat, failures);
+    return failures == 0 ? 0 : 1;
+}
+
+int
+cmd_describe(const Options &options) {
+    PhaseStats  describe("describe");
+    std::size_t failures = 0;
+    for (std::size_t round = 0; round < options.repeat; ++round) {
+        for (const auto &input : options.inputs) {
+            auto font = timed(describe, [&] { return incfontdisc::describe_font(incfontdisc::FontId{input}); });
+            if (! font) {
+                ++failures;
+                print_error(input, font.error());
+                continue;
+            }
+            if (! options.quiet && round == 0) { print_descriptor(*font); }
+        }
+    }
+    describe.report();
+    return failures == 0 ? 0 : 1;
+}
+
+int
+cmd_coverage(Options options) {
+    // Command line form is '<query> <text>', bulk lines are '<query>\t<text>'
+    if (! options.input_file && options.inputs.size() == 2) {
+        options.inputs = {options.inputs[0] + '\t' + options.inputs[1]};
+    }
+
+    PhaseStats  match("match"), coverage("coverage");
+    std::size_t failures = 0;
+    for (std::size_t round = 0; round < options.repeat; ++round) {
+        for (const auto &input : options.inputs) {
+            const auto tab   = input.find('\t');
+            auto       query = parse_query(std::string_view(input).substr(0, tab));
+            if (tab == std::string::npos || ! query) {
+                std::fprintf(stderr, "error: malformed coverage input: %s\n", input.c_str());
+                return 2;
+            }
+            const auto text = decode_utf8(std::string_view(input).substr(tab + 1));
+
+            auto matched = timed(match, [&] { return incfontdisc::match_fonts(*query); });
+            if (! matched) {
+                ++failures;
+                print_error(input, matched.error());
+                continue;
+            }
+            auto report = timed(coverage, [&] { return incfontdisc::check_coverage(matched->font.id, text); });
+            if (! report) {
+                ++failures;
+                print_error(input, report.error());
+                continue;
+            }
+            if (! options.quiet && round == 0) {
+                std::printf("%s\tcovered=%zu/%zu\tmissing=", matched->font.id.value.c_str(), report->covered,
+                            text.size());
+                for (char32_t cp : report->missing) { std::printf("U+%04X ", static_cast<unsigned>(cp)); }
+                std::printf("\n");
+            }
+        }
+    }
+    match.report();
+    coverage.report();
+    return failures == 0 ? 0 : 1;
+}
+
+// Trace events are dealt round-robin to the replay threads, every thread keeps its own statistics
+int
+cmd_replay(const Options &options) {
+    if (options.inputs.size() != 1) {
+        std::fputs(usage_text.data(), stderr);
+        return 2;
+    }
+    auto events = incfontdisc::read_trace(options.inputs.front());
+    if (! events) {
+        print_error(options.inputs.front(), events.error());
+        return 1;
+    }
+
+    // Build the catalog up front so that it does not distort the first samples
+    PhaseStats cold("catalog");
+    auto       warm = timed(cold, [] { return incfontdisc::list_fonts(); });
+    if (! warm) {
+        print_error("catalog", warm.error());
+        return 1;
+    }
+
+    struct Worker {
+        PhaseStats  match{"match"};
+        PhaseStats  load{"load"};
+        std::size_t failures = 0;
+    };
+    std::vector<Worker> workers(options.jobs);
+
+    auto replay = [&](std::size_t index) {
+        auto &worker = workers[index];
+        for (std::size_t round = 0; round < options.repeat; ++round) {
+            for (std::size_t i = index; i < events->size(); i += options.jobs) {
+                const auto &event = (*events)[i];
+                if (event.kind == incfontdisc::TraceEventKind::Match) {
+                    auto matched = timed(worker.match, [&] { return incfontdisc::match_fonts(event.query); });
+                    if (! matched) { ++worker.failures; }
+                }
+                else {
+                    auto data = timed(worker.load, [&] { return incfontdisc::load_font_data(event.id); });
+                    if (data) { worker.load.add_bytes(data->size()); }
+                    else { ++worker.failures; }
+                }
+            }
+        }
+    };
+
+    const auto start = Clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (std::size_t i = 1; i < options.jobs; ++i) { threads.emplace_back(replay, i); }
+        replay(0);
+    }
+    const double wall_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    PhaseStats  match("match"), load("load");
+    std::size_t failures = 0;
+    for (const auto &worker : workers) {
+        match.merge(worker.match);
+        load.merge(worker.load);
+        failures += worker.failures;
+    }
+
+    const std::size_t total = events->size() * options.repeat;
+    cold.report();
+    match.report();
+    load.report();
+    std::fprintf(stderr, "%-10s %zu events from %zu threads in %.3fms, %.1f events/s, %zu failed\n", "replay", total,
+                 options.jobs, wall_s * 1000.0, wall_s > 0.0 ? static_cast<double>(total) / wall_s : 0.0, failures);
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int
+main(int argc, char *argv[]) {
+    Options options{};
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::fputs(usage_text.data(), stdout);
+            return 0;
+        }
+        else if (arg == "-f" && i + 1 < argc) { options.input_file = argv[++i]; }
+        else if (arg == "-n" && i + 1 < argc) {
+            auto count = parse_int(argv[++i]);
+            if (! count || *count < 1) {
+                std::fputs(usage_text.data(), stderr);
+                return 2;
+            }
+            options.repeat = static_cast<std::size_t>(*count);
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            auto count = parse_int(argv[++i]);
+            if (! count || *count < 0) {
+                std::fputs(usage_text.data(), stderr);
+                return 2;
+            }
+            options.threads = static_cast<std::size_t>(*count);
+        }
+        else if (arg == "-j" && i + 1 < argc) {
+            auto count = parse_int(argv[++i]);
+            if (! count || *count < 1) {
+                std::fputs(usage_text.data(), stderr);
+                return 2;
+            }
+            options.jobs = static_cast<std::size_t>(*count);
+        }
+        else if (arg == "--record" && i + 1 < argc) { options.record = argv[++i]; }
+        else if (arg == "-q") { options.quiet = true; }
+        else if (arg == "--no-daemon") { options.no_daemon = true; }
+        else if (arg == "--lock") { options.lock = true; }
+        else if (arg == "--timeout" && i + 1 < argc) {
+            auto milliseconds = parse_int(argv[++i]);
+            if (! milliseconds || *milliseconds < 0) {
+                std::fputs(usage_text.data(), stderr);
+                return 2;
+            }
+            options.timeout = std::chrono::milliseconds(*milliseconds);
+        }
+        else if (options.command.empty()) { options.command = arg; }
+        else { options.inputs.emplace_back(arg); }
+    }
+    if (options.command.empty()) {
+        std::fputs(usage_text.data(), stderr);
+        return 2;
+    }
+    if (! gather_inputs(options)) { return 2; }
+
+    if (options.no_daemon) { incfontdisc::configure_daemon_client({.enabled = false}); }
+    if (options.threads != 0) { incfontdisc::configure_executor({.thread_count = options.threads}); }
+    if (options.record) {
+        if (auto started = incfontdisc::start_trace_recording(*options.record); ! started) {
+            print_error(*options.record, started.error());
+            return 1;
+        }
+    }
+
+    if (options.command == "list") { return cmd_list(options); }
+    if (options.command == "refresh") { return cmd_refresh(options); }
+    if (options.command == "match") { return cmd_match(options, false); }
+    if (options.command == "load") { return cmd_match(options, true); }
+    if (options.command == "describe") { return cmd_describe(options); }
+    if (options.command == "coverage") { return cmd_coverage(std::move(options)); }
+    if (options.command == "replay") { return cmd_replay(options); }
+    if (options.command == "memory") { return cmd_memory(); }
+    if (options.command == "pin") { return cmd_pin(options); }
+    if (options.command == "bench-scale") { return cmd_bench_scale(options); }
+
+    std::fprintf(stderr, "error: unknown command '%s'\n\n", options.command.c_str());
+    std::fputs(usage_text.data(), stderr);
+    return 2;
+}
@@ -0,0 +1,68 @@
+#include <incfontdisc/incfontdisc.hpp>
+
+#include <csignal>
+#include <cstdio>
+#include <string_view>
+#include <thread>
+
+#include <pthread.h>
+#include <signal.h>
+
+namespace {
+
+void
+print_usage(const char *program) {
+    std::fprintf(stderr, "usage: %s [--socket <path>]\n", program);
+}
+
+} // namespace
+
+int
+main(int argc, char *argv[]) {
+    incfontdisc::DaemonOptions options{};
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) { options.socket_path = argv[++i]; }
+        else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    // Signals are taken synchronously by a dedicated thread which then asks the daemon loop to stop
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    std::stop_source stop;
+    options.stop_token = stop.get_token();
+    std::thread signal_thread([&signals, &stop] {
+        for (;;) {
+            int signal = 0;
+            if (sigwait(&signals, &signal) != 0) { continue; }
+            if (signal == SIGHUP) {
+                // Rescan fonts without restarting, in-flight requests keep the previous snapshot
+                incfontdisc::refresh_fonts();
+                continue;
+            }
+            stop.request_stop();
+            return;
+        }
+    });
+
+    auto served = incfontdisc::run_daemon(options);
+    if (! stop.stop_requested()) {
+        stop.request_stop();
+        pthread_kill(signal_thread.native_handle(), SIGTERM);
+    }
+    signal_thread.join();
+
+    if (! served) {
+        std::fprintf(stderr, "incfontdiscd: %s\n", served.error().message.c_str());
+        return 1;
+    }
+    return 0;
+}